@@ -0,0 +1,61 @@
+# PGO training run for the pgo-train target (MIPS_PGO=GENERATE builds):
+#   cmake -DSIM=... -DSRC=main_files -DWORK=dir -DPGO_DIR=... \
+#         -DCOMPILER=GNU|Clang [-DLLVM_PROFDATA=...] -P PgoTrain.cmake
+# Runs mips_sim over every bundled kernel under the configurations the
+# hot loop is instantiated for (plain, event skip, predictor, caches,
+# counters, profile), then a batch of the sweep manifest repeated enough
+# times to dominate start-up. Clang's raw profiles are merged into
+# PGO_DIR/default.profdata; GCC reads its .gcda files directly.
+
+file(MAKE_DIRECTORY ${WORK})
+file(GLOB kernels ${SRC}/kernels/*.asm)
+list(APPEND kernels ${SRC}/finaltest1.asm)
+
+set(configs
+    "--event-skip"
+    "--bp@@gshare,btb=64"
+    "--l1i@@default@@--l1d@@default@@--l2@@default"
+    "--counters@@${WORK}/counters.json"
+    "--profile"
+    "--ff@@20@@--ff-engine@@superblock")
+
+foreach(k IN LISTS kernels)
+    execute_process(COMMAND ${SIM} ${k} OUTPUT_QUIET RESULT_VARIABLE rc)
+    if(NOT rc EQUAL 0)
+        message(FATAL_ERROR "training run failed: ${SIM} ${k}")
+    endif()
+    foreach(c IN LISTS configs)
+        string(REPLACE "@@" ";" args "${c}")
+        execute_process(COMMAND ${SIM} ${args} ${k} OUTPUT_QUIET RESULT_VARIABLE rc)
+        if(NOT rc EQUAL 0)
+            message(FATAL_ERROR "training run failed: ${SIM} ${args} ${k}")
+        endif()
+    endforeach()
+endforeach()
+
+# manifest paths are relative to the manifest
+set(manifest "")
+foreach(i RANGE 200)
+    foreach(k IN LISTS kernels)
+        string(APPEND manifest "${k}\n")
+    endforeach()
+endforeach()
+file(WRITE ${WORK}/train.manifest "${manifest}")
+execute_process(COMMAND ${SIM} --batch ${WORK}/train.manifest --jobs 1
+                OUTPUT_QUIET RESULT_VARIABLE rc)
+if(NOT rc EQUAL 0)
+    message(FATAL_ERROR "training batch failed")
+endif()
+
+if(COMPILER MATCHES "Clang")
+    if(NOT LLVM_PROFDATA)
+        message(FATAL_ERROR "llvm-profdata not found; cannot merge Clang profiles")
+    endif()
+    file(GLOB raw ${PGO_DIR}/*.profraw)
+    execute_process(COMMAND ${LLVM_PROFDATA} merge -o ${PGO_DIR}/default.profdata ${raw}
+                    RESULT_VARIABLE rc)
+    if(NOT rc EQUAL 0)
+        message(FATAL_ERROR "llvm-profdata merge failed")
+    endif()
+endif()
+message(STATUS "PGO profiles in ${PGO_DIR}")
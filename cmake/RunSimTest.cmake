@@ -0,0 +1,20 @@
+# Driver for mips_sim_test() in CMakeLists.txt:
+#   cmake -DSIM=... -DPROGRAM=... -DARGS=a@@b -DEXPECT=re1@@re2 -P RunSimTest.cmake
+# Runs "SIM ARGS... PROGRAM" and fails unless it exits 0 and stdout
+# matches every regex in EXPECT.
+
+string(REPLACE "@@" ";" args "${ARGS}")
+string(REPLACE "@@" ";" expect "${EXPECT}")
+
+execute_process(COMMAND ${SIM} ${args} ${PROGRAM}
+                RESULT_VARIABLE status
+                OUTPUT_VARIABLE out
+                ERROR_VARIABLE err)
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "mips_sim exited with ${status}\n${err}${out}")
+endif()
+foreach(re IN LISTS expect)
+    if(NOT out MATCHES "${re}")
+        message(FATAL_ERROR "output does not match '${re}':\n${out}")
+    endif()
+endforeach()
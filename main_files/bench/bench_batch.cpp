@@ -0,0 +1,72 @@
+// bench_batch.cpp
+// Batch driver scaling: the same set of jobs (one shared loop kernel,
+// iteration count varied per job through $4) run by runBatch() on one
+// thread and on every hardware thread. Checks that both runs report the
+// same registers, memory hash and cycles for every job.
+// Build (from main_files/):
+// g++ -std=c++17 -O2 -pthread -I. bench/bench_batch.cpp mips_batch.cpp mips_program_cache.cpp mips_parser.cpp mips_assembler.cpp mips_lexer.cpp mips_pipeline.cpp mips_parallel.cpp mips_cache.cpp mips_branch.cpp mips_iss.cpp mips_threaded.cpp mips_superblock.cpp mips_trace.cpp -o bench_batch
+
+#include "mips_batch.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static const char* const kKernel =
+    "# $4 = iterations, set per job\n"
+    "        ADDI $1, $0, 0\n"
+    "loop:   BEQ  $4, $0, done\n"
+    "        ADD  $1, $1, $4\n"
+    "        SW   $1, 0($0)\n"
+    "        LW   $2, 0($0)\n"
+    "        SLL  $3, $2, 1\n"
+    "        ADDI $4, $4, -1\n"
+    "        J    loop\n"
+    "done:   HALT\n";
+
+int main(int argc, char* argv[]) {
+    size_t jobs  = (argc > 1) ? stoul(argv[1]) : 2000;
+    int    iters = (argc > 2) ? stoi(argv[2]) : 20000;
+
+    const string src = "bench_batch.asm";
+    ofstream(src) << kKernel;
+
+    // uneven job sizes, so stealing has something to balance
+    vector<BatchJob> manifest(jobs);
+    for (size_t j = 0; j < jobs; ++j) {
+        manifest[j].program = src;
+        manifest[j].regs.emplace_back(4, static_cast<int32_t>(iters / 2 + (j * 7919) % iters));
+    }
+
+    auto timed = [&](unsigned threads, vector<BatchResult>& out) {
+        BatchOptions opts;
+        opts.threads = threads;
+        auto t0 = chrono::steady_clock::now();
+        out = runBatch(manifest, opts);
+        return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    };
+
+    vector<BatchResult> one, all;
+    unsigned hw = WorkStealingPool(0).threads();
+    double t1 = timed(1, one);
+    double tn = timed(hw, all);
+
+    uint64_t cycles = 0;
+    bool same = true;
+    for (size_t j = 0; j < jobs; ++j) {
+        cycles += one[j].cycles;
+        same = same && one[j].status == BatchResult::Status::Ok &&
+               all[j].status == one[j].status && all[j].cycles == one[j].cycles &&
+               all[j].mem_hash == one[j].mem_hash && all[j].regs == one[j].regs;
+    }
+
+    cout << jobs << " jobs, " << cycles / 1e6 << " M simulated cycles\n"
+         << "  1 thread    " << t1 << " s  " << jobs / t1 << " jobs/s\n"
+         << "  " << hw << " threads   " << tn << " s  " << jobs / tn << " jobs/s  ("
+         << t1 / tn << "x)" << (same ? "" : "  MISMATCH") << "\n";
+    return same ? 0 : 1;
+}
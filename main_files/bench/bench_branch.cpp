@@ -0,0 +1,71 @@
+// bench_branch.cpp
+// What each branch predictor recovers on loop-heavy code: a nested loop
+// with a data-dependent branch in its body (not taken on every third element)
+// runs under every predictor. Reports cycles, accuracy, flushed fetch
+// slots and the cycles saved against the original never-taken policy, and
+// checks that the final registers do not depend on the predictor.
+// Build (from main_files/):
+// g++ -std=c++17 -O2 -pthread -I. bench/bench_branch.cpp mips_assembler.cpp mips_lexer.cpp mips_pipeline.cpp mips_parallel.cpp mips_cache.cpp mips_branch.cpp mips_iss.cpp mips_threaded.cpp mips_superblock.cpp mips_trace.cpp -o bench_branch
+
+#include "mips_assembler.h"
+#include "mips_pipeline.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// $4 = outer iterations, $5 = inner iterations
+static const char* const kKernel =
+    "outer:  ADD  $2, $5, $0\n"
+    "        ADDI $6, $0, 0\n"
+    "inner:  ADDI $6, $6, 1\n"
+    "        ADDI $7, $0, 3\n"
+    "        BNE  $6, $7, skip\n"       // taken twice, then falls through
+    "        ADDI $6, $0, 0\n"
+    "        ADDI $8, $8, 1\n"
+    "skip:   ADD  $9, $9, $2\n"
+    "        ADDI $2, $2, -1\n"
+    "        BNE  $2, $0, inner\n"
+    "        ADDI $4, $4, -1\n"
+    "        BEQ  $4, $0, done\n"
+    "        J    outer\n"
+    "done:   HALT\n";
+
+int main(int argc, char* argv[]) {
+    int outer = (argc > 1) ? stoi(argv[1]) : 2000;
+    int inner = (argc > 2) ? stoi(argv[2]) : 100;
+
+    AssembledProgram program = assemble(kKernel);
+    const char* const specs[] = {"nottaken", "btfn", "bimodal", "gshare",
+                                 "gshare,btb=16"};
+
+    uint64_t base_cycles = 0;
+    RegFile base_regs{};
+    bool same = true;
+    cout << "predictor        cycles   accuracy  flushed   saved      ms\n";
+    for (const char* spec : specs) {
+        MIPSPipeline p(program.text);
+        p.regs_[4] = outer;
+        p.regs_[5] = inner;
+        p.setBranchPredictor(parsePredictorConfig(spec));
+        auto t0 = chrono::steady_clock::now();
+        p.run();
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+
+        if (spec == specs[0]) {
+            base_cycles = p.cycles();
+            base_regs   = p.regs_;
+        }
+        same = same && p.regs_ == base_regs;
+        const PredictorStats& st = p.branchPredictor().stats();
+        cout << left << setw(14) << spec << right << setw(10) << p.cycles()
+             << fixed << setprecision(2) << setw(10) << 100.0 * st.accuracy()
+             << "%" << setw(9) << st.flush_cycles << setw(8)
+             << 100.0 * (double(base_cycles) - double(p.cycles())) / double(base_cycles)
+             << "%" << setw(8) << ms << defaultfloat << "\n";
+    }
+    if (!same) cout << "MISMATCH\n";
+    return same ? 0 : 1;
+}
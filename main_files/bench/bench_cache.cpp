@@ -0,0 +1,102 @@
+// bench_cache.cpp
+// Startup cost of a large program: assembling the source (cold start)
+// against validating and mapping its program cache (warm start), both up
+// to a constructed MIPSPipeline with .data loaded. Checks that both paths
+// produce the same program.
+// Build (from main_files/):
+// g++ -std=c++17 -O2 -pthread -I. bench/bench_cache.cpp mips_program_cache.cpp mips_assembler.cpp mips_lexer.cpp mips_pipeline.cpp mips_parallel.cpp mips_cache.cpp mips_branch.cpp mips_iss.cpp mips_threaded.cpp mips_superblock.cpp mips_trace.cpp -o bench_cache
+
+#include "mips_assembler.h"
+#include "mips_lexer.h"
+#include "mips_pipeline.h"
+#include "mips_program_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+static void write_source(const string& path, size_t lines) {
+    ofstream out(path);
+    out << ".data\ntable: .word 1, 2, 3, 4\nbuf: .space 4096\n.text\n";
+    for (size_t i = 0; i < lines; ++i) {
+        if (i % 64 == 0) out << "L" << i / 64 << ":\n";
+        switch (i % 6) {
+            case 0: out << "ADDI $" << 1 + i % 30 << ", $0, " << i % 1000 << "\n"; break;
+            case 1: out << "ADD $3, $1, $2   # sum\n"; break;
+            case 2: out << "LW $4, table($0)\n"; break;
+            case 3: out << "SW $4, buf($0)\n"; break;
+            case 4: out << "SLL $5, $4, 2\n"; break;
+            case 5: out << "BNE $0, $0, L" << i / 64 << "\n"; break;
+        }
+    }
+    out << "HALT\n";
+}
+
+template <typename F>
+static double best_of(int reps, F&& f) {
+    double best = 1e30;
+    for (int r = 0; r < reps; ++r) {
+        auto t0 = chrono::steady_clock::now();
+        f();
+        auto t1 = chrono::steady_clock::now();
+        best = min(best, chrono::duration<double>(t1 - t0).count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    size_t lines = (argc > 1) ? stoul(argv[1]) : 1000000;
+    int    reps  = (argc > 2) ? stoi(argv[2]) : 5;
+
+    const string src = "bench_cache.asm";
+    write_source(src, lines);
+    {
+        MappedFile source(src);
+        ProgramCache::write(programCachePath(src), source.text(),
+                            assemble(source.text()));
+    }
+
+    uint64_t cold_sum = 0, warm_sum = 0;
+    double cold = best_of(reps, [&] {
+        MappedFile source(src);
+        AssembledProgram p = assemble(source.text());
+        MIPSPipeline pipe(p.text);
+        pipe.mem_.write_words(0, p.data.data(), p.data.size());
+        cold_sum = p.text.size() + p.data.size();
+    });
+    double warm = best_of(reps, [&] {
+        MappedFile source(src);
+        ProgramCache cache;
+        if (!cache.open(programCachePath(src), source.text())) {
+            cerr << "cache rejected\n";
+            exit(1);
+        }
+        MIPSPipeline pipe(cache.text());
+        pipe.mem_.write_words(0, cache.data(), cache.dataWords());
+        warm_sum = cache.text().size + cache.dataWords();
+    });
+
+    // same program either way
+    MappedFile source(src);
+    AssembledProgram p = assemble(source.text());
+    ProgramCache cache;
+    bool same = cache.open(programCachePath(src), source.text()) &&
+                cache.text().size == p.text.size() &&
+                equal(p.text.begin(), p.text.end(), cache.text().begin(),
+                      [](const Instruction& a, const Instruction& b) {
+                          return a.op == b.op && a.rs == b.rs && a.rt == b.rt &&
+                                 a.rd == b.rd && a.shamt == b.shamt &&
+                                 a.imm == b.imm && a.addr == b.addr;
+                      }) &&
+                equal(p.data.begin(), p.data.end(), cache.data()) &&
+                cold_sum == warm_sum;
+
+    cout << lines << " source lines\n"
+         << "  assemble     " << cold * 1e3 << " ms\n"
+         << "  cache        " << warm * 1e3 << " ms  ("
+         << cold / warm << "x)" << (same ? "" : "  MISMATCH") << "\n";
+    return same ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+// bench_event_skip.cpp
+// Simulated cycles per host second of MIPSPipeline::run() with and without
+// event skipping, on a long straight-line stretch and on a loop whose body
+// is mostly straight-line code. Also checks that both runs end in the same
+// registers, memory and cycle count.
+// Build (from main_files/):
+// g++ -std=c++17 -O2 -pthread -I. bench/bench_event_skip.cpp mips_pipeline.cpp mips_parallel.cpp mips_cache.cpp mips_branch.cpp mips_iss.cpp mips_threaded.cpp mips_superblock.cpp mips_trace.cpp -o bench_event_skip
+
+#include "mips_pipeline.h"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// ALU/memory mix; every LW is followed by an SLL of the loaded register,
+// so the pipeline takes one load-use stall per six instructions.
+static void straight_line(vector<Instruction>& prog, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        Instruction ins{};
+        uint8_t r = static_cast<uint8_t>(2 + i % 20);
+        switch (i % 6) {
+            case 0: ins.op = Op::ADDI; ins.rt = r; ins.rs = r; ins.imm = 3; break;
+            case 1: ins.op = Op::ADD;  ins.rd = r; ins.rs = r; ins.rt = 2;  break;
+            case 2: ins.op = Op::SW;   ins.rt = r; ins.rs = 0; ins.imm = 4 * (i % 64); break;
+            case 3: ins.op = Op::LW;   ins.rt = r; ins.rs = 0; ins.imm = 4 * (i % 64); break;
+            case 4: ins.op = Op::SLL;  ins.rd = r; ins.shamt = 1;
+                    ins.rt = static_cast<uint8_t>(2 + (i - 1) % 20); break;
+            case 5: ins.op = Op::MUL;  ins.rd = r; ins.rs = r; ins.rt = 3;  break;
+        }
+        prog.push_back(ins);
+    }
+}
+
+static Instruction halt() {
+    Instruction i{}; i.op = Op::HALT; return i;
+}
+
+struct Kernel {
+    string name;
+    vector<Instruction> prog;
+};
+
+static vector<Kernel> kernels(size_t n, int iters) {
+    vector<Kernel> k;
+
+    k.push_back({"straight", {}});
+    straight_line(k.back().prog, n);
+    k.back().prog.push_back(halt());
+
+    // r1 counts down from `iters` around a 48-instruction body
+    k.push_back({"loop48", {}});
+    vector<Instruction>& p = k.back().prog;
+    Instruction init{};
+    init.op = Op::ADDI; init.rt = 1; init.imm = iters;
+    p.push_back(init);
+    straight_line(p, 48);
+    Instruction dec{};
+    dec.op = Op::ADDI; dec.rt = 1; dec.rs = 1; dec.imm = -1;
+    p.push_back(dec);
+    Instruction bne{};
+    bne.op = Op::BNE; bne.rs = 1; bne.imm = -50;
+    p.push_back(bne);
+    p.push_back(halt());
+    return k;
+}
+
+static double run_once(const vector<Instruction>& prog, bool skip,
+                       unique_ptr<MIPSPipeline>& out) {
+    out = make_unique<MIPSPipeline>(prog, 1024, false);
+    out->setEventSkip(skip);
+    auto t0 = chrono::steady_clock::now();
+    out->run();
+    auto t1 = chrono::steady_clock::now();
+    return chrono::duration<double>(t1 - t0).count();
+}
+
+int main(int argc, char* argv[]) {
+    size_t n    = (argc > 1) ? stoul(argv[1]) : 2000000;
+    int    reps = (argc > 2) ? stoi(argv[2]) : 5;
+
+    for (const Kernel& k : kernels(n, 30000)) {
+        double best[2] = {1e30, 1e30};
+        unique_ptr<MIPSPipeline> last[2];
+        for (int skip = 0; skip < 2; ++skip) {
+            for (int r = 0; r < reps; ++r) {
+                double t = run_once(k.prog, skip != 0, last[skip]);
+                if (t < best[skip]) best[skip] = t;
+            }
+        }
+        const MIPSPipeline& a = *last[0];
+        const MIPSPipeline& b = *last[1];
+        bool same = a.cycles() == b.cycles() && a.regs_ == b.regs_ &&
+                    a.mem_ == b.mem_;
+
+        cout << k.name << ": " << a.cycles() << " cycles"
+             << (same ? "" : "  MISMATCH") << "\n";
+        for (int skip = 0; skip < 2; ++skip)
+            cout << (skip ? "  event skip " : "  per cycle  ")
+                 << static_cast<double>(a.cycles()) / best[skip] / 1e6
+                 << " Mcycles/s\n";
+        cout << "  speedup     " << best[0] / best[1] << "x\n";
+        if (!same) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,240 @@
+// bench_lanes.cpp
+// Many instances of one program with different inputs, run as separate
+// MIPSPipeline objects (cycle-accurate step loop, threaded fast-forward)
+// and as LockstepLanes. Reports simulated MIPS over all instances and
+// checks that every lane ends with the registers, memory and instruction
+// count its own threaded run produced.
+// Build (from main_files/):
+// g++ -std=c++17 -O2 -pthread -I. bench/bench_lanes.cpp mips_lanes.cpp mips_counters.cpp mips_profile.cpp mips_assembler.cpp mips_lexer.cpp mips_pipeline.cpp mips_parallel.cpp mips_cache.cpp mips_branch.cpp mips_iss.cpp mips_threaded.cpp mips_superblock.cpp mips_trace.cpp -o bench_lanes
+
+#include "mips_assembler.h"
+#include "mips_lanes.h"
+#include "mips_pipeline.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// A lane's inputs: register and memory words set before the run.
+struct Inputs {
+    vector<pair<unsigned, int32_t>> regs;
+    vector<pair<uint32_t, int32_t>> mem;
+};
+
+struct Kernel {
+    const char* name;
+    const char* source;
+    function<Inputs(size_t lane)> inputs;
+};
+
+// $3 = per-lane seed, $4 = iterations (the same everywhere): no divergence
+static const char* const kAlu =
+    "loop:   ADD  $5, $5, $3\n"
+    "        SUB  $6, $5, $4\n"
+    "        AND  $7, $6, $5\n"
+    "        OR   $8, $7, $3\n"
+    "        SLL  $9, $8, 3\n"
+    "        SRL  $10, $9, 1\n"
+    "        SLT  $11, $10, $5\n"
+    "        MUL  $12, $10, $3\n"
+    "        ADD  $3, $3, $11\n"
+    "        ADDI $4, $4, -1\n"
+    "        BNE  $4, $0, loop\n"
+    "        HALT\n";
+
+// Collatz steps from $10, $9 times over: an if/else in a loop whose trip
+// count differs in every lane
+static const char* const kCollatz =
+    "        ADDI $6, $0, 1\n"
+    "outer:  ADD  $4, $10, $0\n"
+    "loop:   BEQ  $4, $6, done\n"
+    "        AND  $7, $4, $6\n"
+    "        BEQ  $7, $0, even\n"
+    "        ADD  $8, $4, $4\n"
+    "        ADD  $4, $8, $4\n"
+    "        ADDI $4, $4, 1\n"
+    "        J    next\n"
+    "even:   SRL  $4, $4, 1\n"
+    "next:   ADDI $5, $5, 1\n"
+    "        J    loop\n"
+    "done:   ADDI $9, $9, -1\n"
+    "        BNE  $9, $0, outer\n"
+    "        HALT\n";
+
+// sums the lane's own 64-word array at 0x100, $6 passes, storing each sum
+static const char* const kMemory =
+    "outer:  ADDI $2, $0, 256\n"
+    "        ADDI $7, $0, 64\n"
+    "inner:  LW   $3, 0($2)\n"
+    "        ADD  $5, $5, $3\n"
+    "        ADDI $2, $2, 4\n"
+    "        ADDI $7, $7, -1\n"
+    "        BNE  $7, $0, inner\n"
+    "        SW   $5, 0($0)\n"
+    "        ADDI $6, $6, -1\n"
+    "        BNE  $6, $0, outer\n"
+    "        HALT\n";
+
+// $9 calls to one of four 4-instruction handlers, picked by the top bits
+// of a per-lane random sequence: the JALR targets differ across lanes, the
+// returns do not
+static const char* const kDispatch =
+    "        LUI  $12, 0x41C6\n"
+    "        ORI  $12, $12, 0x4E6D\n"
+    "loop:   MULTU $10, $12\n"
+    "        MFLO $10\n"
+    "        ADDIU $10, $10, 12345\n"
+    "        SRL  $2, $10, 28\n"
+    "        ANDI $2, $2, 3\n"
+    "        SLL  $2, $2, 4\n"
+    "        ADDI $3, $2, f0\n"
+    "        JALR $3\n"
+    "        ADDI $9, $9, -1\n"
+    "        BGTZ $9, loop\n"
+    "        HALT\n"
+    "f0:     SRAV $5, $10, $4\n"
+    "        ADD  $6, $6, $5\n"
+    "        SLLV $6, $6, $4\n"
+    "        JR   $31\n"
+    "f1:     DIV  $10, $4\n"
+    "        MFHI $5\n"
+    "        XOR  $6, $6, $5\n"
+    "        JR   $31\n"
+    "f2:     SB   $10, 65($0)\n"
+    "        LH   $5, 64($0)\n"
+    "        SUB  $6, $6, $5\n"
+    "        JR   $31\n"
+    "f3:     BLTZ $10, neg\n"
+    "        SLTIU $5, $10, 100\n"
+    "        ADD  $6, $6, $5\n"
+    "        JR   $31\n"
+    "neg:    NOR  $6, $6, $0\n"
+    "        JR   $31\n";
+
+template <class F>
+static double best_of(int reps, F&& f) {
+    double best = 1e30;
+    for (int r = 0; r < reps; ++r) {
+        double t = f();
+        best = min(best, t);
+    }
+    return best;
+}
+
+template <class F>
+static double seconds(F&& f) {
+    auto t0 = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char* argv[]) {
+    size_t lanes = (argc > 1) ? stoul(argv[1]) : 1024;
+    int iters    = (argc > 2) ? stoi(argv[2]) : 1000;
+    int reps     = (argc > 3) ? stoi(argv[3]) : 3;
+    const size_t kWords = 4096;
+
+    const Kernel kernels[] = {
+        {"alu", kAlu, [&](size_t l) {
+             return Inputs{{{3, int32_t(l * 2654435761u)}, {4, iters}}, {}};
+         }},
+        {"collatz", kCollatz, [&](size_t l) {
+             return Inputs{{{10, int32_t(l + 1)}, {9, max(1, iters / 50)}}, {}};
+         }},
+        {"memory", kMemory, [&](size_t l) {
+             Inputs in{{{6, max(1, iters / 20)}}, {}};
+             for (uint32_t i = 0; i < 64; ++i)
+                 in.mem.push_back({0x100 + 4 * i, int32_t(l * 64 + i * i)});
+             return in;
+         }},
+        {"dispatch", kDispatch, [&](size_t l) {
+             return Inputs{{{10, int32_t(l * 2654435761u + 1)},
+                            {4, int32_t(l % 7 + 1)},
+                            {9, max(1, iters / 5)}}, {}};
+         }},
+    };
+
+    bool ok = true;
+    cout << fixed << setprecision(1);
+    for (const Kernel& k : kernels) {
+        AssembledProgram program = assemble(k.source);
+        vector<Inputs> inputs;
+        for (size_t l = 0; l < lanes; ++l) inputs.push_back(k.inputs(l));
+        auto make = [&](size_t l) {
+            MIPSPipeline p(program.text, kWords);
+            for (auto [r, v] : inputs[l].regs) p.regs_[r] = v;
+            for (auto [a, v] : inputs[l].mem) p.mem_.store_word(a, v);
+            return p;
+        };
+
+        // reference: one threaded fast-forward per lane
+        vector<MIPSPipeline> ref;
+        uint64_t instrs = 0;
+        for (size_t l = 0; l < lanes; ++l) {
+            ref.push_back(make(l));
+            ref.back().setFastForwardEngine(FFEngine::Threaded);
+            instrs += ref.back().fastForward(UINT64_MAX);
+        }
+
+        double t_step = best_of(reps, [&] {
+            vector<MIPSPipeline> sims;
+            for (size_t l = 0; l < lanes; ++l) sims.push_back(make(l));
+            double t = seconds([&] { for (MIPSPipeline& s : sims) s.run(); });
+            for (size_t l = 0; l < lanes; ++l)
+                if (sims[l].regs_ != ref[l].regs_ || sims[l].hi_ != ref[l].hi_ ||
+                    sims[l].lo_ != ref[l].lo_)
+                    ok = false;
+            return t;
+        });
+        double t_thr = best_of(reps, [&] {
+            vector<MIPSPipeline> sims;
+            for (size_t l = 0; l < lanes; ++l) {
+                sims.push_back(make(l));
+                sims.back().setFastForwardEngine(FFEngine::Threaded);
+            }
+            return seconds([&] {
+                for (MIPSPipeline& s : sims) s.fastForward(UINT64_MAX);
+            });
+        });
+        LockstepLanes::Stats stats;
+        double t_lanes = best_of(reps, [&] {
+            MIPSPipeline proto(program.text, kWords);
+            LockstepLanes ls(proto, lanes);
+            for (size_t l = 0; l < lanes; ++l) {
+                for (auto [r, v] : inputs[l].regs) ls.setReg(l, r, v);
+                for (auto [a, v] : inputs[l].mem) ls.memory(l).store_word(a, v);
+            }
+            double t = seconds([&] { ls.run(); });
+            for (size_t l = 0; l < lanes; ++l)
+                if (ls.state(l) != LockstepLanes::State::Halted ||
+                    ls.regs(l) != ref[l].regs_ ||
+                    ls.hi(l) != ref[l].hi_ || ls.lo(l) != ref[l].lo_ ||
+                    ls.memory(l) != ref[l].mem_ ||
+                    ls.instructions(l) != ref[l].fastForwarded() ||
+                    ls.pc(l) != ref[l].pc())
+                    ok = false;
+            stats = ls.stats();
+            return t;
+        });
+
+        auto mips = [&](double t) { return static_cast<double>(instrs) / t / 1e6; };
+        cout << k.name << ": " << lanes << " lanes, " << instrs << " instrs\n"
+             << "  pipelines, step loop    " << setw(8) << mips(t_step) << " MIPS\n"
+             << "  pipelines, threaded ff  " << setw(8) << mips(t_thr) << " MIPS\n"
+             << "  lockstep lanes          " << setw(8) << mips(t_lanes) << " MIPS ("
+             << t_thr / t_lanes << "x threaded, " << t_step / t_lanes
+             << "x step loop)\n"
+             << "  " << stats.lanesPerStep() << " lanes/instruction, "
+             << stats.splits << " divergent branches, " << stats.regroups
+             << " regroups\n";
+    }
+    if (!ok) cout << "MISMATCH\n";
+    return ok ? 0 : 1;
+}
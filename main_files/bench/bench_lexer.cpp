@@ -0,0 +1,249 @@
+// bench_lexer.cpp
+// Assembler front-end throughput in source lines per second: the old
+// getline + istringstream parser that main.cpp used to carry (kept here as
+// the reference) against MappedFile + parseLine(). Both parse the same
+// generated file, and the resulting programs are compared. Neither resolves
+// labels; operands are only recorded by instruction index.
+// Build (from main_files/):
+// g++ -std=c++17 -O2 -I. bench/bench_lexer.cpp mips_lexer.cpp -o bench_lexer
+
+#include "mips_core.h"
+#include "mips_ir.hpp"
+#include "mips_lexer.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Branch label operands, keyed by instruction index in the program.
+using LabelTable = unordered_map<uint32_t, string>;
+
+// ---- reference: the pre-lexer parser, unchanged ----
+static Instruction parseInstruction(const string& line, string* label_out) {
+    Instruction instr{};
+    string trimmed = trim(line);
+
+    if (trimmed.empty() || trimmed[0] == '#') {
+        instr.op = Op::NOP;
+        return instr;
+    }
+
+    istringstream iss(trimmed);
+    string token;
+    iss >> token;
+
+    transform(token.begin(), token.end(), token.begin(), ::toupper);
+
+    static const unordered_map<string, Op> opMap = {
+        {"ADD", Op::ADD}, {"ADDI", Op::ADDI}, {"SUB", Op::SUB}, {"MUL", Op::MUL},
+        {"AND", Op::AND}, {"OR", Op::OR}, {"SLL", Op::SLL}, {"SRL", Op::SRL},
+        {"LW", Op::LW}, {"SW", Op::SW}, {"BEQ", Op::BEQ}, {"J", Op::J},
+        {"HALT", Op::HALT}, {"NOP", Op::NOP}
+    };
+
+    auto it = opMap.find(token);
+    if (it == opMap.end()) {
+        cerr << "Unknown instruction: " << token << endl;
+        instr.op = Op::NOP;
+        return instr;
+    }
+    instr.op = it->second;
+
+    string reg1, reg2, reg3;
+
+    switch (instr.op) {
+        case Op::ADD: case Op::SUB: case Op::MUL: case Op::AND: case Op::OR:
+            iss >> reg1;
+            if (iss.peek() == ',') iss.ignore();
+            iss >> reg2;
+            if (iss.peek() == ',') iss.ignore();
+            iss >> reg3;
+            instr.rd = stoi(reg1.substr(reg1.find('$') + 1));
+            instr.rs = stoi(reg2.substr(reg2.find('$') + 1));
+            instr.rt = stoi(reg3.substr(reg3.find('$') + 1));
+            break;
+
+        case Op::SLL: case Op::SRL: {
+            int shamt_val;
+            iss >> reg1;
+            if (iss.peek() == ',') iss.ignore();
+            iss >> reg2;
+            if (iss.peek() == ',') iss.ignore();
+            iss >> shamt_val;
+            instr.shamt = static_cast<uint8_t>(shamt_val);
+            instr.rd = stoi(reg1.substr(reg1.find('$') + 1));
+            instr.rt = stoi(reg2.substr(reg2.find('$') + 1));
+            break;
+        }
+
+        case Op::ADDI:
+            iss >> reg1;
+            if (iss.peek() == ',') iss.ignore();
+            iss >> reg2;
+            if (iss.peek() == ',') iss.ignore();
+            iss >> instr.imm;
+            instr.rt = stoi(reg1.substr(reg1.find('$') + 1));
+            instr.rs = stoi(reg2.substr(reg2.find('$') + 1));
+            break;
+
+        case Op::LW: case Op::SW: {
+            string temp;
+            iss >> reg1;
+            if (iss.peek() == ',') iss.ignore();
+            iss >> temp;
+            instr.rt = stoi(reg1.substr(reg1.find('$') + 1));
+            size_t open = temp.find('(');
+            string offset = temp.substr(0, open);
+            string rs_str = temp.substr(open + 1, temp.find(')') - open - 1);
+            instr.imm = stoi(offset);
+            instr.rs = stoi(rs_str.substr(rs_str.find('$') + 1));
+            break;
+        }
+
+        case Op::BEQ: {
+            iss >> reg1;
+            if (iss.peek() == ',') iss.ignore();
+            iss >> reg2;
+            if (iss.peek() == ',') iss.ignore();
+            string label;
+            iss >> label;
+            instr.rs = stoi(reg1.substr(reg1.find('$') + 1));
+            instr.rt = stoi(reg2.substr(reg2.find('$') + 1));
+            if (label_out) *label_out = label;
+            break;
+        }
+
+        case Op::J:
+            iss >> instr.addr;
+            break;
+
+        case Op::HALT: case Op::NOP:
+            break;
+
+        default:
+            break;
+    }
+    return instr;
+}
+
+static size_t parse_legacy(const string& path, vector<Instruction>& program,
+                           LabelTable& labels) {
+    ifstream file(path);
+    string line, label;
+    size_t lines = 0;
+    while (getline(file, line)) {
+        ++lines;
+        label.clear();
+        Instruction instr = parseInstruction(line, &label);
+        if (instr.op != Op::NOP || !trim(line).empty()) {
+            if (!label.empty())
+                labels.emplace(static_cast<uint32_t>(program.size()), label);
+            program.push_back(instr);
+        }
+    }
+    return lines;
+}
+
+static size_t parse_lexer(const string& path, vector<Instruction>& program,
+                          LabelTable& labels) {
+    MappedFile source(path);
+    string_view text = source.text();
+    size_t lines = 0;
+    const char* p   = text.data();
+    const char* end = p + text.size();
+    Instruction ins;
+    string_view label;
+    while (p < end) {
+        const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+        const char* eol = nl ? nl : end;
+        ++lines;
+        label = {};
+        if (parseLine(string_view(p, eol - p), ins, &label)) {
+            if (!label.empty())
+                labels.emplace(static_cast<uint32_t>(program.size()),
+                               string(label));
+            program.push_back(ins);
+        }
+        p = nl ? nl + 1 : end;
+    }
+    return lines;
+}
+
+// Mnemonics both parsers accept, in the spacing the test programs use.
+static void write_source(const string& path, size_t n) {
+    ofstream out(path);
+    for (size_t i = 0; i < n; ++i) {
+        int a = 1 + i % 31, b = (i * 7) % 32, c = (i * 13) % 32;
+        switch (i % 12) {
+            case 0:  out << "ADDI $" << a << ", $" << b << ", " << (int(i % 2000) - 1000) << "\n"; break;
+            case 1:  out << "ADD $" << a << ", $" << b << ", $" << c << "\n"; break;
+            case 2:  out << "SUB $" << a << ", $" << b << ", $" << c << "\n"; break;
+            case 3:  out << "MUL $" << a << ", $" << b << ", $" << c << "\n"; break;
+            case 4:  out << "and $" << a << ", $" << b << ", $" << c << "\n"; break;
+            case 5:  out << "OR $" << a << ", $" << b << ", $" << c << "\n"; break;
+            case 6:  out << "SLL $" << a << ", $" << b << ", " << i % 32 << "\n"; break;
+            case 7:  out << "SRL $" << a << ", $" << b << ", " << i % 32 << "\n"; break;
+            case 8:  out << "LW $" << a << ", " << 4 * (i % 256) << "($" << b << ")\n"; break;
+            case 9:  out << "SW $" << a << ", " << 4 * (i % 256) << "($" << b << ")\n"; break;
+            case 10: out << "BEQ $" << a << ", $" << b << ", loop" << i % 100 << "\n"; break;
+            case 11: out << (i % 48 == 11 ? "# comment line\n" : "J " + to_string(i % 4096) + "\n"); break;
+        }
+    }
+    out << "HALT\n";
+}
+
+static bool same_program(const vector<Instruction>& x,
+                         const vector<Instruction>& y) {
+    if (x.size() != y.size()) return false;
+    for (size_t i = 0; i < x.size(); ++i) {
+        const Instruction& a = x[i];
+        const Instruction& b = y[i];
+        if (a.op != b.op || a.rs != b.rs || a.rt != b.rt || a.rd != b.rd ||
+            a.shamt != b.shamt || a.imm != b.imm || a.addr != b.addr)
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    size_t n    = (argc > 1) ? stoul(argv[1]) : 500000;
+    int    reps = (argc > 2) ? stoi(argv[2]) : 3;
+    string path = "bench_lexer.asm";
+    write_source(path, n);
+
+    vector<Instruction> progs[2];
+    LabelTable labels[2];
+    double best[2] = {1e30, 1e30};
+    size_t lines = 0;
+    for (int which = 0; which < 2; ++which) {
+        for (int r = 0; r < reps; ++r) {
+            progs[which].clear();
+            labels[which].clear();
+            auto t0 = chrono::steady_clock::now();
+            lines = which ? parse_lexer(path, progs[which], labels[which])
+                          : parse_legacy(path, progs[which], labels[which]);
+            auto t1 = chrono::steady_clock::now();
+            best[which] = min(best[which],
+                              chrono::duration<double>(t1 - t0).count());
+        }
+        cout << (which ? "lexer         " : "istringstream ") << lines
+             << " lines, best " << best[which] * 1e3 << " ms, "
+             << static_cast<double>(lines) / best[which] / 1e6
+             << " M lines/s\n";
+    }
+    cout << "speedup " << best[0] / best[1] << "x\n";
+
+    bool same = same_program(progs[0], progs[1]) && labels[0] == labels[1];
+    cout << "programs " << (same ? "match" : "DIFFER") << "\n";
+    return same ? 0 : 1;
+}
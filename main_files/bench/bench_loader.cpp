@@ -0,0 +1,106 @@
+// bench_loader.cpp
+// Binary loader throughput: encodes a multi-megabyte image of random
+// supported MIPS32 instructions, writes it big- and little-endian, then
+// times MappedFile + loadBinary() and checks every word decodes back to
+// the instruction it was encoded from.
+// Build (from main_files/):
+// g++ -std=c++17 -O2 -I. bench/bench_loader.cpp mips_parser.cpp mips_lexer.cpp -o bench_loader
+
+#include "mips_lexer.h"
+#include "mips_parser.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static uint32_t r_type(int rs, int rt, int rd, int shamt, int funct) {
+    return uint32_t(rs) << 21 | uint32_t(rt) << 16 | uint32_t(rd) << 11 |
+           uint32_t(shamt) << 6 | uint32_t(funct);
+}
+static uint32_t i_type(int opcode, int rs, int rt, int16_t imm) {
+    return uint32_t(opcode) << 26 | uint32_t(rs) << 21 | uint32_t(rt) << 16 |
+           uint16_t(imm);
+}
+
+// Random encodable instruction and the Instruction it must decode to.
+static uint32_t random_word(mt19937& g, Instruction& ins) {
+    int rs = g() % 32, rt = g() % 32, rd = 1 + g() % 31, sh = 1 + g() % 31;
+    int16_t imm = static_cast<int16_t>(g());
+    ins = Instruction{};
+    switch (g() % 12) {
+        case 0:  ins = {Op::ADD, uint8_t(rs), uint8_t(rt), uint8_t(rd)}; return r_type(rs, rt, rd, 0, 0x21);
+        case 1:  ins = {Op::SUB, uint8_t(rs), uint8_t(rt), uint8_t(rd)}; return r_type(rs, rt, rd, 0, 0x23);
+        case 2:  ins = {Op::AND, uint8_t(rs), uint8_t(rt), uint8_t(rd)}; return r_type(rs, rt, rd, 0, 0x24);
+        case 3:  ins = {Op::SLT, uint8_t(rs), uint8_t(rt), uint8_t(rd)}; return r_type(rs, rt, rd, 0, 0x2A);
+        case 4:  ins = {Op::SLL, 0, uint8_t(rt), uint8_t(rd), uint8_t(sh)}; return r_type(0, rt, rd, sh, 0x00);
+        case 5:  ins = {Op::MUL, uint8_t(rs), uint8_t(rt), uint8_t(rd)}; return 0x1Cu << 26 | r_type(rs, rt, rd, 0, 0x02);
+        case 6:  ins = {Op::ADDI, uint8_t(rs), uint8_t(rt), 0, 0, imm}; return i_type(0x09, rs, rt, imm);
+        case 7:  ins = {Op::LW, uint8_t(rs), uint8_t(rt), 0, 0, imm}; return i_type(0x23, rs, rt, imm);
+        case 8:  ins = {Op::SW, uint8_t(rs), uint8_t(rt), 0, 0, imm}; return i_type(0x2B, rs, rt, imm);
+        case 9:  ins = {Op::BNE, uint8_t(rs), uint8_t(rt), 0, 0, imm}; return i_type(0x05, rs, rt, imm);
+        case 10: { uint32_t a = g() & 0x03FFFFFF;
+                   ins.op = Op::J; ins.addr = a; return 0x02u << 26 | a; }
+        default: ins.op = Op::NOP; return 0;
+    }
+}
+
+static void write_image(const string& path, const vector<uint32_t>& words,
+                        ByteOrder order) {
+    vector<unsigned char> bytes(words.size() * 4);
+    for (size_t i = 0; i < words.size(); ++i)
+        for (int k = 0; k < 4; ++k) {
+            int shift = (order == ByteOrder::Big) ? 24 - 8 * k : 8 * k;
+            bytes[4 * i + k] = static_cast<unsigned char>(words[i] >> shift);
+        }
+    ofstream(path, ios::binary).write(reinterpret_cast<const char*>(bytes.data()),
+                                      static_cast<streamsize>(bytes.size()));
+}
+
+static bool same(const Instruction& a, const Instruction& b) {
+    return a.op == b.op && a.rs == b.rs && a.rt == b.rt && a.rd == b.rd &&
+           a.shamt == b.shamt && a.imm == b.imm && a.addr == b.addr;
+}
+
+int main(int argc, char* argv[]) {
+    size_t n    = (argc > 1) ? stoul(argv[1]) : (4u << 20);   // words
+    int    reps = (argc > 2) ? stoi(argv[2]) : 5;
+
+    mt19937 g(42);
+    vector<uint32_t> words(n);
+    vector<Instruction> expect(n);
+    for (size_t i = 0; i < n; ++i) words[i] = random_word(g, expect[i]);
+
+    bool ok = true;
+    for (ByteOrder order : {ByteOrder::Big, ByteOrder::Little}) {
+        string path = order == ByteOrder::Big ? "bench_loader_be.bin"
+                                              : "bench_loader_le.bin";
+        write_image(path, words, order);
+
+        double best = 1e30;
+        BinaryProgram prog;
+        for (int r = 0; r < reps; ++r) {
+            auto t0 = chrono::steady_clock::now();
+            MappedFile image(path);
+            prog = loadBinary(image.text(), order);
+            auto t1 = chrono::steady_clock::now();
+            best = min(best, chrono::duration<double>(t1 - t0).count());
+        }
+
+        size_t bad = prog.unsupported;
+        for (size_t i = 0; i < n; ++i) bad += !same(prog.text[i], expect[i]);
+        ok = ok && bad == 0 && prog.text.size() == n;
+
+        cout << (order == ByteOrder::Big ? "big-endian    " : "little-endian ")
+             << n * 4 / (1 << 20) << " MiB, best " << best * 1e3 << " ms, "
+             << static_cast<double>(n * 4) / best / (1 << 20) << " MiB/s, "
+             << static_cast<double>(n) / best / 1e6 << " M instrs/s"
+             << (bad ? "  MISMATCH" : "") << "\n";
+    }
+    return ok ? 0 : 1;
+}
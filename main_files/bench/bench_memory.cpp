@@ -0,0 +1,109 @@
+// bench_memory.cpp
+// Paged WordMemory against the flat vector<int32_t> it replaced (kept here
+// as the reference): load/store throughput on a streaming and a scattered
+// access pattern, then the cost of many instances sharing one initial
+// image copy-on-write across the full 32-bit address space.
+// Build (from main_files/):
+// g++ -std=c++17 -O2 -pthread -I. bench/bench_memory.cpp mips_pipeline.cpp mips_parallel.cpp mips_cache.cpp mips_branch.cpp mips_iss.cpp mips_threaded.cpp mips_superblock.cpp mips_trace.cpp -o bench_memory
+
+#include "mips_pipeline.h"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// ---- reference: the pre-paging WordMemory, unchanged ----
+class FlatMemory {
+public:
+    explicit FlatMemory(size_t words) : data_(words, 0) {}
+    int32_t load_word(uint32_t byte_addr) const {
+        if (byte_addr % 4 != 0) throw runtime_error("Unaligned LW");
+        size_t idx = byte_addr / 4;
+        if (idx >= data_.size()) throw runtime_error("Out-of-bounds LW");
+        return data_[idx];
+    }
+    void store_word(uint32_t byte_addr, int32_t value) {
+        if (byte_addr % 4 != 0) throw runtime_error("Unaligned SW");
+        size_t idx = byte_addr / 4;
+        if (idx >= data_.size()) throw runtime_error("Out-of-bounds SW");
+        data_[idx] = value;
+    }
+
+private:
+    vector<int32_t> data_;
+};
+
+// Read-modify-write over `addrs`, `reps` times; returns a checksum.
+template <typename Mem>
+static int64_t rmw(Mem& m, const vector<uint32_t>& addrs, int reps) {
+    int64_t sum = 0;
+    for (int r = 0; r < reps; ++r)
+        for (uint32_t a : addrs) {
+            int32_t v = m.load_word(a);
+            sum += v;
+            m.store_word(a, v + 1);
+        }
+    return sum;
+}
+
+template <typename F>
+static double seconds(F&& f) {
+    auto t0 = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char* argv[]) {
+    size_t words     = (argc > 1) ? stoul(argv[1]) : (1u << 16);
+    int    reps      = (argc > 2) ? stoi(argv[2]) : 200;
+    size_t instances = (argc > 3) ? stoul(argv[3]) : 1000;
+
+    vector<uint32_t> stream(words), scatter(words);
+    for (size_t i = 0; i < words; ++i) {
+        stream[i]  = static_cast<uint32_t>(i * 4);
+        // stays within a page for a while, then jumps, like stack/heap mixes
+        scatter[i] = static_cast<uint32_t>(((i * 2654435761u) % words) * 4);
+    }
+
+    bool ok = true;
+    for (auto* pattern : {&stream, &scatter}) {
+        FlatMemory flat(words);
+        WordMemory paged(words);
+        int64_t a = 0, b = 0;
+        double tf = seconds([&] { a = rmw(flat, *pattern, reps); });
+        double tp = seconds([&] { b = rmw(paged, *pattern, reps); });
+        double ops = 2.0 * words * reps;
+        ok = ok && a == b;
+        cout << (pattern == &stream ? "stream " : "scatter") << "  flat "
+             << ops / tf / 1e6 << " M accesses/s, paged " << ops / tp / 1e6
+             << " M accesses/s (" << tf / tp << "x)" << (a == b ? "" : "  MISMATCH")
+             << "\n";
+    }
+
+    // every instance sees the whole 32-bit space and starts from a shared
+    // 64 KiB image; each then dirties one page of its own
+    WordMemory image(WordMemory::kMaxWords);
+    for (uint32_t a = 0; a < 65536; a += 4) image.store_word(a, static_cast<int32_t>(a));
+    vector<WordMemory> copies;
+    copies.reserve(instances);
+    double tc = seconds([&] {
+        for (size_t i = 0; i < instances; ++i) {
+            copies.push_back(image);
+            copies.back().store_word(0x7FFF0000u, static_cast<int32_t>(i));
+        }
+    });
+    size_t pages = 0;
+    for (const WordMemory& c : copies) pages += c.resident_pages();
+    ok = ok && instances > 0 && copies.back().load_word(4096) == 4096 &&
+         copies.back().load_word(0x7FFF0000u) == static_cast<int32_t>(instances - 1) &&
+         image.load_word(0x7FFF0000u) == 0;
+    cout << instances << " instances x 4 GiB: " << tc * 1e3 << " ms to create, "
+         << pages << " resident pages referenced, "
+         << (image.resident_pages() + instances) * WordMemory::kPageBytes / 1024
+         << " KiB of pages allocated\n";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+// bench_predecode.cpp
+// Cycles-per-second of MIPSPipeline with the load-time micro-op table
+// versus re-decoding every instruction in ID and passing that decode on to
+// EX, MEM and WB.
+// Build (from main_files/):
+// g++ -std=c++17 -O2 -pthread -I. bench/bench_predecode.cpp mips_pipeline.cpp mips_parallel.cpp mips_cache.cpp mips_branch.cpp mips_iss.cpp mips_threaded.cpp mips_superblock.cpp mips_trace.cpp -o bench_predecode
+
+#include "mips_pipeline.h"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// Long straight-line ALU/memory mix so the run is dominated by step().
+static vector<Instruction> make_program(size_t n) {
+    vector<Instruction> prog;
+    prog.reserve(n + 1);
+    for (size_t i = 0; i < n; ++i) {
+        Instruction ins{};
+        uint8_t r = static_cast<uint8_t>(1 + i % 20);
+        switch (i % 6) {
+            case 0: ins.op = Op::ADDI; ins.rt = r; ins.rs = r; ins.imm = 3; break;
+            case 1: ins.op = Op::ADD;  ins.rd = r; ins.rs = r; ins.rt = 1;  break;
+            case 2: ins.op = Op::SW;   ins.rt = r; ins.rs = 0; ins.imm = 4 * (i % 64); break;
+            case 3: ins.op = Op::LW;   ins.rt = r; ins.rs = 0; ins.imm = 4 * (i % 64); break;
+            case 4: ins.op = Op::SLL;  ins.rd = r; ins.rt = r; ins.shamt = 1; break;
+            case 5: ins.op = Op::MUL;  ins.rd = r; ins.rs = r; ins.rt = 2;  break;
+        }
+        prog.push_back(ins);
+    }
+    Instruction halt{};
+    halt.op = Op::HALT;
+    prog.push_back(halt);
+    return prog;
+}
+
+static double run_once(const vector<Instruction>& prog, bool predecode,
+                       uint64_t& cycles) {
+    MIPSPipeline sim(prog, 1024, false);
+    sim.setPredecode(predecode);
+    auto t0 = chrono::steady_clock::now();
+    sim.run();
+    auto t1 = chrono::steady_clock::now();
+    cycles = sim.cycles();
+    return chrono::duration<double>(t1 - t0).count();
+}
+
+int main(int argc, char* argv[]) {
+    size_t n    = (argc > 1) ? stoul(argv[1]) : 2000000;
+    int    reps = (argc > 2) ? stoi(argv[2]) : 5;
+    vector<Instruction> prog = make_program(n);
+
+    for (bool predecode : {false, true}) {
+        double best = 1e30;
+        uint64_t cycles = 0;
+        for (int r = 0; r < reps; ++r) {
+            double t = run_once(prog, predecode, cycles);
+            if (t < best) best = t;
+        }
+        cout << (predecode ? "predecoded " : "re-decode  ")
+             << cycles << " cycles, best " << best * 1e3 << " ms, "
+             << static_cast<double>(cycles) / best / 1e6 << " Mcycles/s\n";
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+// bench_sampling.cpp
+// Full cycle-accurate run() against sampled runs (mips_sampling.h) of a
+// program that alternates an ALU phase with a cache-missing memory phase.
+// Reports the time each takes, the estimated cycles against the real
+// count, and whether the real CPI falls inside the SMARTS interval.
+// Checks that every sampled run ends with the registers and memory of the
+// full run.
+// Build (from main_files/):
+// g++ -std=c++17 -O2 -pthread -I. bench/bench_sampling.cpp mips_sampling.cpp mips_parallel.cpp mips_counters.cpp mips_profile.cpp mips_assembler.cpp mips_lexer.cpp mips_pipeline.cpp mips_cache.cpp mips_branch.cpp mips_iss.cpp mips_threaded.cpp mips_superblock.cpp mips_snapshot.cpp mips_trace.cpp -o bench_sampling
+
+#include "mips_assembler.h"
+#include "mips_pipeline.h"
+#include "mips_sampling.h"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// $20 rounds of 2000 ALU iterations, then one pass over 2048 lines
+// (128 KiB: past the L1D, inside the L2)
+static const char* const kPhases =
+    "        ADDI $20, $0, %N%\n"
+    "round:  ADDI $4, $0, 2000\n"
+    "alu:    ADD  $5, $5, $4\n"
+    "        MUL  $6, $5, $5\n"
+    "        SRL  $6, $6, 3\n"
+    "        ADDI $4, $4, -1\n"
+    "        BNE  $4, $0, alu\n"
+    "        ADDI $2, $0, 0\n"
+    "        ADDI $7, $0, 2048\n"
+    "mem:    LW   $3, 0($2)\n"
+    "        ADD  $8, $8, $3\n"
+    "        SW   $8, 0($2)\n"
+    "        ADDI $2, $2, 64\n"
+    "        ADDI $7, $7, -1\n"
+    "        BNE  $7, $0, mem\n"
+    "        ADDI $20, $20, -1\n"
+    "        BNE  $20, $0, round\n"
+    "        HALT\n";
+
+template <class F>
+static double seconds(F&& f) {
+    auto t0 = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char* argv[]) {
+    int rounds = (argc > 1) ? stoi(argv[1]) : 200;
+    string src = kPhases;
+    src.replace(src.find("%N%"), 3, to_string(rounds));
+    AssembledProgram program = assemble(src);
+
+    CacheConfig l2;
+    l2.size_bytes = 256 * 1024;
+    l2.latency    = 10;
+    CacheHierarchyConfig caches{CacheConfig{}, CacheConfig{}, l2, 100};
+    auto make = [&] {
+        MIPSPipeline p(program.text);
+        p.setCaches(caches);
+        p.setBranchPredictor(parsePredictorConfig("bimodal"));
+        p.setFastForwardEngine(FFEngine::Threaded);
+        return p;
+    };
+
+    MIPSPipeline full = make();
+    full.setCounters(true);
+    double t_full = seconds([&] { full.run(); });
+    double real_cpi = full.counters().cpi();
+    cout << fixed << setprecision(3) << "full run: " << full.cycles()
+         << " cycles, " << full.counters().retired << " instructions, CPI "
+         << setprecision(4) << real_cpi << ", " << setprecision(3) << t_full
+         << " s\n";
+
+    const char* const specs[] = {
+        "smarts,interval=10k,window=1000,warmup=2000",
+        "smarts,interval=50k,window=1000,warmup=4000,conf=0.95",
+        "smarts,interval=100k,window=2000,warmup=2000,warm=25k",
+        "smarts,interval=100k,window=2000,warmup=2000,warm=0",
+        "simpoint,interval=22k,k=4,warmup=10k",
+        "simpoint,interval=22k,k=4,warmup=10k,warm=25k",
+        "simpoint,interval=5k,k=10,warmup=5k,warm=25k",
+    };
+    bool ok = true;
+    for (const char* spec : specs) {
+        MIPSPipeline p = make();
+        SampleEstimate est;
+        double t = seconds([&] { est = runSampled(p, parseSamplingConfig(spec)); });
+        if (p.regs_ != full.regs_ || p.mem_ != full.mem_ || !p.isHalted())
+            ok = false;
+        double err = 100.0 * (est.cycles - double(full.cycles())) / double(full.cycles());
+        cout << spec << ": " << setprecision(0) << est.cycles << " cycles ("
+             << showpos << setprecision(2) << err << noshowpos << "%), "
+             << setprecision(3) << t << " s, " << setprecision(1) << t_full / t
+             << "x faster, " << est.samples << " samples";
+        if (est.config.mode == SampleMode::Smarts)
+            cout << ", CPI " << setprecision(4) << est.cpi << " +- " << est.half_width
+                 << (fabs(est.cpi - real_cpi) <= est.half_width ? " (covers"
+                                                                 : " (misses")
+                 << " the real CPI)";
+        cout << "\n";
+    }
+    if (!ok) cout << "MISMATCH\n";
+    return ok ? 0 : 1;
+}
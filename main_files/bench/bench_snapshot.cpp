@@ -0,0 +1,115 @@
+// bench_snapshot.cpp
+// Checkpointed experiments: a kernel sweeping a large memory runs a warm-up
+// prefix, then many short experiments each start from the end of that
+// prefix with one register changed. Compares re-simulating the prefix for
+// every experiment against fork()ing the warmed-up pipeline, and the size
+// and cost of a full snapshot against an incremental one taken a little
+// later, when only the working set has changed. Checks that both ways give
+// the same state for every experiment.
+// Build (from main_files/):
+// g++ -std=c++17 -O2 -pthread -I. bench/bench_snapshot.cpp mips_snapshot.cpp mips_assembler.cpp mips_lexer.cpp mips_pipeline.cpp mips_parallel.cpp mips_cache.cpp mips_branch.cpp mips_iss.cpp mips_threaded.cpp mips_superblock.cpp mips_trace.cpp -o bench_snapshot
+
+#include "mips_assembler.h"
+#include "mips_pipeline.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const char* const kKernel =
+    "# adds the sweep number to one word per page: all 1000 pages on the\n"
+    "# first sweep, then a working set of the first 32\n"
+    "        ADDI $4, $0, 1000\n"
+    "        ADDI $5, $0, 1\n"
+    "sweep:  ADDI $1, $0, 0\n"
+    "        ADD  $2, $4, $0\n"
+    "page:   LW   $3, 0($1)\n"
+    "        ADD  $3, $3, $5\n"
+    "        SW   $3, 0($1)\n"
+    "        ADDI $1, $1, 4096\n"
+    "        ADDI $2, $2, -1\n"
+    "        BNE  $2, $0, page\n"
+    "        ADDI $4, $0, 32\n"
+    "        ADDI $5, $5, 1\n"
+    "        J    sweep\n";
+
+template <typename F>
+static double seconds(F&& f) {
+    auto t0 = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+static uint64_t file_size(const string& path) {
+    ifstream in(path, ios::binary | ios::ate);
+    return static_cast<uint64_t>(in.tellg());
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t prefix      = (argc > 1) ? stoull(argv[1]) : 2000000;
+    uint64_t length      = (argc > 2) ? stoull(argv[2]) : 20000;
+    int      experiments = (argc > 3) ? stoi(argv[3]) : 50;
+    const size_t words   = size_t(1) << 20;   // 4 MiB, 1024 pages
+
+    AssembledProgram program = assemble(kKernel);
+    MIPSPipeline base(program.text, words);
+    base.run(prefix);
+
+    // experiment i: the sweep number jumps to i at the checkpoint
+    auto experiment = [&](MIPSPipeline& p, int i) {
+        p.regs_[5] = i;
+        p.run(prefix + length);
+        return p.stateHash();
+    };
+
+    vector<uint64_t> resim(experiments), forked(experiments);
+    double tr = seconds([&] {
+        for (int i = 0; i < experiments; ++i) {
+            MIPSPipeline p(program.text, words);
+            p.run(prefix);
+            resim[i] = experiment(p, i);
+        }
+    });
+    double tf = seconds([&] {
+        for (int i = 0; i < experiments; ++i) {
+            MIPSPipeline p = base.fork();
+            forked[i] = experiment(p, i);
+        }
+    });
+    bool same = resim == forked;
+
+    cout << experiments << " experiments of " << length << " cycles after a "
+         << prefix << "-cycle prefix\n"
+         << "  re-simulate prefix  " << tr * 1e3 << " ms\n"
+         << "  fork checkpoint     " << tf * 1e3 << " ms  (" << tr / tf << "x)"
+         << (same ? "" : "  MISMATCH") << "\n";
+
+    // a full snapshot of the checkpoint, then an incremental one of the
+    // same run `length` cycles later
+    const string full = "bench_snapshot_full.snap", incr = "bench_snapshot_incr.snap";
+    MIPSPipeline later = base.fork();
+    later.run(prefix + length);
+    double ts_full = seconds([&] { base.saveSnapshot(full); });
+    double ts_incr = seconds([&] { later.saveSnapshot(incr, &base); });
+
+    MIPSPipeline restored(program.text, words);
+    double tl = seconds([&] {
+        restored.loadSnapshot(full);
+        restored.loadSnapshot(incr);
+    });
+    same = same && restored.stateHash() == later.stateHash();
+
+    cout << "  full snapshot       " << file_size(full) / 1024 << " KiB, "
+         << ts_full * 1e3 << " ms to save\n"
+         << "  incremental         " << file_size(incr) / 1024 << " KiB, "
+         << ts_incr * 1e3 << " ms to save\n"
+         << "  restore both        " << tl * 1e3 << " ms"
+         << (same ? "" : "  MISMATCH") << "\n";
+    remove(full.c_str());
+    remove(incr.c_str());
+    return same ? 0 : 1;
+}
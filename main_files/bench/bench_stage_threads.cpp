@@ -0,0 +1,149 @@
+// bench_stage_threads.cpp
+// The cycle-accurate run() on one thread against stage threads (MEM and
+// the data side of the cache model on a second thread), for a few
+// programs and cache models from none to deliberately expensive. Reports
+// simulated cycles per second and checks that both end in the same state:
+// registers, memory, cycles, latches and every cache and predictor counter.
+// Stage threads need a second idle core to win anything; with one core
+// they only show the cost of the handoff.
+// Build (from main_files/):
+// g++ -std=c++17 -O2 -pthread -I. bench/bench_stage_threads.cpp mips_parallel.cpp mips_counters.cpp mips_profile.cpp mips_assembler.cpp mips_lexer.cpp mips_pipeline.cpp mips_cache.cpp mips_branch.cpp mips_iss.cpp mips_threaded.cpp mips_superblock.cpp mips_snapshot.cpp mips_trace.cpp -o bench_stage_threads
+
+#include "mips_assembler.h"
+#include "mips_pipeline.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+// $6 passes over 512 lines 64 bytes apart: every load and store a new line
+static const char* const kStride =
+    "        ADDI $6, $0, %N%\n"
+    "outer:  ADDI $2, $0, 0\n"
+    "        ADDI $7, $0, 512\n"
+    "inner:  LW   $3, 0($2)\n"
+    "        ADD  $5, $5, $3\n"
+    "        SW   $5, 0($2)\n"
+    "        ADDI $2, $2, 64\n"
+    "        ADDI $7, $7, -1\n"
+    "        BNE  $7, $0, inner\n"
+    "        ADDI $6, $6, -1\n"
+    "        BNE  $6, $0, outer\n"
+    "        HALT\n";
+
+// register-only loop: MEM has nothing to do
+static const char* const kAlu =
+    "        ADDI $4, $0, %N%\n"
+    "        ADDI $3, $0, 7\n"
+    "loop:   ADD  $5, $5, $3\n"
+    "        SUB  $6, $5, $4\n"
+    "        AND  $7, $6, $5\n"
+    "        OR   $8, $7, $3\n"
+    "        SLL  $9, $8, 3\n"
+    "        MUL  $12, $9, $3\n"
+    "        ADDI $4, $4, -1\n"
+    "        BNE  $4, $0, loop\n"
+    "        HALT\n";
+
+struct Model {
+    const char* name;
+    optional<CacheHierarchyConfig> caches;
+    optional<PredictorConfig> bp;
+};
+
+static bool same_stats(const Cache* a, const Cache* b) {
+    if (!a || !b) return a == b;
+    const CacheStats& x = a->stats();
+    const CacheStats& y = b->stats();
+    return x.reads == y.reads && x.writes == y.writes &&
+           x.read_misses == y.read_misses && x.write_misses == y.write_misses &&
+           x.evictions == y.evictions && x.writebacks == y.writebacks;
+}
+
+static bool same_end(const MIPSPipeline& a, const MIPSPipeline& b) {
+    const PredictorStats& p = a.branchPredictor().stats();
+    const PredictorStats& q = b.branchPredictor().stats();
+    return a.stateHash() == b.stateHash() && a.cycles() == b.cycles() &&
+           a.caches().stallCycles() == b.caches().stallCycles() &&
+           same_stats(a.caches().l1i(), b.caches().l1i()) &&
+           same_stats(a.caches().l1d(), b.caches().l1d()) &&
+           same_stats(a.caches().l2(), b.caches().l2()) &&
+           p.branches == q.branches && p.taken == q.taken &&
+           p.mispredicts == q.mispredicts && p.btb_misses == q.btb_misses;
+}
+
+template <class F>
+static double seconds(F&& f) {
+    auto t0 = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char* argv[]) {
+    int passes = (argc > 1) ? stoi(argv[1]) : 200;
+    int reps   = (argc > 2) ? stoi(argv[2]) : 3;
+
+    CacheConfig l1;
+    CacheConfig l2;
+    l2.size_bytes = 256 * 1024;
+    l2.latency    = 10;
+    // one set of 1024 ways: every access scans all the tags
+    CacheConfig wide = l1;
+    wide.size_bytes = 64 * 1024;
+    wide.ways       = 1024;
+    CacheConfig wide_l2 = l2;
+    wide_l2.ways = 4096;
+
+    PredictorConfig gshare = parsePredictorConfig("gshare,btb=64");
+    const Model models[] = {
+        {"no caches", nullopt, nullopt},
+        {"L1I/L1D/L2, gshare", CacheHierarchyConfig{l1, l1, l2, 100}, gshare},
+        {"1024-way L1D, 4096-way L2", CacheHierarchyConfig{l1, wide, wide_l2, 100},
+         gshare},
+    };
+    const pair<const char*, const char*> programs[] = {
+        {"stride", kStride}, {"alu", kAlu}};
+
+    cout << thread::hardware_concurrency() << " hardware threads\n"
+         << fixed << setprecision(2);
+    bool ok = true;
+    for (auto [pname, text] : programs) {
+        string src = text;
+        int n = string(pname) == "alu" ? passes * 100 : passes;
+        src.replace(src.find("%N%"), 3, to_string(n));
+        AssembledProgram program = assemble(src);
+
+        for (const Model& m : models) {
+            auto make = [&](bool threads) {
+                MIPSPipeline p(program.text);
+                if (m.caches) p.setCaches(*m.caches);
+                if (m.bp) p.setBranchPredictor(*m.bp);
+                p.setStageThreads(threads);
+                return p;
+            };
+            double best[2] = {1e30, 1e30};
+            uint64_t cycles = 0;
+            for (int r = 0; r < reps; ++r) {
+                MIPSPipeline serial = make(false);
+                MIPSPipeline staged = make(true);
+                best[0] = min(best[0], seconds([&] { serial.run(); }));
+                best[1] = min(best[1], seconds([&] { staged.run(); }));
+                if (!same_end(serial, staged)) ok = false;
+                cycles = serial.cycles();
+            }
+            auto mhz = [&](double t) { return static_cast<double>(cycles) / t / 1e6; };
+            cout << pname << ", " << m.name << ": " << cycles << " cycles\n"
+                 << "  serial         " << setw(8) << mhz(best[0]) << " Mcycles/s\n"
+                 << "  stage threads  " << setw(8) << mhz(best[1]) << " Mcycles/s ("
+                 << best[0] / best[1] << "x)\n";
+        }
+    }
+    if (!ok) cout << "MISMATCH\n";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,405 @@
+// bench_suite.cpp
+// Microbenchmarks for the simulator core in one executable, for tracking
+// regressions between versions: the lexer (parseLine), machine-word decode,
+// the ID-stage decode (MIPSPipeline::predecode), MIPSPipeline::step,
+// WordMemory loads and stores, OutputManager::printFinalState, and
+// end-to-end simulated instructions per second on synthetic kernels (ALU
+// chains, load-use chains, branchy loops, memory streaming).
+//
+// Flags and the JSON layout follow Google Benchmark, so its compare.py can
+// diff two result files:
+//   --benchmark_filter=SUBSTR        run only benchmarks whose name contains it
+//   --benchmark_min_time=SECONDS     per benchmark (default 0.5)
+//   --benchmark_repetitions=N        report each benchmark N times
+//   --benchmark_format=console|json  what goes to stdout
+//   --benchmark_out=FILE             also write JSON to FILE
+// Build (from main_files/):
+// g++ -std=c++17 -O2 -pthread -I. bench/bench_suite.cpp mips_output.cpp mips_parser.cpp mips_assembler.cpp mips_lexer.cpp mips_pipeline.cpp mips_parallel.cpp mips_cache.cpp mips_branch.cpp mips_iss.cpp mips_threaded.cpp mips_superblock.cpp mips_trace.cpp -o bench_suite
+
+#include "mips_assembler.h"
+#include "mips_lexer.h"
+#include "mips_output.h"
+#include "mips_parser.h"
+#include "mips_pipeline.h"
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// ---------------- harness ----------------
+
+// Keeps the compiler from dropping a computation whose result is unused.
+template <typename T>
+static inline void keep(const T& v) {
+    asm volatile("" : : "r,m"(v) : "memory");
+}
+
+// A benchmark runs `iters` iterations of its loop and returns how many
+// items (lines, words, cycles, instructions...) those processed.
+struct Benchmark {
+    const char* name;
+    const char* unit;   // what an item is
+    uint64_t (*run)(uint64_t iters);
+};
+
+struct Result {
+    string name;
+    uint64_t iterations;
+    double real_ns;      // per iteration
+    double cpu_ns;
+    double items_per_second;
+    const char* unit;
+};
+
+static double cpu_seconds() {
+    return double(clock()) / CLOCKS_PER_SEC;
+}
+
+// Grows the iteration count, by 2x to 10x depending on how far the last
+// run fell short, until one run takes min_time, as Google Benchmark does.
+static Result measure(const Benchmark& b, double min_time) {
+    uint64_t iters = 1;
+    for (;;) {
+        auto t0 = chrono::steady_clock::now();
+        double c0 = cpu_seconds();
+        uint64_t items = b.run(iters);
+        double real = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        double cpu  = cpu_seconds() - c0;
+        if (real >= min_time || iters >= (uint64_t(1) << 40))
+            return {b.name, iters, real * 1e9 / iters, cpu * 1e9 / iters,
+                    items / real, b.unit};
+        double grow = real > 0 ? min_time * 1.4 / real : 10.0;
+        iters = max(iters + 1, uint64_t(iters * min(max(grow, 2.0), 10.0)));
+    }
+}
+
+// ---------------- front end ----------------
+
+static const char* const kLines[] = {
+    "loop:   ADD  $3, $1, $2",
+    "        ADDI $5, $5, -1          # count down",
+    "        LW   $4, 8($29)",
+    "        SW   $4, 12($29)",
+    "        BEQ  $5, $0, done",
+    "        SLL  $6, $6, 2",
+    "        MUL  $7, $6, $3",
+    "        J    loop",
+};
+
+static uint64_t bm_parse_line(uint64_t iters) {
+    constexpr size_t n = sizeof kLines / sizeof kLines[0];
+    for (uint64_t i = 0; i < iters; ++i) {
+        Instruction ins;
+        string_view line = kLines[i % n], label;
+        takeLabelDef(line);
+        parseLine(line, ins, &label);
+        keep(ins);
+    }
+    return iters;
+}
+
+// ADD, ADDI, LW, SW, BEQ, SLL, MUL, J as big-endian MIPS32 words
+static const uint32_t kWords[] = {
+    0x00221820, 0x20a5ffff, 0x8fa40008, 0xafa4000c,
+    0x10a00004, 0x00063080, 0x70c33802, 0x08000000,
+};
+
+static uint64_t bm_decode_word(uint64_t iters) {
+    for (uint64_t i = 0; i < iters; ++i) {
+        Instruction ins = toInstruction(decode(kWords[i & 7]));
+        keep(ins);
+    }
+    return iters;
+}
+
+static const vector<Instruction>& sample_program() {
+    static const vector<Instruction> prog = [] {
+        vector<Instruction> p;
+        for (string_view line : kLines) {
+            Instruction ins;
+            takeLabelDef(line);
+            parseLine(line, ins);
+            p.push_back(ins);
+        }
+        return p;
+    }();
+    return prog;
+}
+
+// What ID does per instruction when the micro-op table is off.
+static uint64_t bm_decode_id(uint64_t iters) {
+    const vector<Instruction>& prog = sample_program();
+    for (uint64_t i = 0; i < iters; ++i) {
+        uint32_t k = static_cast<uint32_t>(i & 7);
+        MIPSPipeline::MicroOp u = MIPSPipeline::predecode(prog[k], k * 4);
+        keep(u);
+    }
+    return iters;
+}
+
+// ---------------- pipeline and memory ----------------
+
+// $4 = iterations; a load-use pair, forwarding and a taken branch per pass
+static const char* const kStepKernel =
+    "loop:   SW   $4, 0($0)\n"
+    "        LW   $2, 0($0)\n"
+    "        ADD  $3, $2, $3\n"
+    "        ADDI $5, $3, 1\n"
+    "        SUB  $6, $5, $3\n"
+    "        ADDI $4, $4, -1\n"
+    "        BNE  $4, $0, loop\n"
+    "        HALT\n";
+
+static uint64_t bm_step(uint64_t iters) {
+    static const AssembledProgram program = assemble(kStepKernel);
+    MIPSPipeline p(program.text);
+    p.regs_[4] = 0x7FFFFFFF;   // never halts within a measurement
+    for (uint64_t i = 0; i < iters; ++i) p.step();
+    keep(p.regs_);
+    return iters;
+}
+
+static uint64_t bm_memory_load(uint64_t iters) {
+    WordMemory mem(1u << 16);
+    for (uint32_t a = 0; a < (1u << 18); a += 4096) mem.store_word(a, 1);
+    int32_t sum = 0;
+    for (uint64_t i = 0; i < iters; ++i)
+        sum += mem.load_word(static_cast<uint32_t>(i * 4) & 0x3FFFC);
+    keep(sum);
+    return iters;
+}
+
+static uint64_t bm_memory_store(uint64_t iters) {
+    WordMemory mem(1u << 16);
+    for (uint64_t i = 0; i < iters; ++i)
+        mem.store_word(static_cast<uint32_t>(i * 4) & 0x3FFFC, static_cast<int32_t>(i));
+    keep(mem);
+    return iters;
+}
+
+// Scattered: a new page nearly every access, so the TLB misses.
+static uint64_t bm_memory_scatter(uint64_t iters) {
+    WordMemory mem(1u << 16);
+    int32_t sum = 0;
+    for (uint64_t i = 0; i < iters; ++i) {
+        uint32_t a = static_cast<uint32_t>((i * 2654435761u) & 0xFFFF) * 4;
+        mem.store_word(a, sum);
+        sum += mem.load_word(a);
+    }
+    keep(sum);
+    return 2 * iters;
+}
+
+// Discards whatever is written to it.
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+static uint64_t bm_print_final_state(uint64_t iters) {
+    RegFile regs{};
+    for (int i = 0; i < 32; ++i) regs[i] = i * 1000 - 7;
+    WordMemory mem(1u << 16);
+    for (uint32_t a = 0; a < 256; a += 4) mem.store_word(a, static_cast<int32_t>(a * 3));
+
+    NullBuffer null;
+    streambuf* saved = cout.rdbuf(&null);
+    OutputManager out;
+    for (uint64_t i = 0; i < iters; ++i) out.printFinalState(regs, mem);
+    cout.rdbuf(saved);
+    return iters;
+}
+
+// ---------------- end-to-end kernels ----------------
+
+// $4 = passes over the loop body
+static const char* const kAluChain =
+    "loop:   ADD  $1, $1, $4\n"
+    "        SUB  $2, $1, $2\n"
+    "        AND  $3, $2, $1\n"
+    "        OR   $5, $3, $2\n"
+    "        SLL  $6, $5, 3\n"
+    "        SRL  $7, $6, 1\n"
+    "        MUL  $8, $7, $1\n"
+    "        SLT  $9, $8, $5\n"
+    "        ADD  $1, $9, $8\n"
+    "        ADDI $4, $4, -1\n"
+    "        BNE  $4, $0, loop\n"
+    "        HALT\n";
+
+static const char* const kLoadUseChain =
+    "        SW   $0, 0($0)\n"
+    "loop:   LW   $1, 0($0)\n"
+    "        ADDI $1, $1, 1\n"
+    "        SW   $1, 0($0)\n"
+    "        LW   $2, 0($0)\n"
+    "        ADD  $3, $2, $3\n"
+    "        ADDI $4, $4, -1\n"
+    "        BNE  $4, $0, loop\n"
+    "        HALT\n";
+
+// taken and not-taken branches and a J every pass
+static const char* const kBranchy =
+    "loop:   ADDI $1, $1, 1\n"
+    "        SLT  $2, $1, $5\n"
+    "        BEQ  $2, $0, wrap\n"
+    "        J    next\n"
+    "wrap:   ADDI $1, $0, 0\n"
+    "next:   ADDI $4, $4, -1\n"
+    "        BNE  $4, $0, loop\n"
+    "        HALT\n";
+
+// sums and copies a 16 KiB block forward, touching a new line every 16 words
+static const char* const kMemStream =
+    "loop:   LW   $1, 0($6)\n"
+    "        LW   $2, 4($6)\n"
+    "        ADD  $3, $3, $1\n"
+    "        ADD  $3, $3, $2\n"
+    "        SW   $3, 16384($6)\n"
+    "        ADDI $6, $6, 8\n"
+    "        ADDI $7, $6, -16384\n"
+    "        BNE  $7, $0, cont\n"
+    "        ADDI $6, $0, 0\n"
+    "cont:   ADDI $4, $4, -1\n"
+    "        BNE  $4, $0, loop\n"
+    "        HALT\n";
+
+// One iteration is a whole run of `source` with $4 = passes ($5 = 7 for
+// the branchy kernel); items are retired instructions, counted once.
+template <const char* const* Source>
+static uint64_t bm_kernel(uint64_t iters) {
+    constexpr int32_t kPasses = 2000;
+    static const AssembledProgram program = assemble(*Source);
+    static const uint64_t retired = [] {
+        MIPSPipeline p(program.text);
+        p.regs_[4] = kPasses;
+        p.regs_[5] = 7;
+        p.setCounters(true);
+        p.run();
+        return p.counters().retired;
+    }();
+    for (uint64_t i = 0; i < iters; ++i) {
+        MIPSPipeline p(program.text);
+        p.regs_[4] = kPasses;
+        p.regs_[5] = 7;
+        p.run();
+        keep(p.regs_);
+    }
+    return iters * retired;
+}
+
+static const Benchmark kBenchmarks[] = {
+    {"BM_ParseLine",          "lines",        bm_parse_line},
+    {"BM_DecodeWord",         "words",        bm_decode_word},
+    {"BM_DecodeInID",         "instructions", bm_decode_id},
+    {"BM_PipelineStep",       "cycles",       bm_step},
+    {"BM_MemoryLoad",         "loads",        bm_memory_load},
+    {"BM_MemoryStore",        "stores",       bm_memory_store},
+    {"BM_MemoryScatter",      "accesses",     bm_memory_scatter},
+    {"BM_PrintFinalState",    "calls",        bm_print_final_state},
+    {"BM_Kernel/alu_chain",   "instructions", bm_kernel<&kAluChain>},
+    {"BM_Kernel/load_use",    "instructions", bm_kernel<&kLoadUseChain>},
+    {"BM_Kernel/branchy",     "instructions", bm_kernel<&kBranchy>},
+    {"BM_Kernel/mem_stream",  "instructions", bm_kernel<&kMemStream>},
+};
+
+// ---------------- reporting ----------------
+
+static void write_json(ostream& os, const vector<Result>& results) {
+    char date[32];
+    time_t now = time(nullptr);
+    strftime(date, sizeof date, "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    os << "{\n  \"context\": {\n    \"date\": \"" << date
+       << "\",\n    \"executable\": \"bench_suite\",\n    \"num_cpus\": "
+       << thread::hardware_concurrency()
+#ifdef NDEBUG
+       << ",\n    \"library_build_type\": \"release\"\n  },\n"
+#else
+       << ",\n    \"library_build_type\": \"debug\"\n  },\n"
+#endif
+       << "  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        os << (i ? ",\n" : "\n") << "    {\n      \"name\": \"" << r.name
+           << "\",\n      \"run_name\": \"" << r.name
+           << "\",\n      \"run_type\": \"iteration\",\n      \"iterations\": "
+           << r.iterations << ",\n      \"real_time\": " << r.real_ns
+           << ",\n      \"cpu_time\": " << r.cpu_ns
+           << ",\n      \"time_unit\": \"ns\",\n      \"items_per_second\": "
+           << r.items_per_second << ",\n      \"label\": \"" << r.unit
+           << "\"\n    }";
+    }
+    os << "\n  ]\n}\n";
+}
+
+static void write_console_row(ostream& os, const Result& r) {
+    os << left << setw(24) << r.name << right << fixed << setprecision(1)
+       << setw(14) << r.real_ns << " ns" << setw(14) << r.cpu_ns << " ns"
+       << setw(14) << r.iterations << setprecision(2) << setw(12)
+       << r.items_per_second / 1e6 << "M " << r.unit << "/s\n"
+       << defaultfloat;
+}
+
+int main(int argc, char* argv[]) {
+    string filter, out_path;
+    double min_time = 0.5;
+    int reps = 1;
+    bool json = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        auto value = [&](const char* flag) -> const char* {
+            size_t n = char_traits<char>::length(flag);
+            return arg.compare(0, n, flag) == 0 ? argv[i] + n : nullptr;
+        };
+        if (const char* v = value("--benchmark_filter="))          filter = v;
+        else if (const char* v = value("--benchmark_min_time="))   min_time = stod(v);
+        else if (const char* v = value("--benchmark_repetitions=")) reps = stoi(v);
+        else if (const char* v = value("--benchmark_out="))        out_path = v;
+        else if (const char* v = value("--benchmark_format=")) {
+            json = string(v) == "json";
+            if (!json && string(v) != "console") {
+                cerr << "bench_suite: unknown format '" << v << "'\n";
+                return 1;
+            }
+        } else {
+            cerr << "Usage: " << argv[0] << " [--benchmark_filter=SUBSTR]"
+                    " [--benchmark_min_time=S] [--benchmark_repetitions=N]"
+                    " [--benchmark_format=console|json] [--benchmark_out=FILE]\n";
+            return 1;
+        }
+    }
+
+    if (!json)
+        cout << left << setw(24) << "Benchmark" << right << setw(17) << "Time"
+             << setw(17) << "CPU" << setw(14) << "Iterations" << "  Throughput\n"
+             << string(98, '-') << "\n";
+    vector<Result> results;
+    for (const Benchmark& b : kBenchmarks) {
+        if (string_view(b.name).find(filter) == string_view::npos) continue;
+        for (int r = 0; r < reps; ++r) {
+            results.push_back(measure(b, min_time));
+            if (!json) write_console_row(cout, results.back());
+        }
+    }
+
+    if (json) write_json(cout, results);
+    if (!out_path.empty()) {
+        ofstream out(out_path);
+        if (!out) {
+            cerr << "bench_suite: cannot open " << out_path << "\n";
+            return 1;
+        }
+        write_json(out, results);
+    }
+    return 0;
+}
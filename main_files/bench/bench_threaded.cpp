@@ -0,0 +1,145 @@
+// bench_threaded.cpp
+// Loop-heavy kernels run four ways: the cycle-accurate step() loop, the
+// functional interpreter, the direct-threaded engine and the superblock
+// engine. Reports simulated MIPS (millions of MIPS instructions per host
+// second) and checks the superblock cycle replay against step().
+// Build (from main_files/):
+// g++ -std=c++17 -O2 -pthread -I. bench/bench_threaded.cpp mips_pipeline.cpp mips_parallel.cpp mips_cache.cpp mips_branch.cpp mips_iss.cpp mips_threaded.cpp mips_superblock.cpp mips_trace.cpp -o bench_threaded
+
+#include "mips_pipeline.h"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static Instruction R(Op op, int rd, int rs, int rt) {
+    Instruction i{}; i.op = op; i.rd = rd; i.rs = rs; i.rt = rt; return i;
+}
+static Instruction I(Op op, int rt, int rs, int imm) {
+    Instruction i{}; i.op = op; i.rt = rt; i.rs = rs; i.imm = imm; return i;
+}
+static Instruction S(Op op, int rd, int rt, int shamt) {
+    Instruction i{}; i.op = op; i.rd = rd; i.rt = rt; i.shamt = shamt; return i;
+}
+static Instruction halt() {
+    Instruction i{}; i.op = Op::HALT; return i;
+}
+
+struct Kernel {
+    string name;
+    vector<Instruction> prog;
+};
+
+// r1 counts down from `iters`; each branch offset is relative to pc + 4.
+static vector<Kernel> kernels(int iters) {
+    vector<Kernel> k;
+
+    // ADDI immediates are 16-bit, so build the count as (iters / 256) << 8
+    k.push_back({"alu_loop", {
+        I(Op::ADDI, 1, 0, iters >> 8),
+        S(Op::SLL,  1, 1, 8),
+        R(Op::ADD, 2, 2, 1),
+        R(Op::SUB, 3, 2, 1),
+        R(Op::AND, 4, 3, 2),
+        R(Op::OR,  5, 4, 1),
+        S(Op::SLL, 6, 5, 2),
+        S(Op::SRL, 7, 6, 1),
+        R(Op::SLT, 8, 7, 2),
+        R(Op::MUL, 9, 8, 1),
+        I(Op::ADDI, 1, 1, -1),
+        I(Op::BNE, 1, 0, -10),
+        halt()}});
+
+    // sum a 256-word array in place, iters / 256 times over
+    k.push_back({"mem_stream", {
+        I(Op::ADDI, 1, 0, iters / 256 + 1),
+        I(Op::ADDI, 2, 0, 0),              // outer: r2 = byte offset
+        I(Op::ADDI, 5, 0, 1024),
+        I(Op::LW,   3, 2, 0),              // inner
+        R(Op::ADD,  4, 4, 3),
+        I(Op::SW,   4, 2, 0),
+        I(Op::ADDI, 2, 2, 4),
+        I(Op::BNE,  2, 5, -5),
+        I(Op::ADDI, 1, 1, -1),
+        I(Op::BNE,  1, 0, -9),
+        halt()}});
+
+    // nested counted loops with a load-use pair and a J back-edge
+    k.push_back({"nested_jump", {
+        I(Op::ADDI, 1, 0, iters / 16 + 1),
+        I(Op::ADDI, 2, 0, 16),             // outer
+        I(Op::SW,   2, 0, 64),             // inner
+        I(Op::LW,   3, 0, 64),
+        R(Op::ADD,  4, 4, 3),
+        I(Op::ADDI, 2, 2, -1),
+        I(Op::BEQ,  2, 0, 1),
+        [] { Instruction j{}; j.op = Op::J; j.addr = 2; return j; }(),
+        I(Op::ADDI, 1, 1, -1),
+        I(Op::BNE,  1, 0, -9),
+        halt()}});
+    return k;
+}
+
+template <class F>
+static double best_of(int reps, F&& f) {
+    double best = 1e30;
+    for (int r = 0; r < reps; ++r) {
+        auto t0 = chrono::steady_clock::now();
+        f();
+        auto t1 = chrono::steady_clock::now();
+        best = min(best, chrono::duration<double>(t1 - t0).count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    int iters = (argc > 1) ? stoi(argv[1]) : 200000;
+    int reps  = (argc > 2) ? stoi(argv[2]) : 5;
+
+    for (const Kernel& k : kernels(iters)) {
+        uint64_t instrs = 0;
+        {
+            MIPSPipeline sim(k.prog, 1024, false);
+            instrs = sim.fastForward(UINT64_MAX);
+        }
+
+        uint64_t cycles = 0;
+        double t_pipe = best_of(reps, [&] {
+            MIPSPipeline sim(k.prog, 1024, false);
+            sim.run();
+            cycles = sim.cycles();
+        });
+        double t_iss = best_of(reps, [&] {
+            MIPSPipeline sim(k.prog, 1024, false);
+            sim.fastForward(UINT64_MAX);
+        });
+        double t_thr = best_of(reps, [&] {
+            MIPSPipeline sim(k.prog, 1024, false);
+            sim.setFastForwardEngine(FFEngine::Threaded);
+            sim.fastForward(UINT64_MAX);
+        });
+        uint64_t replayed = 0;
+        double t_sb = best_of(reps, [&] {
+            MIPSPipeline sim(k.prog, 1024, false);
+            sim.setFastForwardEngine(FFEngine::Superblock);
+            sim.fastForward(UINT64_MAX);
+            replayed = sim.fastForwardCycleEstimate();
+        });
+
+        auto mips = [&](double t) { return static_cast<double>(instrs) / t / 1e6; };
+        cout << k.name << ": " << instrs << " instrs, " << cycles << " cycles\n"
+             << "  step loop    " << mips(t_pipe) << " MIPS\n"
+             << "  interpreter  " << mips(t_iss)  << " MIPS\n"
+             << "  threaded     " << mips(t_thr)  << " MIPS ("
+             << t_iss / t_thr << "x interpreter, "
+             << t_pipe / t_thr << "x step loop)\n"
+             << "  superblock   " << mips(t_sb)   << " MIPS ("
+             << t_iss / t_sb << "x interpreter, "
+             << t_pipe / t_sb << "x step loop), replayed " << replayed
+             << " cycles" << (replayed == cycles ? "" : " (MISMATCH)") << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+// bench_trace.cpp
+// Cost of per-cycle tracing: MIPSPipeline::run() with no trace, with the
+// binary trace (setTraceFile) and with the text trace on stdout redirected
+// to a file. Also checks that decoding the binary trace reproduces the
+// text trace byte for byte.
+// Build (from main_files/):
+// g++ -std=c++17 -O2 -pthread -I. bench/bench_trace.cpp mips_pipeline.cpp mips_parallel.cpp mips_cache.cpp mips_branch.cpp mips_iss.cpp mips_threaded.cpp mips_superblock.cpp mips_trace.cpp -o bench_trace
+
+#include "mips_pipeline.h"
+#include "mips_trace.h"
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Same straight-line mix as bench_predecode.
+static vector<Instruction> make_program(size_t n) {
+    vector<Instruction> prog;
+    prog.reserve(n + 1);
+    for (size_t i = 0; i < n; ++i) {
+        Instruction ins{};
+        uint8_t r = static_cast<uint8_t>(1 + i % 20);
+        switch (i % 6) {
+            case 0: ins.op = Op::ADDI; ins.rt = r; ins.rs = r; ins.imm = 3; break;
+            case 1: ins.op = Op::ADD;  ins.rd = r; ins.rs = r; ins.rt = 1;  break;
+            case 2: ins.op = Op::SW;   ins.rt = r; ins.rs = 0; ins.imm = 4 * (i % 64); break;
+            case 3: ins.op = Op::LW;   ins.rt = r; ins.rs = 0; ins.imm = 4 * (i % 64); break;
+            case 4: ins.op = Op::SLL;  ins.rd = r; ins.rt = r; ins.shamt = 1; break;
+            case 5: ins.op = Op::MUL;  ins.rd = r; ins.rs = r; ins.rt = 2;  break;
+        }
+        prog.push_back(ins);
+    }
+    Instruction halt{};
+    halt.op = Op::HALT;
+    prog.push_back(halt);
+    return prog;
+}
+
+enum class Mode { None, Binary, Text };
+
+static double run_once(const vector<Instruction>& prog, Mode mode,
+                       const string& bin_path, const string& txt_path,
+                       uint64_t& cycles) {
+    ofstream txt;
+    streambuf* saved = nullptr;
+    if (mode == Mode::Text) {
+        txt.open(txt_path);
+        saved = cout.rdbuf(txt.rdbuf());
+    }
+    auto sim = make_unique<MIPSPipeline>(prog, 1024, mode == Mode::Text);
+    if (mode == Mode::Binary) sim->setTraceFile(bin_path);
+    auto t0 = chrono::steady_clock::now();
+    sim->run();
+    cycles = sim->cycles();
+    sim.reset();   // flushes and closes the trace file
+    cout.flush();
+    auto t1 = chrono::steady_clock::now();
+    if (saved) cout.rdbuf(saved);
+    return chrono::duration<double>(t1 - t0).count();
+}
+
+int main(int argc, char* argv[]) {
+    size_t n    = (argc > 1) ? stoul(argv[1]) : 1000000;
+    int    reps = (argc > 2) ? stoi(argv[2]) : 3;
+    string bin_path = "bench_trace.bin";
+    string txt_path = "bench_trace.txt";
+    vector<Instruction> prog = make_program(n);
+
+    double base = 0;
+    for (Mode mode : {Mode::None, Mode::Binary, Mode::Text}) {
+        double best = 1e30;
+        uint64_t cycles = 0;
+        for (int r = 0; r < reps; ++r) {
+            double t = run_once(prog, mode, bin_path, txt_path, cycles);
+            if (t < best) best = t;
+        }
+        if (mode == Mode::None) base = best;
+        cout << (mode == Mode::None   ? "no trace     " :
+                 mode == Mode::Binary ? "binary trace " : "text trace   ")
+             << static_cast<double>(cycles) / best / 1e6 << " Mcycles/s ("
+             << best / base << "x untraced time)\n";
+    }
+
+    // decode the binary trace and compare with the text one
+    ostringstream decoded;
+    TraceReader in(bin_path);
+    TraceRecord rec{};
+    uint64_t cycle = 0;
+    while (in.next(rec, cycle))
+        formatTraceRecord(decoded, rec, cycle, in.program());
+    ifstream txt(txt_path);
+    ostringstream text;
+    text << txt.rdbuf();
+    bool same = decoded.str() == text.str();
+    cout << "decoded binary trace " << (same ? "matches" : "DIFFERS from")
+         << " text trace\n";
+    return same ? 0 : 1;
+}
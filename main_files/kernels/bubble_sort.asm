@@ -0,0 +1,22 @@
+# Bubble sort of `array` in place (ascending).
+        .data
+n:      .word 8
+array:  .word 29, 3, 17, 8, 42, 1, 23, 11
+
+        .text
+        LW   $10, n($0)         # $10 = n
+outer:  ADDI $10, $10, -1       # comparisons in this pass
+        BEQ  $10, $0, done
+        ADDI $1, $0, array      # $1 = &array[0]
+        ADD  $2, $10, $0        # $2 = comparisons left
+inner:  LW   $3, 0($1)
+        LW   $4, 4($1)
+        SLT  $5, $4, $3         # array[i + 1] < array[i] ?
+        BEQ  $5, $0, noswap
+        SW   $4, 0($1)
+        SW   $3, 4($1)
+noswap: ADDI $1, $1, 4
+        ADDI $2, $2, -1
+        BNE  $2, $0, inner
+        J    outer
+done:   HALT
@@ -0,0 +1,21 @@
+# Dot product of two 8-element vectors (= 120) into $3 and `dot`.
+        .data
+xs:     .word 1, 2, 3, 4, 5, 6, 7, 8
+ys:     .word 8, 7, 6, 5, 4, 3, 2, 1
+dot:    .word 0
+
+        .text
+        ADDI $1, $0, xs
+        ADDI $2, $0, ys
+        ADDI $6, $0, 8          # elements left
+        ADDI $3, $0, 0
+loop:   LW   $4, 0($1)
+        LW   $5, 0($2)
+        MUL  $7, $4, $5
+        ADD  $3, $3, $7
+        ADDI $1, $1, 4
+        ADDI $2, $2, 4
+        ADDI $6, $6, -1
+        BNE  $6, $0, loop
+        SW   $3, dot($0)
+        HALT
@@ -0,0 +1,16 @@
+# Iterative Fibonacci: fib(20) = 6765 ends up in $1 and in `result`.
+        .text
+        ADDI $1, $0, 0          # $1 = fib(i)
+        ADDI $2, $0, 1          # $2 = fib(i + 1)
+        ADDI $5, $0, 20         # $5 = iterations left
+loop:   BEQ  $5, $0, done
+        ADD  $3, $1, $2
+        ADD  $1, $2, $0
+        ADD  $2, $3, $0
+        ADDI $5, $5, -1
+        J    loop
+done:   SW   $1, result($0)
+        HALT
+
+        .data
+result: .word 0
@@ -0,0 +1,13 @@
+# Numbers in .data and .text may be decimal or 0x hex: the words below
+# and a hex-sized .space gap, then a sum of them into $3 (0x7FFF + 0x3F = 32830).
+        .data
+words:  .word 0x10, -0x2, 0xFFFFFFFF, 0x7FFF
+gap:    .space 0x10
+tail:   .word 0x3F
+
+        .text
+        LW   $1, 12($0)         # 0x7FFF
+        LW   $2, tail($0)       # 0x3F, after the 16-byte gap
+        ADD  $3, $1, $2
+        ORI  $4, $0, 0xFFFF
+        HALT
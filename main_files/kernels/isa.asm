@@ -0,0 +1,125 @@
+# The rest of the MIPS32 integer ISA: upper/zero-extended immediates,
+# unsigned compares, arithmetic and variable shifts, sub-word loads and
+# stores, MULT/DIV through HI/LO, every conditional branch, and calls
+# through JAL, JALR and JR. Each result is folded into a checksum by
+# `mix`; the checksum (900321761) ends up in $2 and in `sum`.
+        .data
+bytes:  .word -2130771585       # bytes 7F 01 FF 80 from the lowest address
+sum:    .word 0
+
+        .text
+        ADDI  $2, $0, 0
+        # immediates
+        LUI   $4, 0x1234
+        ORI   $4, $4, 0xABCD    # 0x1234ABCD
+        JAL   mix
+        ANDI  $4, $4, 0xFF0F    # 0xAB0D
+        XORI  $4, $4, 0xFFFF    # 0x54F2
+        JAL   mix
+        ADDI  $5, $0, -1
+        SLTI  $4, $5, 0         # 1
+        SLTIU $6, $5, 0         # 0: 0xFFFFFFFF is not below 0
+        ADD   $4, $4, $6
+        SLTU  $6, $0, $5        # 1
+        ADD   $4, $4, $6
+        SLT   $6, $0, $5        # 0
+        ADD   $4, $4, $6
+        JAL   mix
+        NOR   $4, $4, $0
+        JAL   mix
+        # shifts
+        LUI   $20, 0x8000
+        SRA   $4, $20, 4        # 0xF8000000
+        JAL   mix
+        ADDI  $7, $0, 36        # shift amounts use the low 5 bits: 4
+        SRAV  $4, $20, $7       # 0xF8000000
+        SRLV  $6, $20, $7       # 0x08000000
+        ADD   $4, $4, $6
+        SLLV  $6, $5, $7        # 0xFFFFFFF0
+        XOR   $4, $4, $6
+        JAL   mix
+        # sub-word memory
+        ADDI  $10, $0, bytes
+        LB    $4, 3($10)        # -128
+        JAL   mix
+        LBU   $4, 3($10)        # 128
+        JAL   mix
+        LH    $4, 2($10)        # 0x80FF: -32513
+        JAL   mix
+        LHU   $4, 0($10)        # 0x017F
+        JAL   mix
+        SB    $5, 0($10)        # 0x80FF01FF
+        ADDI  $11, $0, 0x1234
+        SH    $11, 2($10)       # 0x123401FF
+        LW    $4, 0($10)
+        JAL   mix
+        # HI/LO
+        ADDI  $12, $0, -7
+        ADDI  $13, $0, 3
+        MULT  $12, $13          # hi -1, lo -21
+        MFHI  $4
+        JAL   mix
+        MFLO  $4
+        JAL   mix
+        MULTU $12, $13          # hi 2, lo 0xFFFFFFEB
+        MFHI  $4
+        JAL   mix
+        MFLO  $4
+        JAL   mix
+        DIV   $12, $13          # lo -2, hi -1
+        MFLO  $4
+        JAL   mix
+        MFHI  $4
+        JAL   mix
+        DIVU  $12, $13          # lo 1431655763, hi 0
+        MFLO  $4
+        JAL   mix
+        MFHI  $4
+        JAL   mix
+        MTHI  $11
+        MTLO  $13
+        MFHI  $4
+        JAL   mix
+        MFLO  $4
+        JAL   mix
+        # every branch condition, for -2..2
+        ADDI  $14, $0, 0
+        ADDI  $15, $0, -2
+br:     BLEZ  $15, le
+        ADDI  $14, $14, 1
+le:     BGTZ  $15, gt
+        ADDI  $14, $14, 2
+gt:     BLTZ  $15, lt
+        ADDI  $14, $14, 4
+lt:     BGEZ  $15, ge
+        ADDI  $14, $14, 8
+ge:     SLL   $14, $14, 1
+        ADDI  $15, $15, 1
+        SLTI  $16, $15, 3
+        BNE   $16, $0, br
+        ADD   $4, $14, $0
+        JAL   mix
+        # indirect calls, and the return addresses they leave
+        ADD   $4, $31, $0
+        JAL   mix
+        ADDI  $17, $0, mix
+        ADDI  $4, $0, 99
+        JALR  $17
+        ADDI  $17, $0, twice
+        JALR  $18, $17
+        JAL   mix
+        ADD   $4, $18, $0
+        JAL   mix
+        SW    $2, sum($0)
+        HALT
+
+# $2 = rotl($2, 5) ^ $4
+mix:    SLL   $8, $2, 5
+        SRL   $9, $2, 27
+        OR    $8, $8, $9
+        XOR   $2, $8, $4
+        JR    $31
+
+# $4 = 2 * $4, returning through $18
+twice:  ADD   $4, $4, $4
+        JR    $18
@@ -0,0 +1,16 @@
+# Sum a 16-word array; the total (80) ends up in $3 and in `total`.
+        .data
+array:  .word 3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5, 8, 9, 7, 9, 3
+total:  .word 0
+
+        .text
+        ADDI $1, $0, array      # $1 = pointer
+        ADDI $2, $0, 16         # $2 = words left
+        ADDI $3, $0, 0          # $3 = sum
+loop:   LW   $4, 0($1)
+        ADD  $3, $3, $4
+        ADDI $1, $1, 4
+        ADDI $2, $2, -1
+        BNE  $2, $0, loop
+        SW   $3, total($0)
+        HALT
@@ -1,161 +1,430 @@
 //main.cpp
 #include "mips_ir.hpp"
-#include "mips_core.h"
+#include "mips_assembler.h"
+#include "mips_batch.h"
+#include "mips_lexer.h"
+#include "mips_parser.h"
 #include "mips_pipeline.h"
+#include "mips_program_cache.h"
+#include "mips_sampling.h"
 #include "mips_output.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
 #include <fstream>
-#include <sstream>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <vector>
 #include <string>
 #include <iostream>
-#include <unordered_map>
-#include <algorithm>
-#include <cctype>
 
 using namespace std;
 
-Instruction parseInstruction(const string& line) {
-    Instruction instr{};
-    string trimmed = trim(line);
-
-    if (trimmed.empty() || trimmed[0] == '#') {
-        instr.op = Op::NOP;
-        return instr;
-    }
-
-    istringstream iss(trimmed);
-    string token;
-    iss >> token;
-
-    transform(token.begin(), token.end(), token.begin(), ::toupper);
-
-    static const unordered_map<string, Op> opMap = {
-        {"ADD", Op::ADD}, {"ADDI", Op::ADDI}, {"SUB", Op::SUB}, {"MUL", Op::MUL},
-        {"AND", Op::AND}, {"OR", Op::OR}, {"SLL", Op::SLL}, {"SRL", Op::SRL},
-        {"LW", Op::LW}, {"SW", Op::SW}, {"BEQ", Op::BEQ}, {"J", Op::J},
-        {"HALT", Op::HALT}, {"NOP", Op::NOP}
-    };
+static void usage(const char* prog) {
+    cerr << "Usage: " << prog << " [--ff N] [--ff-pc ADDR] [--ff-engine E]"
+            " [--event-skip] [--stage-threads] [--trace FILE] [--bin ORDER]\n"
+            "         [--bin-base ADDR] [--cache] [--load-snapshot FILE]..."
+            " [--save-snapshot FILE]\n"
+            "         [--l1i SPEC] [--l1d SPEC] [--l2 SPEC]"
+            " [--mem-latency N] [--bp SPEC]\n"
+            "         [--counters FILE] [--profile] [--profile-top N]"
+            " [--sample SPEC]\n"
+            "         [--changed-only] [input_file]\n"
+         << "       " << prog << " --batch MANIFEST [--jobs N] [--max-cycles N]"
+            " [--report FILE] [--event-skip] [--cache]\n"
+         << "  --ff N         execute the first N instructions functionally\n"
+         << "  --ff-pc ADDR   fast-forward until the PC reaches ADDR\n"
+         << "  --ff-engine E  fast-forward engine: interp (default), threaded"
+            " or superblock\n"
+         << "  --event-skip   batch hazard-free straight-line cycles"
+            " (same results)\n"
+         << "  --stage-threads  run MEM and the data caches on a second thread"
+            " (same results;\n"
+         << "                 experimental)\n"
+         << "  --trace FILE   write a binary per-cycle trace to FILE"
+            " (decode with tools/mips_trace_dump)\n"
+         << "  --bin ORDER    input is raw MIPS32 machine code, big or little"
+            " endian\n"
+         << "                 (implied big for *.bin; ELF files are detected)\n"
+         << "  --bin-base A   load address of a raw image (default 0)\n"
+         << "  --cache        reuse (or create) input_file.pcache instead of"
+            " assembling\n"
+         << "  --batch M      run every job in manifest M in parallel and print"
+            " a JSON report\n"
+         << "  --jobs N       worker threads for --batch (default: all cores)\n"
+         << "  --max-cycles N stop each batch job after N cycles\n"
+         << "  --report FILE  write the batch report to FILE instead of"
+            " stdout\n"
+         << "  --load-snapshot FILE  resume from a snapshot instead of the"
+            " initial state;\n"
+         << "                 repeat to apply incremental snapshots in order\n"
+         << "  --save-snapshot FILE  snapshot the state reached after"
+            " fast-forwarding\n"
+         << "                 (incremental when a snapshot was loaded)\n"
+         << "  --l1i/--l1d/--l2 SPEC  model that cache level and stall on"
+            " misses;\n"
+         << "                 SPEC is key=value,... over the defaults, e.g."
+            " size=64k,ways=4,\n"
+         << "                 line=32,repl=lru|fifo|random,write=back|through,"
+            "alloc=yes|no,lat=2\n"
+         << "                 or 'default' (L1: 32k/8-way/64B/1 cycle,"
+            " L2: 256k/8-way/64B/10)\n"
+         << "  --mem-latency N  main memory latency behind the caches"
+            " (default 100)\n"
+         << "  --bp SPEC      branch predictor in IF: nottaken (default),"
+            " btfn, bimodal or\n"
+         << "                 gshare, optionally with ,bits=N,history=N,btb=N"
+            " (e.g. gshare,btb=64)\n"
+         << "  --counters FILE  write performance counters to FILE at the end:"
+            " CSV if it\n"
+         << "                 ends in .csv, JSON otherwise; - for stdout\n"
+         << "  --sample SPEC  estimate cycles from samples instead of simulating"
+            " every cycle:\n"
+         << "                 smarts or simpoint, optionally with"
+            " ,interval=N,window=N,warmup=N,\n"
+         << "                 warm=N|all, conf=F,error=F (smarts) or k=N"
+            " (simpoint),\n"
+         << "                 e.g. smarts,interval=100k,warm=20k\n"
+         << "  --changed-only  print only the registers and memory rows the"
+            " run changed,\n"
+         << "                 anywhere in memory\n"
+         << "  --profile      print the source annotated with the cycles,"
+            " stalls, flushes\n"
+         << "                 and executions of each instruction, hottest"
+            " first\n"
+         << "  --profile-top N  only the N hottest instructions (implies"
+            " --profile)\n";
+}
 
-    auto it = opMap.find(token);
-    if (it == opMap.end()) {
-        cerr << "Unknown instruction: " << token << endl;
-        instr.op = Op::NOP;
-        return instr;
+// --batch: parse the manifest, run it and write the report.
+static int runBatchMode(const string& manifest_path, const char* report_path,
+                        const BatchOptions& opts) {
+    vector<BatchJob> jobs;
+    try {
+        MappedFile manifest(manifest_path);
+        size_t slash = manifest_path.find_last_of('/');
+        jobs = parseManifest(manifest.text(),
+                             slash == string::npos ? string()
+                                                   : manifest_path.substr(0, slash));
+    } catch (const exception& e) {
+        cerr << "Error: " << manifest_path << ": " << e.what() << endl;
+        return 1;
     }
-    instr.op = it->second;
-
-    string reg1, reg2, reg3;
-
-    switch (instr.op) {
-        case Op::ADD: case Op::SUB: case Op::MUL: case Op::AND: case Op::OR:
-            iss >> reg1;
-            if (iss.peek() == ',') iss.ignore();
-            iss >> reg2;
-            if (iss.peek() == ',') iss.ignore();
-            iss >> reg3;
-            instr.rd = stoi(reg1.substr(reg1.find('$') + 1));
-            instr.rs = stoi(reg2.substr(reg2.find('$') + 1));
-            instr.rt = stoi(reg3.substr(reg3.find('$') + 1));
-            break;
-
-        case Op::SLL: case Op::SRL: {
-            int shamt_val;
-            iss >> reg1;
-            if (iss.peek() == ',') iss.ignore();
-            iss >> reg2;
-            if (iss.peek() == ',') iss.ignore();
-            iss >> shamt_val;
-            instr.shamt = static_cast<uint8_t>(shamt_val);
-            instr.rd = stoi(reg1.substr(reg1.find('$') + 1));
-            instr.rt = stoi(reg2.substr(reg2.find('$') + 1));
-            break;
-        }
 
-        case Op::ADDI:
-            iss >> reg1;
-            if (iss.peek() == ',') iss.ignore();
-            iss >> reg2;
-            if (iss.peek() == ',') iss.ignore();
-            iss >> instr.imm;
-            instr.rt = stoi(reg1.substr(reg1.find('$') + 1));
-            instr.rs = stoi(reg2.substr(reg2.find('$') + 1));
-            break;
-
-        case Op::LW: case Op::SW: {
-            string temp;
-            iss >> reg1;
-            if (iss.peek() == ',') iss.ignore();
-            iss >> temp;
-            instr.rt = stoi(reg1.substr(reg1.find('$') + 1));
-            size_t open = temp.find('(');
-            string offset = temp.substr(0, open);
-            string rs_str = temp.substr(open + 1, temp.find(')') - open - 1);
-            instr.imm = stoi(offset);
-            instr.rs = stoi(rs_str.substr(rs_str.find('$') + 1));
-            break;
-        }
+    auto t0 = chrono::steady_clock::now();
+    vector<BatchResult> results = runBatch(jobs, opts);
+    double wall = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    unsigned threads = WorkStealingPool(opts.threads).threads();
 
-        case Op::BEQ: {
-            iss >> reg1;
-            if (iss.peek() == ',') iss.ignore();
-            iss >> reg2;
-            if (iss.peek() == ',') iss.ignore();
-            string label;
-            iss >> label;
-            instr.rs = stoi(reg1.substr(reg1.find('$') + 1));
-            instr.rt = stoi(reg2.substr(reg2.find('$') + 1));
-            instr.raw_label = label;
-            break;
+    if (report_path) {
+        ofstream out(report_path);
+        if (!out) {
+            cerr << "Error: Cannot open report file " << report_path << endl;
+            return 1;
         }
+        writeBatchReport(out, jobs, results, threads, wall);
+    } else {
+        writeBatchReport(cout, jobs, results, threads, wall);
+    }
 
-        case Op::J:
-            iss >> instr.addr;
-            break;
-
-        case Op::HALT: case Op::NOP:
-            break;
+    size_t failed = count_if(results.begin(), results.end(), [](const BatchResult& r) {
+        return r.status != BatchResult::Status::Ok;
+    });
+    if (failed)
+        cerr << failed << " of " << jobs.size() << " batch jobs did not halt cleanly"
+             << endl;
+    return failed ? 2 : 0;
+}
 
-        default:
-            break;
+// Reads a whole option value as an unsigned number that fits T (`base` 0
+// also takes 0x hex). Reports "bad value for <opt>" and returns false
+// otherwise.
+template <typename T>
+static bool optionValue(const string& opt, const char* s, T& out, int base = 0) {
+    errno = 0;
+    char* end = nullptr;
+    unsigned long long v = strtoull(s, &end, base);
+    if (!isdigit(static_cast<unsigned char>(s[0])) || *end != '\0' ||
+        errno == ERANGE || v > numeric_limits<T>::max()) {
+        cerr << "Error: bad value for " << opt << ": '" << s << "'" << endl;
+        return false;
     }
-    return instr;
+    out = static_cast<T>(v);
+    return true;
 }
 
 int main(int argc, char* argv[]) {
-    vector<Instruction> program;
-    ifstream file;
-    istream* input = &cin;
-
-    if (argc > 1) {
-        file.open(argv[1]);
-        if (!file.is_open()) {
-            cerr << "Error: Cannot open file " << argv[1] << endl;
+    AssembledProgram program;
+
+    const char* path = nullptr;
+    bool     fast_forward = false;
+    uint64_t ff_count     = UINT64_MAX;
+    uint32_t ff_pc        = MIPSPipeline::kNoStopPC;
+    FFEngine ff_engine    = FFEngine::Interpreter;
+    bool     event_skip   = false;
+    bool     stage_threads = false;
+    const char* trace_path = nullptr;
+    bool      binary   = false;
+    ByteOrder bin_order = ByteOrder::Big;
+    uint32_t  bin_base  = 0;
+    bool      use_cache = false;
+    const char* batch_path  = nullptr;
+    const char* report_path = nullptr;
+    BatchOptions batch;
+    vector<const char*> load_snapshots;
+    const char* save_snapshot = nullptr;
+    CacheHierarchyConfig cache_cfg;
+    bool caches = false;
+    PredictorConfig bp_cfg;
+    bool predictor = false;
+    const char* counters_path = nullptr;
+    bool   profile     = false;
+    size_t profile_top = SIZE_MAX;
+    optional<SamplingConfig> sampling;
+    bool changed_only = false;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if ((arg == "--ff" || arg == "--ff-pc") && i + 1 < argc) {
+            fast_forward = true;
+            if (arg == "--ff" ? !optionValue(arg, argv[++i], ff_count)
+                              : !optionValue(arg, argv[++i], ff_pc))
+                return 1;
+        } else if (arg == "--ff-engine" && i + 1 < argc) {
+            string e = argv[++i];
+            if (e == "threaded")        ff_engine = FFEngine::Threaded;
+            else if (e == "superblock") ff_engine = FFEngine::Superblock;
+            else if (e != "interp")     { usage(argv[0]); return 1; }
+        } else if (arg == "--event-skip") {
+            event_skip = true;
+        } else if (arg == "--stage-threads") {
+            stage_threads = true;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (arg == "--bin" && i + 1 < argc) {
+            string o = argv[++i];
+            if (o == "big")         bin_order = ByteOrder::Big;
+            else if (o == "little") bin_order = ByteOrder::Little;
+            else                    { usage(argv[0]); return 1; }
+            binary = true;
+        } else if (arg == "--bin-base" && i + 1 < argc) {
+            if (!optionValue(arg, argv[++i], bin_base)) return 1;
+        } else if (arg == "--cache") {
+            use_cache = true;
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batch_path = argv[++i];
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            if (!optionValue(arg, argv[++i], batch.threads, 10)) return 1;
+        } else if (arg == "--max-cycles" && i + 1 < argc) {
+            if (!optionValue(arg, argv[++i], batch.max_cycles)) return 1;
+        } else if (arg == "--report" && i + 1 < argc) {
+            report_path = argv[++i];
+        } else if (arg == "--load-snapshot" && i + 1 < argc) {
+            load_snapshots.push_back(argv[++i]);
+        } else if (arg == "--save-snapshot" && i + 1 < argc) {
+            save_snapshot = argv[++i];
+        } else if ((arg == "--l1i" || arg == "--l1d" || arg == "--l2") &&
+                   i + 1 < argc) {
+            CacheConfig base;
+            if (arg == "--l2") {
+                base.size_bytes = 256 * 1024;
+                base.latency    = 10;
+            }
+            try {
+                CacheConfig c = parseCacheConfig(argv[++i], base);
+                (arg == "--l1i" ? cache_cfg.l1i
+                 : arg == "--l1d" ? cache_cfg.l1d : cache_cfg.l2) = c;
+            } catch (const exception& e) {
+                cerr << "Error: " << e.what() << endl;
+                return 1;
+            }
+            caches = true;
+        } else if (arg == "--bp" && i + 1 < argc) {
+            try {
+                bp_cfg = parsePredictorConfig(argv[++i]);
+            } catch (const exception& e) {
+                cerr << "Error: " << e.what() << endl;
+                return 1;
+            }
+            predictor = true;
+        } else if (arg == "--sample" && i + 1 < argc) {
+            try {
+                sampling = parseSamplingConfig(argv[++i]);
+            } catch (const exception& e) {
+                cerr << "Error: " << e.what() << endl;
+                return 1;
+            }
+        } else if (arg == "--changed-only") {
+            changed_only = true;
+        } else if (arg == "--counters" && i + 1 < argc) {
+            counters_path = argv[++i];
+        } else if (arg == "--profile") {
+            profile = true;
+        } else if (arg == "--profile-top" && i + 1 < argc) {
+            if (!optionValue(arg, argv[++i], profile_top, 10)) return 1;
+            profile     = true;
+        } else if (arg == "--mem-latency" && i + 1 < argc) {
+            if (!optionValue(arg, argv[++i], cache_cfg.memory_latency)) return 1;
+            caches = true;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            usage(argv[0]);
             return 1;
+        } else {
+            path = argv[i];
         }
-        input = &file;
     }
 
-    string line;
-    while (getline(*input, line)) {
-        Instruction instr = parseInstruction(line);
-        if (instr.op != Op::NOP || !trim(line).empty()) {
-            program.push_back(instr);
+    if (batch_path) {
+        batch.event_skip = event_skip;
+        batch.use_cache  = use_cache;
+        return runBatchMode(batch_path, report_path, batch);
+    }
+
+    // What the pipeline runs: program's own vectors, or arrays mapped from
+    // the program cache.
+    ProgramCache cache;
+    bool cached = false;
+    ProgramView text_view;
+    const int32_t* data = nullptr;
+    size_t data_words = 0;
+    unique_ptr<MappedFile> source;   // kept for the --profile listing
+
+    try {
+        source = path ? make_unique<MappedFile>(path) : make_unique<MappedFile>(cin);
+        string_view text = source->text();
+        bool is_elf = text.substr(0, 4) == "\x7f" "ELF";
+        bool is_bin = path && string_view(path).size() > 4 &&
+                      string_view(path).substr(string_view(path).size() - 4) == ".bin";
+        if (binary || is_elf || is_bin) {
+            BinaryProgram bin = loadBinary(text, bin_order, bin_base);
+            if (bin.unsupported)
+                cerr << "Warning: " << bin.unsupported
+                     << " unsupported instruction words loaded as NOP" << endl;
+            if (bin.filled_delay_slots)
+                cerr << "Warning: " << bin.filled_delay_slots
+                     << " branch delay slots hold an instruction; delay slots are"
+                        " not modelled, so results may differ from real MIPS"
+                     << endl;
+            program.text = move(bin.text);
+        } else if (use_cache && path &&
+                   cache.open(programCachePath(path), text)) {
+            cached = true;
+        } else {
+            program = assemble(text);
+            if (use_cache && path) {
+                try {
+                    ProgramCache::write(programCachePath(path), text, program);
+                } catch (const exception& e) {
+                    cerr << "Warning: " << e.what() << endl;
+                }
+            }
+        }
+        if (cached) {
+            text_view  = cache.text();
+            data       = cache.data();
+            data_words = cache.dataWords();
+        } else {
+            text_view  = program.text;
+            data       = program.data.data();
+            data_words = program.data.size();
         }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
     }
-    if (file.is_open()) file.close();
 
-    if (program.empty()) {
+    if (text_view.empty()) {
         cout << "No instructions loaded.\n";
         return 0;
     }
 
-    MIPSPipeline pipeline(program, 1 << 16, false);
-    pipeline.run();
-
+    MIPSPipeline pipeline(text_view, 1 << 16, false);
+    if (data_words > pipeline.mem_.words()) {
+        cerr << "Error: .data does not fit in " << pipeline.mem_.words()
+             << " words of memory" << endl;
+        return 1;
+    }
+    pipeline.mem_.write_words(0, data, data_words);
+    pipeline.setFastForwardEngine(ff_engine);
+    pipeline.setEventSkip(event_skip);
+    pipeline.setStageThreads(stage_threads);
+    if (caches) pipeline.setCaches(cache_cfg);
+    if (predictor) pipeline.setBranchPredictor(bp_cfg);
+    pipeline.setCounters(counters_path != nullptr);
+    pipeline.setProfile(profile);
+    unique_ptr<MIPSPipeline> snapshot_base;   // parent for --save-snapshot
     OutputManager output;
+    output.setChangedOnly(changed_only);
+    optional<SampleEstimate> estimate;
+    try {
+        for (const char* snap : load_snapshots)
+            pipeline.loadSnapshot(snap);
+        // what the program starts from, .data and snapshots included
+        if (changed_only)
+            output.setBaseline(pipeline.regs_, pipeline.mem_);
+        if (!load_snapshots.empty())
+            snapshot_base = make_unique<MIPSPipeline>(pipeline.fork());
+        if (trace_path)
+            pipeline.setTraceFile(trace_path);
+        if (fast_forward)
+            pipeline.fastForward(ff_count, ff_pc);
+        if (save_snapshot)
+            pipeline.saveSnapshot(save_snapshot, snapshot_base.get());
+        if (sampling) estimate = runSampled(pipeline, *sampling);
+        else          pipeline.run();
+        if (trace_path)
+            pipeline.closeTraceFile();
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+
     output.printFinalState(pipeline.regs_, pipeline.mem_);
 
-    cout << "\nSimulation completed in " << pipeline.cycles() << " cycles.\n";
+    if (estimate) {
+        cout << "\nSampled simulation, " << pipeline.cycles()
+             << " cycles simulated in detail.\n";
+        estimate->report(cout);
+    } else {
+        cout << "\nSimulation completed in " << pipeline.cycles() << " cycles.\n";
+    }
+    if (fast_forward)
+        cout << "Fast-forwarded " << pipeline.fastForwarded()
+             << " instructions before detailed simulation.\n";
+    if (pipeline.fastForwardCycleEstimate())
+        cout << "Fast-forwarded part replays to "
+             << pipeline.fastForwardCycleEstimate() << " pipeline cycles.\n";
+    if (caches) {
+        cout << "\n";
+        pipeline.caches().report(cout);
+    }
+    if (predictor) {
+        cout << "\n";
+        pipeline.branchPredictor().report(cout);
+    }
+    if (profile) {
+        cout << "\n";
+        pipeline.counters().profile.report(cout, text_view, source->text(),
+                                           program.lines, profile_top);
+    }
+    if (counters_path) {
+        string_view p = counters_path;
+        bool csv = p.size() > 4 && p.substr(p.size() - 4) == ".csv";
+        ofstream file;
+        if (p != "-") {
+            file.open(counters_path);
+            if (!file) {
+                cerr << "Error: Cannot open counters file " << p << endl;
+                return 1;
+            }
+        }
+        ostream& out = p == "-" ? cout : file;
+        if (p == "-") out << "\n";
+        csv ? pipeline.counters().writeCsv(out) : pipeline.counters().writeJson(out);
+    }
 
     return 0;
 }
@@ -0,0 +1,241 @@
+// mips_assembler.cpp
+// Two-pass assembler on top of the line lexer: sections, labels, .word
+// data and label resolution into plain numeric Instructions.
+
+#include "mips_assembler.h"
+#include "mips_lexer.h"
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+// ---------------- symbol table ----------------
+static uint32_t hash_name(string_view s) {
+    uint32_t h = 2166136261u;           // FNV-1a
+    for (char c : s) {
+        h ^= static_cast<uint8_t>(c);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+size_t SymbolTable::slot(string_view name) const {
+    size_t mask = index_.size() - 1;
+    size_t i = hash_name(name) & mask;
+    while (index_[i] != 0 && this->name(syms_[index_[i] - 1]) != name)
+        i = (i + 1) & mask;
+    return i;
+}
+
+void SymbolTable::rehash(size_t buckets) {
+    index_.assign(buckets, 0);
+    for (size_t k = 0; k < syms_.size(); ++k)
+        index_[slot(name(syms_[k]))] = static_cast<uint32_t>(k + 1);
+}
+
+bool SymbolTable::define(string_view name, uint32_t value, Section section) {
+    // keep the index at most half full
+    if ((syms_.size() + 1) * 2 > index_.size())
+        rehash(index_.empty() ? 64 : index_.size() * 2);
+
+    size_t i = slot(name);
+    if (index_[i] != 0) return false;
+
+    Symbol s;
+    s.name_off = static_cast<uint32_t>(names_.size());
+    s.name_len = static_cast<uint32_t>(name.size());
+    s.value    = value;
+    s.section  = section;
+    names_.append(name);
+    syms_.push_back(s);
+    index_[i] = static_cast<uint32_t>(syms_.size());
+    return true;
+}
+
+const SymbolTable::Symbol* SymbolTable::find(string_view name) const {
+    if (index_.empty()) return nullptr;
+    size_t i = slot(name);
+    return index_[i] ? &syms_[index_[i] - 1] : nullptr;
+}
+
+string_view SymbolTable::name(const Symbol& s) const {
+    return string_view(names_.data() + s.name_off, s.name_len);
+}
+
+// ---------------- assembler ----------------
+namespace {
+
+// A label operand waiting for pass 2.
+struct Fixup {
+    enum Kind : uint8_t { Branch, Jump, Imm, Word };
+    Kind kind;
+    uint32_t index;      // text or data slot to patch
+    uint32_t line;       // for error messages
+    string_view label;   // view into the source
+};
+
+[[noreturn]] void fail(uint32_t line, const string& what) {
+    throw runtime_error("line " + to_string(line) + ": " + what);
+}
+
+bool blank_or_comment(string_view s) {
+    size_t i = s.find_first_not_of(" \t\r");
+    return i == string_view::npos || s[i] == '#';
+}
+
+string_view trim_view(string_view s) {
+    size_t b = s.find_first_not_of(" \t\r");
+    if (b == string_view::npos) return {};
+    size_t e = s.find_last_not_of(" \t\r");
+    return s.substr(b, e - b + 1);
+}
+
+// Splits a directive's operand list on commas, dropping any comment.
+template <typename F>
+void for_each_operand(string_view args, F&& f) {
+    size_t hash = args.find('#');
+    if (hash != string_view::npos) args = args.substr(0, hash);
+    while (!trim_view(args).empty()) {
+        size_t comma = args.find(',');
+        f(trim_view(args.substr(0, comma)));
+        if (comma == string_view::npos) break;
+        args.remove_prefix(comma + 1);
+    }
+}
+
+// Numbers start with a digit or a sign; anything else is a label.
+bool is_number(string_view s) {
+    return !s.empty() && ((s[0] >= '0' && s[0] <= '9') || s[0] == '-' || s[0] == '+');
+}
+
+} // namespace
+
+AssembledProgram assemble(string_view source) {
+    AssembledProgram out;
+    vector<Fixup> fixups;
+    bool in_data = false;
+
+    // ---- pass 1: read everything, define labels, record references ----
+    const char* p   = source.data();
+    const char* end = p + source.size();
+    uint32_t line_no = 0;
+    while (p < end) {
+        const char* nl  = static_cast<const char*>(memchr(p, '\n', end - p));
+        const char* eol = nl ? nl : end;
+        string_view line(p, static_cast<size_t>(eol - p));
+        p = nl ? nl + 1 : end;
+        ++line_no;
+
+        bool had_label = false;
+        for (string_view name; !(name = takeLabelDef(line)).empty();) {
+            had_label = true;
+            uint32_t addr = in_data
+                ? static_cast<uint32_t>(out.data.size() * 4)
+                : static_cast<uint32_t>(out.text.size() * 4);
+            auto sec = in_data ? SymbolTable::Section::Data
+                               : SymbolTable::Section::Text;
+            if (!out.symbols.define(name, addr, sec))
+                fail(line_no, "duplicate label '" + string(name) + "'");
+        }
+
+        string_view body = trim_view(line);
+        if (!body.empty() && body[0] == '.') {
+            size_t sp = body.find_first_of(" \t");
+            string_view dir  = body.substr(0, sp);
+            string_view args = sp == string_view::npos ? string_view()
+                                                       : body.substr(sp);
+            if (dir == ".text") {
+                in_data = false;
+            } else if (dir == ".data") {
+                in_data = true;
+            } else if (dir == ".word" && in_data) {
+                for_each_operand(args, [&](string_view v) {
+                    int64_t n;
+                    if (is_number(v)) {
+                        // signed or unsigned 32-bit
+                        if (!parseNumber(v, n) || n < INT32_MIN)
+                            fail(line_no, "bad number '" + string(v) + "'");
+                        out.data.push_back(static_cast<int32_t>(n));
+                    } else {
+                        fixups.push_back({Fixup::Word,
+                                          static_cast<uint32_t>(out.data.size()),
+                                          line_no, v});
+                        out.data.push_back(0);
+                    }
+                });
+            } else if (dir == ".space" && in_data) {
+                int64_t n = 0;
+                string_view a = trim_view(args.substr(0, args.find('#')));
+                if (is_number(a) && !parseNumber(a, n))
+                    fail(line_no, "bad number '" + string(a) + "'");
+                if (!parseNumber(a, n) || n < 0 || n % 4 != 0)
+                    fail(line_no, ".space needs a byte count that is a multiple of 4");
+                out.data.resize(out.data.size() + static_cast<size_t>(n / 4), 0);
+            } else {
+                fail(line_no, "unexpected directive '" + string(dir) + "'" +
+                              (in_data ? "" : " in .text"));
+            }
+            continue;
+        }
+
+        if (in_data) {
+            if (!blank_or_comment(body))
+                fail(line_no, "instruction in .data");
+            continue;
+        }
+
+        // a label on its own line does not take an instruction slot
+        if (had_label && blank_or_comment(body)) continue;
+
+        Instruction ins;
+        string_view label;
+        try {
+            if (!parseLine(line, ins, &label)) continue;   // blank line
+        } catch (const runtime_error& e) {
+            fail(line_no, e.what());
+        }
+        if (!label.empty()) {
+            Format f = opInfo(ins.op).format;
+            Fixup::Kind k = (f == Format::RsRtLabel || f == Format::RsLabel) ? Fixup::Branch
+                          : (f == Format::Target)                            ? Fixup::Jump
+                                                                             : Fixup::Imm;
+            fixups.push_back({k, static_cast<uint32_t>(out.text.size()),
+                              line_no, label});
+        }
+        out.text.push_back(ins);
+        out.lines.push_back(line_no);
+    }
+
+    // ---- pass 2: resolve every recorded reference ----
+    for (const Fixup& f : fixups) {
+        const SymbolTable::Symbol* s = out.symbols.find(f.label);
+        if (!s) fail(f.line, "undefined label '" + string(f.label) + "'");
+
+        bool is_text = s->section == SymbolTable::Section::Text;
+        switch (f.kind) {
+            case Fixup::Branch: {
+                if (!is_text) fail(f.line, "branch to data label '" + string(f.label) + "'");
+                int64_t off = int64_t(s->value / 4) - (int64_t(f.index) + 1);
+                if (off < -32768 || off > 32767)
+                    fail(f.line, "branch to '" + string(f.label) + "' out of range");
+                out.text[f.index].imm = static_cast<int32_t>(off);
+                break;
+            }
+            case Fixup::Jump:
+                if (!is_text) fail(f.line, "jump to data label '" + string(f.label) + "'");
+                out.text[f.index].addr = s->value / 4;
+                break;
+            case Fixup::Imm:
+                // immediates are sign-extended from 16 bits
+                if (s->value > 32767)
+                    fail(f.line, "address of '" + string(f.label) +
+                                 "' does not fit a 16-bit immediate");
+                out.text[f.index].imm = static_cast<int32_t>(s->value);
+                break;
+            case Fixup::Word:
+                out.data[f.index] = static_cast<int32_t>(s->value);
+                break;
+        }
+    }
+    return out;
+}
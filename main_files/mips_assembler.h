@@ -0,0 +1,69 @@
+// mips_assembler.h
+#ifndef MIPS_ASSEMBLER_H
+#define MIPS_ASSEMBLER_H
+
+#include "mips_ir.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Labels of one assembled program. Names are stored back to back in a
+// single string and found through an open-addressing hash index, so
+// defining and resolving n labels is O(n) with a handful of allocations.
+class SymbolTable {
+public:
+    enum class Section : uint8_t { Text, Data };
+
+    struct Symbol {
+        uint32_t name_off{0}, name_len{0};   // into the name arena
+        uint32_t value{0};                   // byte address in its section
+        Section section{Section::Text};
+    };
+
+    // Returns false if `name` is already defined.
+    bool define(std::string_view name, uint32_t value, Section section);
+    const Symbol* find(std::string_view name) const;
+    std::string_view name(const Symbol& s) const;
+
+    const std::vector<Symbol>& symbols() const { return syms_; }
+    size_t size() const { return syms_.size(); }
+
+private:
+    size_t slot(std::string_view name) const;   // index_ slot for `name`
+    void rehash(size_t buckets);
+
+    std::string names_;
+    std::vector<Symbol> syms_;
+    std::vector<uint32_t> index_;   // syms_ position + 1; 0 marks a free slot
+};
+
+struct AssembledProgram {
+    std::vector<Instruction> text;   // every label operand resolved
+    std::vector<int32_t> data;       // .data image, loaded at byte address 0
+    std::vector<uint32_t> lines;     // source line of each text entry (1-based)
+    SymbolTable symbols;
+};
+
+// Assembles a whole source file.
+//
+//   .text / .data        switch section (.text is the default)
+//   name:                define a label at the current section address
+//   .word v, v, ...      data words; a value may be a label's address
+//   .space n             n bytes (a multiple of 4) of zero words
+//
+// Numbers are written as instruction operands are (parseNumber(): decimal
+// or 0x hex, optionally signed).
+//
+// Instructions are read by parseLine() (mips_lexer.h). Labels are collected
+// while the source is read and every reference is patched in a second pass
+// over the recorded fixups: conditional branches get the word offset from
+// pc + 4, J/JAL the word index, and immediates and load/store offsets the
+// byte address.
+// A comment-only line in .text still occupies a NOP slot, as it always has.
+// Throws std::runtime_error ("line N: ...") on unknown instructions,
+// malformed operands, undefined or duplicate labels, bad numbers and
+// directives, and out-of-range immediates and offsets.
+AssembledProgram assemble(std::string_view source);
+
+#endif // MIPS_ASSEMBLER_H
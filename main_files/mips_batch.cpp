@@ -0,0 +1,317 @@
+// mips_batch.cpp
+// Batch driver: manifest parsing, a work-stealing thread pool, shared
+// read-only programs and the aggregated JSON report.
+
+#include "mips_batch.h"
+#include "mips_assembler.h"
+#include "mips_lexer.h"
+#include "mips_parser.h"
+#include "mips_program_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+
+// ---------------- thread pool ----------------
+WorkStealingPool::WorkStealingPool(unsigned threads)
+    : threads_(threads ? threads : max(1u, thread::hardware_concurrency())) {}
+
+namespace {
+
+// Own cache line each, so workers popping their own queue do not contend.
+struct alignas(64) WorkQueue {
+    mutex m;
+    deque<size_t> q;
+
+    bool pop_front(size_t& i) {
+        lock_guard<mutex> lock(m);
+        if (q.empty()) return false;
+        i = q.front();
+        q.pop_front();
+        return true;
+    }
+    bool steal_back(size_t& i) {
+        lock_guard<mutex> lock(m);
+        if (q.empty()) return false;
+        i = q.back();
+        q.pop_back();
+        return true;
+    }
+};
+
+} // namespace
+
+void WorkStealingPool::run(size_t count, const function<void(size_t)>& task) {
+    unsigned n = static_cast<unsigned>(min<size_t>(threads_, max<size_t>(count, 1)));
+    vector<WorkQueue> queues(n);
+    for (unsigned w = 0; w < n; ++w)
+        for (size_t i = count * w / n; i < count * (w + 1) / n; ++i)
+            queues[w].q.push_back(i);
+
+    // Tasks never add work, so a worker whose own queue is empty and that
+    // finds nothing to steal in one full pass is done.
+    auto worker = [&](unsigned self) {
+        size_t i;
+        for (;;) {
+            if (queues[self].pop_front(i)) {
+                task(i);
+                continue;
+            }
+            bool stole = false;
+            for (unsigned k = 1; k < n && !stole; ++k)
+                stole = queues[(self + k) % n].steal_back(i);
+            if (!stole) return;
+            task(i);
+        }
+    };
+
+    vector<thread> pool;
+    for (unsigned w = 1; w < n; ++w) pool.emplace_back(worker, w);
+    worker(0);
+    for (thread& t : pool) t.join();
+}
+
+// ---------------- manifest ----------------
+namespace {
+
+[[noreturn]] void fail(uint32_t line, const string& what) {
+    throw runtime_error("line " + to_string(line) + ": " + what);
+}
+
+bool parse_number(string_view s, int64_t& v) {
+    bool neg = !s.empty() && s[0] == '-';
+    if (neg) s.remove_prefix(1);
+    int base = 10;
+    if (s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        base = 16;
+        s.remove_prefix(2);
+    }
+    if (s.empty()) return false;
+    int64_t x = 0;
+    for (char c : s) {
+        int d = (c >= '0' && c <= '9') ? c - '0'
+              : (base == 16 && c >= 'a' && c <= 'f') ? c - 'a' + 10
+              : (base == 16 && c >= 'A' && c <= 'F') ? c - 'A' + 10
+              : -1;
+        if (d < 0 || x > (int64_t(1) << 33)) return false;
+        x = x * base + d;
+    }
+    v = neg ? -x : x;
+    return true;
+}
+
+} // namespace
+
+vector<BatchJob> parseManifest(string_view text, const string& base_dir) {
+    vector<BatchJob> jobs;
+    uint32_t line_no = 0;
+    while (!text.empty()) {
+        size_t nl = text.find('\n');
+        string_view line = text.substr(0, nl);
+        text.remove_prefix(nl == string_view::npos ? text.size() : nl + 1);
+        ++line_no;
+
+        line = line.substr(0, line.find('#'));
+        BatchJob job;
+        job.line = line_no;
+        for (;;) {
+            size_t b = line.find_first_not_of(" \t\r");
+            if (b == string_view::npos) break;
+            line.remove_prefix(b);
+            size_t e = line.find_first_of(" \t\r");
+            string_view tok = line.substr(0, e);
+            line.remove_prefix(tok.size());
+
+            if (job.program.empty()) {
+                job.program = (tok[0] == '/' || base_dir.empty())
+                                  ? string(tok)
+                                  : base_dir + "/" + string(tok);
+                continue;
+            }
+            size_t eq = tok.find('=');
+            int64_t value;
+            if (eq == string_view::npos || !parse_number(tok.substr(eq + 1), value))
+                fail(line_no, "expected $N=V or [ADDR]=V, got '" + string(tok) + "'");
+            string_view lhs = tok.substr(0, eq);
+            int64_t where;
+            if (lhs.size() > 1 && lhs[0] == '$' &&
+                parse_number(lhs.substr(1), where) && where >= 0 && where < 32) {
+                job.regs.emplace_back(static_cast<uint8_t>(where),
+                                      static_cast<int32_t>(value));
+            } else if (lhs.size() > 2 && lhs.front() == '[' && lhs.back() == ']' &&
+                       parse_number(lhs.substr(1, lhs.size() - 2), where) &&
+                       where >= 0 && where % 4 == 0 && where <= UINT32_MAX) {
+                job.mem.emplace_back(static_cast<uint32_t>(where),
+                                     static_cast<int32_t>(value));
+            } else {
+                fail(line_no, "bad register or address '" + string(lhs) + "'");
+            }
+        }
+        if (!job.program.empty()) jobs.push_back(move(job));
+    }
+    return jobs;
+}
+
+// ---------------- running ----------------
+namespace {
+
+// Memory per job, as main gives its single run.
+constexpr size_t kMemoryWords = size_t(1) << 16;
+
+// A program as every job running it sees it: loaded and decoded once,
+// then only read. Jobs start from fork()s of `proto`, which share its
+// instructions and micro-op tables, and the pages holding .data until a
+// job writes to them.
+struct SharedProgram {
+    AssembledProgram assembled;
+    ProgramCache cache;
+    unique_ptr<const MIPSPipeline> proto;
+    string error;
+};
+
+void make_proto(SharedProgram& p, ProgramView text, const int32_t* data,
+                size_t data_words) {
+    if (text.empty()) return;
+    auto proto = make_unique<MIPSPipeline>(text, kMemoryWords);
+    proto->mem_.write_words(0, data, data_words);
+    p.proto = move(proto);
+}
+
+void load(SharedProgram& p, const string& path, bool use_cache) {
+    MappedFile source(path);
+    string_view text = source.text();
+    bool binary = text.substr(0, 4) == "\x7f" "ELF" ||
+                  (path.size() > 4 && path.compare(path.size() - 4, 4, ".bin") == 0);
+    if (binary) {
+        p.assembled.text = loadBinary(text).text;
+    } else if (use_cache && p.cache.open(programCachePath(path), text)) {
+        make_proto(p, p.cache.text(), p.cache.data(), p.cache.dataWords());
+        return;
+    } else {
+        p.assembled = assemble(text);
+        if (use_cache) {
+            try {
+                ProgramCache::write(programCachePath(path), text, p.assembled);
+            } catch (const exception&) {
+                // read-only tree: run without the cache
+            }
+        }
+    }
+    make_proto(p, p.assembled.text, p.assembled.data.data(), p.assembled.data.size());
+}
+
+void run_job(const BatchJob& job, const SharedProgram& p,
+             const BatchOptions& opts, BatchResult& r) {
+    if (!p.error.empty() || !p.proto) {
+        r.error = p.error.empty() ? "No instructions loaded" : p.error;
+        return;
+    }
+    auto t0 = chrono::steady_clock::now();
+    try {
+        MIPSPipeline pipe = p.proto->fork();
+        for (auto [addr, value] : job.mem) pipe.mem_.store_word(addr, value);
+        for (auto [reg, value] : job.regs)
+            if (reg != 0) pipe.regs_[reg] = value;
+
+        pipe.setEventSkip(opts.event_skip);
+        pipe.run(opts.max_cycles);
+
+        r.status   = pipe.isHalted() ? BatchResult::Status::Ok
+                                     : BatchResult::Status::CycleLimit;
+        r.regs     = pipe.regs_;
+        r.cycles   = pipe.cycles();
+        r.mem_hash = pipe.mem_.content_hash();
+    } catch (const exception& e) {
+        r.status = BatchResult::Status::Error;
+        r.error  = e.what();
+    }
+    r.seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+} // namespace
+
+vector<BatchResult> runBatch(const vector<BatchJob>& jobs,
+                             const BatchOptions& opts) {
+    WorkStealingPool pool(opts.threads);
+
+    // distinct programs, each loaded by one worker
+    unordered_map<string, size_t> index;
+    vector<string> paths;
+    vector<size_t> program_of(jobs.size());
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        auto [it, fresh] = index.emplace(jobs[j].program, paths.size());
+        if (fresh) paths.push_back(jobs[j].program);
+        program_of[j] = it->second;
+    }
+    vector<unique_ptr<SharedProgram>> programs(paths.size());
+    pool.run(paths.size(), [&](size_t i) {
+        programs[i] = make_unique<SharedProgram>();
+        try {
+            load(*programs[i], paths[i], opts.use_cache);
+        } catch (const exception& e) {
+            programs[i]->error = e.what();
+        }
+    });
+
+    vector<BatchResult> results(jobs.size());
+    pool.run(jobs.size(), [&](size_t j) {
+        run_job(jobs[j], *programs[program_of[j]], opts, results[j]);
+    });
+    return results;
+}
+
+// ---------------- report ----------------
+static void json_string(ostream& os, string_view s) {
+    os << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') os << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+            os << "\\u" << hex << setw(4) << setfill('0') << int(c)
+               << dec << setfill(' ');
+        else os << c;
+    }
+    os << '"';
+}
+
+void writeBatchReport(ostream& os, const vector<BatchJob>& jobs,
+                      const vector<BatchResult>& results,
+                      unsigned threads, double wall_seconds) {
+    static const char* const kStatus[] = {"ok", "cycle_limit", "error"};
+    size_t failed = 0;
+    uint64_t cycles = 0;
+    for (const BatchResult& r : results) {
+        failed += r.status != BatchResult::Status::Ok;
+        cycles += r.cycles;
+    }
+
+    os << "{\n  \"jobs\": " << jobs.size() << ", \"failed\": " << failed
+       << ", \"threads\": " << threads << ", \"total_cycles\": " << cycles
+       << ", \"wall_seconds\": " << wall_seconds << ",\n  \"results\": [";
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        const BatchResult& r = results[j];
+        os << (j ? ",\n" : "\n") << "    {\"job\": " << j
+           << ", \"line\": " << jobs[j].line << ", \"program\": ";
+        json_string(os, jobs[j].program);
+        os << ", \"status\": \"" << kStatus[static_cast<int>(r.status)] << '"';
+        if (r.status == BatchResult::Status::Error) {
+            os << ", \"error\": ";
+            json_string(os, r.error);
+        } else {
+            os << ", \"cycles\": " << r.cycles << ", \"mem_hash\": \"0x" << hex
+               << setw(16) << setfill('0') << r.mem_hash << dec << setfill(' ')
+               << "\", \"regs\": [";
+            for (int i = 0; i < 32; ++i) os << (i ? ", " : "") << r.regs[i];
+            os << ']';
+        }
+        os << ", \"seconds\": " << r.seconds << '}';
+    }
+    os << "\n  ]\n}\n";
+}
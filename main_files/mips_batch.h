@@ -0,0 +1,80 @@
+// mips_batch.h
+#ifndef MIPS_BATCH_H
+#define MIPS_BATCH_H
+
+#include "mips_pipeline.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Runs task(i) for every i in [0, count) on `threads` worker threads.
+// Each worker starts with a contiguous slice of the indices in its own
+// queue and takes from its front; a worker that runs dry steals from the
+// back of another worker's queue, so long jobs do not leave cores idle.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(unsigned threads);   // 0 = all hardware threads
+    unsigned threads() const { return threads_; }
+    void run(size_t count, const std::function<void(size_t)>& task);
+
+private:
+    unsigned threads_;
+};
+
+// One line of a batch manifest:
+//
+//   # program          initial state (applied after the program's .data)
+//   kernels/fib.asm
+//   kernels/fib.asm    $4=20 $5=-1
+//   kernels/sum.asm    [0x100]=7 [0x104]=8
+//
+// $N=V sets register N, [ADDR]=V stores the word V at byte address ADDR.
+// Numbers are decimal or 0x hex. Program paths are relative to the
+// manifest. Programs are loaded like main's input file: ELF and *.bin as
+// machine code, anything else as assembly.
+struct BatchJob {
+    std::string program;
+    std::vector<std::pair<uint8_t, int32_t>> regs;
+    std::vector<std::pair<uint32_t, int32_t>> mem;
+    uint32_t line{0};   // in the manifest
+};
+
+struct BatchOptions {
+    unsigned threads{0};
+    uint64_t max_cycles{UINT64_MAX};   // per job
+    bool event_skip{false};
+    bool use_cache{false};             // program cache for assembly sources
+};
+
+struct BatchResult {
+    enum class Status : uint8_t { Ok, CycleLimit, Error };
+    Status status{Status::Error};
+    std::string error;
+    RegFile regs{};
+    uint64_t cycles{0};
+    uint64_t mem_hash{0};   // WordMemory::content_hash() of the final memory
+    double seconds{0};
+};
+
+// Parses a manifest; throws std::runtime_error ("line N: ...") on bad input.
+std::vector<BatchJob> parseManifest(std::string_view text,
+                                    const std::string& base_dir);
+
+// Loads and decodes every distinct program once, then runs all jobs in
+// parallel. Jobs naming the same program are forks of one pipeline: they
+// share its instructions and micro-op tables read-only.
+// Load and simulation errors are reported per job, never thrown.
+std::vector<BatchResult> runBatch(const std::vector<BatchJob>& jobs,
+                                  const BatchOptions& opts);
+
+// Aggregated JSON report: one object per job, in manifest order.
+void writeBatchReport(std::ostream& os, const std::vector<BatchJob>& jobs,
+                      const std::vector<BatchResult>& results,
+                      unsigned threads, double wall_seconds);
+
+#endif // MIPS_BATCH_H
@@ -0,0 +1,154 @@
+// mips_branch.cpp
+// Direction predictors and BTB used by the IF stage.
+
+#include "mips_branch.h"
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+[[noreturn]] void bad_spec(string_view spec, const string& what) {
+    throw invalid_argument("predictor spec '" + string(spec) + "': " + what);
+}
+
+uint32_t parse_uint(string_view spec, string_view v) {
+    uint32_t x = 0;
+    for (char c : v) {
+        if (c < '0' || c > '9' || x > 100000000)
+            bad_spec(spec, "bad number '" + string(v) + "'");
+        x = x * 10 + (c - '0');
+    }
+    if (v.empty()) bad_spec(spec, "missing number");
+    return x;
+}
+
+} // namespace
+
+PredictorConfig parsePredictorConfig(string_view spec) {
+    PredictorConfig cfg;
+    size_t comma = spec.find(',');
+    string_view kind = spec.substr(0, comma);
+    if (kind == "nottaken")     cfg.kind = PredictorKind::NotTaken;
+    else if (kind == "btfn")    cfg.kind = PredictorKind::BTFN;
+    else if (kind == "bimodal") cfg.kind = PredictorKind::Bimodal;
+    else if (kind == "gshare")  cfg.kind = PredictorKind::GShare;
+    else bad_spec(spec, "kind must be nottaken, btfn, bimodal or gshare");
+
+    string_view rest =
+        comma == string_view::npos ? string_view() : spec.substr(comma + 1);
+    while (!rest.empty()) {
+        comma = rest.find(',');
+        string_view item = rest.substr(0, comma);
+        rest.remove_prefix(comma == string_view::npos ? rest.size() : comma + 1);
+
+        size_t eq = item.find('=');
+        if (eq == string_view::npos)
+            bad_spec(spec, "expected key=value, got '" + string(item) + "'");
+        string_view key = item.substr(0, eq), v = item.substr(eq + 1);
+        if (key == "bits")         cfg.table_bits   = parse_uint(spec, v);
+        else if (key == "history") cfg.history_bits = parse_uint(spec, v);
+        else if (key == "btb")     cfg.btb_entries  = parse_uint(spec, v);
+        else bad_spec(spec, "unknown key '" + string(key) + "'");
+    }
+    if (cfg.table_bits > 24 || cfg.history_bits > 24)
+        bad_spec(spec, "bits and history must be at most 24");
+    if (cfg.btb_entries & (cfg.btb_entries - 1))
+        bad_spec(spec, "btb must be a power of two");
+    return cfg;
+}
+
+BranchPredictor::BranchPredictor(const PredictorConfig& cfg) : cfg_(cfg) {
+    if (cfg.kind == PredictorKind::Bimodal || cfg.kind == PredictorKind::GShare)
+        counters_.assign(size_t(1) << cfg.table_bits, 1);   // weakly not taken
+    btb_pc_.assign(cfg.btb_entries, kNoBranch);
+}
+
+uint32_t BranchPredictor::index(uint32_t pc) const {
+    uint32_t i = pc >> 2;
+    if (cfg_.kind == PredictorKind::GShare) i ^= history_;
+    return i & static_cast<uint32_t>(counters_.size() - 1);
+}
+
+bool BranchPredictor::btb_lookup(uint32_t pc) const {
+    return btb_pc_.empty() ||
+           btb_pc_[(pc >> 2) & (btb_pc_.size() - 1)] == pc;
+}
+
+bool BranchPredictor::predict(uint32_t pc, bool jump, uint32_t target) {
+    bool taken = jump && cfg_.kind != PredictorKind::NotTaken;
+    if (!jump) {
+        switch (cfg_.kind) {
+            case PredictorKind::NotTaken: break;
+            case PredictorKind::BTFN:     taken = target <= pc; break;
+            case PredictorKind::Bimodal:
+            case PredictorKind::GShare:   taken = counters_[index(pc)] >= 2; break;
+        }
+    }
+    if (taken && !btb_lookup(pc)) {
+        ++stats_.btb_misses;
+        taken = false;
+    }
+    return taken;
+}
+
+bool BranchPredictor::resolve(uint32_t pc, bool jump, bool taken,
+                              bool predicted_taken) {
+    jump ? ++stats_.jumps : ++stats_.branches;
+    stats_.taken += taken;
+    bool wrong = taken != predicted_taken;
+    if (wrong) {
+        ++stats_.mispredicts;
+        stats_.flush_cycles += kFlushPenalty;
+    }
+
+    if (!jump && !counters_.empty()) {
+        uint8_t& c = counters_[index(pc)];
+        if (taken && c < 3)  ++c;
+        if (!taken && c > 0) --c;
+    }
+    if (!jump && cfg_.kind == PredictorKind::GShare && cfg_.history_bits)
+        history_ = ((history_ << 1) | taken) & ((1u << cfg_.history_bits) - 1);
+    if (taken && !btb_pc_.empty())
+        btb_pc_[(pc >> 2) & (btb_pc_.size() - 1)] = pc;
+    return wrong;
+}
+
+void BranchPredictor::reset() {
+    fill(counters_.begin(), counters_.end(), 1);
+    fill(btb_pc_.begin(), btb_pc_.end(), kNoBranch);
+    history_ = 0;
+    stats_   = {};
+}
+
+const char* BranchPredictor::name() const {
+    switch (cfg_.kind) {
+        case PredictorKind::NotTaken: return "not-taken";
+        case PredictorKind::BTFN:     return "btfn";
+        case PredictorKind::Bimodal:  return "bimodal";
+        case PredictorKind::GShare:   return "gshare";
+    }
+    return "?";
+}
+
+void BranchPredictor::report(ostream& os) const {
+    os << "Branch predictor: " << name();
+    if (!counters_.empty()) os << ", " << counters_.size() << " counters";
+    if (cfg_.kind == PredictorKind::GShare)
+        os << ", " << cfg_.history_bits << "-bit history";
+    if (!btb_pc_.empty()) os << ", " << btb_pc_.size() << "-entry BTB";
+    os << "\n  " << stats_.branches << " branches, " << stats_.jumps
+       << " jumps, " << stats_.taken << " taken, " << stats_.mispredicts
+       << " mispredicted (" << fixed << setprecision(2)
+       << 100.0 * stats_.accuracy() << "% accurate)\n";
+    os.unsetf(ios::floatfield);
+    os << setprecision(6);
+    if (!btb_pc_.empty())
+        os << "  " << stats_.btb_misses
+           << " taken predictions lost to BTB misses\n";
+    os << "  " << stats_.flush_cycles << " fetch slots flushed\n";
+}
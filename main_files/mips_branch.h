@@ -0,0 +1,100 @@
+// mips_branch.h
+#ifndef MIPS_BRANCH_H
+#define MIPS_BRANCH_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <string_view>
+#include <vector>
+
+// Branch prediction for the IF stage of MIPSPipeline.
+//
+// IF asks the predictor about every conditional branch, J and JAL it
+// fetches; a taken prediction redirects fetch to the target in the next
+// cycle. JR/JALR, whose target is a register, are never predicted. The branch
+// still resolves in MEM, and if the prediction was wrong the pipeline
+// takes the same flush it always did: the two younger instructions are
+// squashed and fetch restarts on the correct path. Predictors are trained
+// when the branch resolves (global history included), not at fetch.
+//
+// The default - never taken, no BTB - is the pipeline's original policy,
+// so cycle counts are unchanged unless another predictor is selected.
+
+enum class PredictorKind : uint8_t {
+    NotTaken,   // always fall through
+    BTFN,       // backward taken, forward not taken (loops)
+    Bimodal,    // 2-bit counters indexed by PC
+    GShare      // 2-bit counters indexed by PC xor global history
+};
+
+struct PredictorConfig {
+    PredictorKind kind{PredictorKind::NotTaken};
+    uint32_t table_bits{12};     // 2^table_bits counters (bimodal, gshare)
+    uint32_t history_bits{12};   // global history length (gshare)
+    // Direct-mapped, tagged branch target buffer; a taken prediction needs
+    // a BTB hit to know where to fetch. 0 models targets as known at fetch.
+    uint32_t btb_entries{0};
+};
+
+// Reads "kind[,key=value...]" with kind nottaken|btfn|bimodal|gshare and
+// keys bits, history, btb, e.g. "gshare,bits=14,history=10,btb=256".
+// Throws std::invalid_argument on anything else or on sizes that are not
+// powers of two.
+PredictorConfig parsePredictorConfig(std::string_view spec);
+
+struct PredictorStats {
+    uint64_t branches{0};        // conditional branches resolved
+    uint64_t jumps{0};           // J resolved
+    uint64_t taken{0};           // of both, actually taken
+    uint64_t mispredicts{0};     // direction or target wrong
+    uint64_t btb_misses{0};      // taken predictions dropped for lack of a target
+    uint64_t flush_cycles{0};    // fetch slots squashed on mispredictions
+
+    double accuracy() const {
+        uint64_t n = branches + jumps;
+        return n ? 1.0 - double(mispredicts) / double(n) : 1.0;
+    }
+};
+
+class BranchPredictor {
+public:
+    // Slots a misprediction squashes: the pipeline resolves in MEM.
+    static constexpr uint32_t kFlushPenalty = 2;
+
+    BranchPredictor() = default;   // never taken, no BTB
+    explicit BranchPredictor(const PredictorConfig& cfg);
+
+    // At fetch of a branch (or J, `jump`) at `pc` with static `target`:
+    // true to fetch the target next.
+    bool predict(uint32_t pc, bool jump, uint32_t target);
+
+    // When it resolves in MEM; trains the tables and returns true if the
+    // prediction made at fetch was wrong.
+    bool resolve(uint32_t pc, bool jump, bool taken, bool predicted_taken);
+
+    // Forgets everything learnt and clears the counters.
+    void reset();
+
+    const PredictorConfig& config() const { return cfg_; }
+    const PredictorStats& stats() const { return stats_; }
+    const char* name() const;
+
+    // Configuration and counters, as printed at the end of a run.
+    void report(std::ostream& os) const;
+
+private:
+    static constexpr uint32_t kNoBranch = 0xFFFFFFFFu;   // never a PC
+
+    uint32_t index(uint32_t pc) const;
+    bool btb_lookup(uint32_t pc) const;
+
+    PredictorConfig cfg_;
+    std::vector<uint8_t> counters_;    // 2-bit saturating, >= 2 is taken
+    uint32_t history_{0};
+    // BTB tags. Targets are static and the tag is the full branch PC, so
+    // a hit always supplies the right target; only presence is modelled.
+    std::vector<uint32_t> btb_pc_;
+    PredictorStats stats_;
+};
+
+#endif // MIPS_BRANCH_H
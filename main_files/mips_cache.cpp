@@ -0,0 +1,229 @@
+// mips_cache.cpp
+// Set-associative cache levels and the L1I/L1D/L2 hierarchy.
+
+#include "mips_cache.h"
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+// ---------------- configuration ----------------
+namespace {
+
+bool pow2(uint64_t v) {
+    return v != 0 && (v & (v - 1)) == 0;
+}
+
+uint32_t log2_of(uint32_t v) {
+    uint32_t n = 0;
+    while (v >>= 1) ++n;
+    return n;
+}
+
+[[noreturn]] void bad_spec(string_view spec, const string& what) {
+    throw invalid_argument("cache spec '" + string(spec) + "': " + what);
+}
+
+uint32_t parse_size(string_view spec, string_view v) {
+    uint64_t scale = 1;
+    if (!v.empty() && (v.back() == 'k' || v.back() == 'K')) scale = 1024;
+    if (!v.empty() && (v.back() == 'm' || v.back() == 'M')) scale = 1024 * 1024;
+    if (scale != 1) v.remove_suffix(1);
+    if (v.empty()) bad_spec(spec, "missing number");
+    uint64_t x = 0;
+    for (char c : v) {
+        if (c < '0' || c > '9' || x > UINT32_MAX)
+            bad_spec(spec, "bad number '" + string(v) + "'");
+        x = x * 10 + (c - '0');
+    }
+    x *= scale;
+    if (x > UINT32_MAX) bad_spec(spec, "value too large");
+    return static_cast<uint32_t>(x);
+}
+
+} // namespace
+
+CacheConfig parseCacheConfig(string_view spec, CacheConfig cfg) {
+    if (spec == "default") return cfg;
+    string_view rest = spec;
+    while (!rest.empty()) {
+        size_t comma = rest.find(',');
+        string_view item = rest.substr(0, comma);
+        rest.remove_prefix(comma == string_view::npos ? rest.size() : comma + 1);
+
+        size_t eq = item.find('=');
+        if (eq == string_view::npos)
+            bad_spec(spec, "expected key=value, got '" + string(item) + "'");
+        string_view key = item.substr(0, eq), v = item.substr(eq + 1);
+        if (key == "size")      cfg.size_bytes = parse_size(spec, v);
+        else if (key == "line") cfg.line_bytes = parse_size(spec, v);
+        else if (key == "ways") cfg.ways       = parse_size(spec, v);
+        else if (key == "lat")  cfg.latency    = parse_size(spec, v);
+        else if (key == "repl") {
+            if (v == "lru")         cfg.replacement = Replacement::LRU;
+            else if (v == "fifo")   cfg.replacement = Replacement::FIFO;
+            else if (v == "random") cfg.replacement = Replacement::Random;
+            else bad_spec(spec, "repl must be lru, fifo or random");
+        } else if (key == "write") {
+            if (v == "back")         cfg.write_back = true;
+            else if (v == "through") cfg.write_back = false;
+            else bad_spec(spec, "write must be back or through");
+        } else if (key == "alloc") {
+            if (v == "yes")     cfg.write_allocate = true;
+            else if (v == "no") cfg.write_allocate = false;
+            else bad_spec(spec, "alloc must be yes or no");
+        } else {
+            bad_spec(spec, "unknown key '" + string(key) + "'");
+        }
+    }
+    try {
+        (void)Cache(cfg);   // geometry errors surface here, not mid-run
+    } catch (const invalid_argument& e) {
+        bad_spec(spec, e.what());
+    }
+    return cfg;
+}
+
+// ---------------- one level ----------------
+Cache::Cache(const CacheConfig& cfg) : cfg_(cfg) {
+    if (!pow2(cfg.line_bytes) || cfg.line_bytes < 4)
+        throw invalid_argument("cache line size must be a power of two >= 4");
+    if (!pow2(cfg.ways))
+        throw invalid_argument("cache ways must be a power of two");
+    uint64_t set_bytes = uint64_t(cfg.line_bytes) * cfg.ways;
+    if (cfg.size_bytes % set_bytes != 0 || !pow2(cfg.size_bytes / set_bytes))
+        throw invalid_argument("cache size must be a power-of-two number of "
+                               "line x ways sets");
+    if (cfg.latency == 0)
+        throw invalid_argument("cache latency must be at least one cycle");
+
+    line_shift_ = log2_of(cfg.line_bytes);
+    set_mask_   = static_cast<uint32_t>(cfg.size_bytes / set_bytes) - 1;
+    size_t lines = cfg.size_bytes / cfg.line_bytes;
+    tags_.assign(lines, kInvalid);
+    stamps_.assign(lines, 0);
+    dirty_.assign(lines, 0);
+}
+
+Cache::Result Cache::access_set(uint32_t tag, bool write) {
+    uint32_t line = tag & ~kInstrLine;
+    size_t base   = size_t(line & set_mask_) * cfg_.ways;
+    uint32_t* set = &tags_[base];
+    ++clock_;
+    for (uint32_t w = 0; w < cfg_.ways; ++w) {
+        if (set[w] != tag) continue;
+        if (cfg_.replacement == Replacement::LRU) stamps_[base + w] = clock_;
+        if (write && cfg_.write_back) dirty_[base + w] = 1;
+        last_tag_  = tag;
+        last_slot_ = base + w;
+        return {true, true, false, 0};
+    }
+
+    write ? ++stats_.write_misses : ++stats_.read_misses;
+    if (write && !cfg_.write_allocate) return {};
+
+    Result r{false, true, false, 0};
+    uint32_t w = victim(base);
+    if (set[w] != kInvalid) {
+        ++stats_.evictions;
+        if (dirty_[base + w]) {
+            ++stats_.writebacks;
+            r.writeback   = true;
+            r.victim_addr = (set[w] & ~kInstrLine) << line_shift_;
+        }
+    }
+    set[w]            = tag;
+    stamps_[base + w] = clock_;
+    dirty_[base + w]  = write && cfg_.write_back;
+    last_tag_  = tag;
+    last_slot_ = base + w;
+    return r;
+}
+
+// First empty way, else the replacement policy's choice.
+uint32_t Cache::victim(size_t base) {
+    for (uint32_t w = 0; w < cfg_.ways; ++w)
+        if (tags_[base + w] == kInvalid) return w;
+    if (cfg_.replacement == Replacement::Random) {
+        rng_ ^= rng_ << 13;
+        rng_ ^= rng_ >> 7;
+        rng_ ^= rng_ << 17;
+        return static_cast<uint32_t>(rng_ & (cfg_.ways - 1));
+    }
+    // LRU and FIFO both evict the oldest stamp; they differ in whether a
+    // hit refreshes it
+    uint32_t oldest = 0;
+    for (uint32_t w = 1; w < cfg_.ways; ++w)
+        if (stamps_[base + w] < stamps_[base + oldest]) oldest = w;
+    return oldest;
+}
+
+void Cache::invalidate() {
+    fill(tags_.begin(), tags_.end(), kInvalid);
+    fill(stamps_.begin(), stamps_.end(), 0);
+    fill(dirty_.begin(), dirty_.end(), 0);
+    clock_    = 0;
+    last_tag_ = kInvalid;
+}
+
+// ---------------- hierarchy ----------------
+CacheHierarchy::CacheHierarchy(const CacheHierarchyConfig& cfg)
+    : enabled_(true), memory_latency_(cfg.memory_latency) {
+    if (cfg.l1i) l1i_.emplace(*cfg.l1i);
+    if (cfg.l1d) l1d_.emplace(*cfg.l1d);
+    if (cfg.l2)  l2_.emplace(*cfg.l2);
+}
+
+uint32_t CacheHierarchy::access(Cache& c, uint32_t addr, bool write,
+                                bool instruction) {
+    Cache::Result r = c.access(addr, write, instruction);
+    if (r.writeback) write_below(r.victim_addr);
+    uint32_t cycles = c.config().latency;
+    if (!r.hit && r.allocated) cycles += fill(addr, instruction);
+    if (write && (!r.allocated || !c.config().write_back)) write_below(addr);
+    return cycles;
+}
+
+// Latency of bringing a line into an L1 from below.
+uint32_t CacheHierarchy::fill(uint32_t addr, bool instruction) {
+    if (!l2_) return memory_latency_;
+    Cache::Result r = l2_->access(addr, false, instruction);
+    return l2_->config().latency + (r.hit ? 0 : memory_latency_);
+}
+
+// Buffered write to the level below an L1. What the L2 evicts in turn
+// only shows in its counters.
+void CacheHierarchy::write_below(uint32_t addr) {
+    if (l2_) l2_->access(addr, true);
+}
+
+void CacheHierarchy::reset() {
+    for (optional<Cache>* c : {&l1i_, &l1d_, &l2_})
+        if (*c) {
+            (*c)->invalidate();
+            (*c)->resetStats();
+        }
+    stall_cycles_ = 0;
+}
+
+void CacheHierarchy::report(ostream& os) const {
+    os << "Cache    accesses      misses   miss%   evictions  writebacks\n";
+    auto row = [&](const char* name, const Cache* c) {
+        if (!c) return;
+        const CacheStats& s = c->stats();
+        double rate = s.accesses() ? 100.0 * s.misses() / s.accesses() : 0.0;
+        os << left << setw(5) << name << right << setw(11) << s.accesses()
+           << setw(12) << s.misses() << setw(8) << fixed << setprecision(2)
+           << rate << setw(12) << s.evictions << setw(12) << s.writebacks
+           << "\n";
+        os.unsetf(ios::floatfield);
+        os << setprecision(6);
+    };
+    row("L1I", l1i());
+    row("L1D", l1d());
+    row("L2", l2());
+    os << "Cache miss stalls: " << stall_cycles_ << " cycles\n";
+}
@@ -0,0 +1,179 @@
+// mips_cache.h
+#ifndef MIPS_CACHE_H
+#define MIPS_CACHE_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Timing model of the cache hierarchy in front of WordMemory.
+//
+// The caches track tags only: data always lives in WordMemory, so the
+// model changes cycle counts, never results. MIPSPipeline asks it how long
+// each fetch (L1I) and load/store (L1D) takes and freezes the pipeline for
+// the cycles beyond the stage's own one. Both L1s miss into an optional
+// unified L2, and the L2 (or an L1 without one) into main memory.
+//
+// Writes to the level below - write-back victims, write-through stores,
+// stores that miss without allocating - go through a write buffer and cost
+// the pipeline nothing; they still update the lower level's tags and
+// counters.
+
+enum class Replacement : uint8_t { LRU, FIFO, Random };
+
+struct CacheConfig {
+    uint32_t size_bytes{32 * 1024};
+    uint32_t line_bytes{64};
+    uint32_t ways{8};
+    Replacement replacement{Replacement::LRU};
+    bool write_back{true};       // false: write-through, lines never dirty
+    bool write_allocate{true};   // false: store misses bypass this level
+    uint32_t latency{1};         // cycles for a hit
+};
+
+// Reads "key=value,..." over `base`, e.g. "size=64k,ways=4,repl=fifo".
+// Keys: size (k/m suffixes), ways, line, repl (lru|fifo|random),
+// write (back|through), alloc (yes|no), lat. "default" keeps `base`.
+// Throws std::invalid_argument on unknown keys or a bad geometry (see
+// Cache).
+CacheConfig parseCacheConfig(std::string_view spec, CacheConfig base);
+
+struct CacheStats {
+    uint64_t reads{0}, writes{0};
+    uint64_t read_misses{0}, write_misses{0};
+    uint64_t evictions{0};    // valid lines replaced
+    uint64_t writebacks{0};   // of those, dirty ones
+
+    uint64_t accesses() const { return reads + writes; }
+    uint64_t misses() const { return read_misses + write_misses; }
+    uint64_t hits() const { return accesses() - misses(); }
+};
+
+// One set-associative level. Tags, replacement stamps and dirty bits are
+// kept in separate arrays (structure of arrays), set-major, so a lookup
+// scans one set's tags in a single contiguous run.
+class Cache {
+public:
+    // Line size, way count and set count must be powers of two, lines at
+    // least one word and the latency at least one cycle; throws
+    // std::invalid_argument otherwise.
+    explicit Cache(const CacheConfig& cfg);
+
+    struct Result {
+        bool hit{false};
+        bool allocated{false};    // the line is present after the access
+        bool writeback{false};    // a dirty victim must go to the level below
+        uint32_t victim_addr{0};
+    };
+
+    // Looks up the line holding byte `addr`, filling it on a miss (unless a
+    // store without write-allocate). Instruction lines are tagged apart
+    // from data lines, so a unified cache never confuses the two spaces.
+    Result access(uint32_t addr, bool write, bool instruction = false) {
+        uint32_t tag = (addr >> line_shift_) | (instruction ? kInstrLine : 0);
+        write ? ++stats_.writes : ++stats_.reads;
+        // Same line as the previous access: it is already the newest in
+        // its set, so only the dirty bit can change.
+        if (tag == last_tag_) {
+            if (write && cfg_.write_back) dirty_[last_slot_] = 1;
+            return {true, true, false, 0};
+        }
+        return access_set(tag, write);
+    }
+
+    void invalidate();   // empties every line; counters are kept
+    void resetStats() { stats_ = {}; }
+
+    const CacheConfig& config() const { return cfg_; }
+    const CacheStats& stats() const { return stats_; }
+
+private:
+    static constexpr uint32_t kInvalid   = 0xFFFFFFFFu;
+    static constexpr uint32_t kInstrLine = 1u << 31;   // never a data line
+
+    Result access_set(uint32_t tag, bool write);
+    uint32_t victim(size_t set_base);
+
+    CacheConfig cfg_;
+    uint32_t line_shift_{0};
+    uint32_t set_mask_{0};
+
+    std::vector<uint32_t> tags_;     // line address | kInstrLine, or kInvalid
+    std::vector<uint64_t> stamps_;   // LRU: last use, FIFO: fill time
+    std::vector<uint8_t>  dirty_;
+    uint64_t clock_{0};
+    uint32_t last_tag_{kInvalid};   // line of the previous access
+    size_t last_slot_{0};
+    uint64_t rng_{0x9E3779B97F4A7C15ull};
+    CacheStats stats_;
+};
+
+struct CacheHierarchyConfig {
+    // An absent L1 never stalls its side; an absent L2 sends L1 misses
+    // straight to memory.
+    std::optional<CacheConfig> l1i, l1d, l2;
+    uint32_t memory_latency{100};
+};
+
+// The L1I/L1D/L2 arrangement MIPSPipeline consults. Default-constructed
+// it is disabled and the pipeline keeps its fixed one-cycle memory stages.
+class CacheHierarchy {
+public:
+    CacheHierarchy() = default;
+    explicit CacheHierarchy(const CacheHierarchyConfig& cfg);
+
+    bool enabled() const { return enabled_; }
+
+    // Stall cycles beyond the stage's own cycle for one access.
+    uint32_t fetch(uint32_t pc) {
+        return l1i_ ? access(*l1i_, pc, false, true) - 1 : 0;
+    }
+    // fetch() in two halves, for a caller that keeps the L1I and the levels
+    // below on different threads (MIPSPipeline's stage threads): the L1I's
+    // own stall, with `miss` set when fetchFill() must bring the line in.
+    // Fetches never dirty a line, so the L1I alone never writes below.
+    uint32_t fetchL1(uint32_t pc, bool& miss) {
+        miss = false;
+        if (!l1i_) return 0;
+        Cache::Result r = l1i_->access(pc, false, true);
+        miss = !r.hit && r.allocated;
+        return l1i_->config().latency - 1;
+    }
+    uint32_t fetchFill(uint32_t pc) { return fill(pc, true); }
+
+    uint32_t load(uint32_t addr) {
+        return l1d_ ? access(*l1d_, addr, false, false) - 1 : 0;
+    }
+    uint32_t store(uint32_t addr) {
+        return l1d_ ? access(*l1d_, addr, true, false) - 1 : 0;
+    }
+
+    // Cycles the pipeline spent frozen on misses (overlapping fetch and
+    // data misses count once).
+    void addStall(uint32_t cycles) { stall_cycles_ += cycles; }
+    uint64_t stallCycles() const { return stall_cycles_; }
+
+    // Empties every level and clears the counters.
+    void reset();
+
+    const Cache* l1i() const { return l1i_ ? &*l1i_ : nullptr; }
+    const Cache* l1d() const { return l1d_ ? &*l1d_ : nullptr; }
+    const Cache* l2() const { return l2_ ? &*l2_ : nullptr; }
+
+    // Per-level counter table, as printed at the end of a run.
+    void report(std::ostream& os) const;
+
+private:
+    uint32_t access(Cache& c, uint32_t addr, bool write, bool instruction);
+    uint32_t fill(uint32_t addr, bool instruction);
+    void write_below(uint32_t addr);
+
+    bool enabled_{false};
+    std::optional<Cache> l1i_, l1d_, l2_;
+    uint32_t memory_latency_{100};
+    uint64_t stall_cycles_{0};
+};
+
+#endif // MIPS_CACHE_H
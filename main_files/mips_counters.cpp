@@ -0,0 +1,52 @@
+// mips_counters.cpp
+// JSON and CSV summaries of the pipeline's performance counters.
+
+#include "mips_counters.h"
+#include <iomanip>
+#include <ostream>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+const char* mnemonic(size_t op) {
+    return kOpInfo[op].name;
+}
+
+} // namespace
+
+void PerfCounters::writeJson(ostream& os) const {
+    os << "{\n  \"cycles\": " << cycles << ", \"retired\": " << retired
+       << ", \"cpi\": " << fixed << setprecision(4) << cpi()
+       << ",\n  \"load_use_stalls\": " << load_use_stalls
+       << ", \"flushes\": " << flushes
+       << ",\n  \"forwards\": {\"ex_mem\": " << fwd_ex_mem
+       << ", \"mem_wb\": " << fwd_mem_wb << "},\n  \"retired_by_op\": {";
+    os.unsetf(ios::floatfield);
+    os << setprecision(6);
+    bool first = true;
+    for (size_t op = 0; op < kOpCount; ++op) {
+        if (!retired_by_op[op]) continue;
+        os << (first ? "" : ", ") << '"' << mnemonic(op)
+           << "\": " << retired_by_op[op];
+        first = false;
+    }
+    os << "}\n}\n";
+}
+
+void PerfCounters::writeCsv(ostream& os) const {
+    os << "counter,value\n"
+       << "cycles," << cycles << "\n"
+       << "retired," << retired << "\n"
+       << "cpi," << fixed << setprecision(4) << cpi() << "\n";
+    os.unsetf(ios::floatfield);
+    os << setprecision(6);
+    os << "load_use_stalls," << load_use_stalls << "\n"
+       << "flushes," << flushes << "\n"
+       << "forwards.ex_mem," << fwd_ex_mem << "\n"
+       << "forwards.mem_wb," << fwd_mem_wb << "\n";
+    for (size_t op = 0; op < kOpCount; ++op)
+        if (retired_by_op[op])
+            os << "retired." << mnemonic(op) << "," << retired_by_op[op] << "\n";
+}
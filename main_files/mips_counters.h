@@ -0,0 +1,115 @@
+// mips_counters.h
+#ifndef MIPS_COUNTERS_H
+#define MIPS_COUNTERS_H
+
+#include "mips_ir.hpp"
+#include "mips_profile.h"
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+
+// Performance counters for MIPSPipeline.
+//
+// step() is a template over a counter policy: CountNothing, whose hooks
+// are empty and compile away, CountEvents, which bumps the fields of a
+// PerfCounters, or ProfileEvents, which also charges every cycle to a PC
+// (mips_profile.h). run() picks the instantiation once per call, so a
+// pipeline without counters enabled runs exactly the code it always did.
+//
+// Only cycles simulated by step() are counted. Fast-forwarded instructions
+// are not, event skipping is turned off while counting, and a restored
+// snapshot starts the counters from zero.
+
+struct PerfCounters {
+    uint64_t cycles{0};            // including cycles frozen on cache misses
+    uint64_t retired{0};           // instructions leaving WB, NOP and HALT too
+    uint64_t load_use_stalls{0};   // cycles IF/ID was held behind a load
+    uint64_t flushes{0};           // branches/jumps that redirected fetch
+    // Operand muxes in EX switched to a forwarded value, by the latch the
+    // value came from. EX/MEM wins when both hold the register, and only
+    // that forward is counted.
+    uint64_t fwd_ex_mem{0};
+    uint64_t fwd_mem_wb{0};
+    std::array<uint64_t, kOpCount> retired_by_op{};
+    PcProfile profile;             // empty unless profiling
+
+    // Zeroes everything; a profile keeps its size.
+    void clear() {
+        size_t pcs = profile.counts().size();
+        *this = PerfCounters();
+        if (pcs) profile.reset(pcs - 1);
+    }
+
+    double cpi() const {
+        return retired ? double(cycles) / double(retired) : 0.0;
+    }
+
+    // Machine-readable summaries. JSON is one object; CSV is "counter,value"
+    // rows with the per-opcode counts as retired.<MNEMONIC>.
+    void writeJson(std::ostream& os) const;
+    void writeCsv(std::ostream& os) const;
+};
+
+// Counter policies for MIPSPipeline::step_cycle<>(). Every hook takes the
+// counters to update, so no policy holds state of its own. Hooks get the
+// PC an event belongs to; only ProfileEvents looks at it.
+struct CountNothing {
+    static void cycle(PerfCounters&, uint32_t, uint32_t) {}
+    static void miss(PerfCounters&, uint32_t, uint64_t) {}
+    static void retire(PerfCounters&, uint32_t, Op) {}
+    static void stall(PerfCounters&, uint32_t) {}
+    static void flush(PerfCounters&, uint32_t) {}
+    static void forward(PerfCounters&, bool, bool) {}
+};
+
+struct CountEvents {
+    // One cycle, charged to `pc` (PcProfile::kBubble: EX is empty); `blame`
+    // is who an empty EX next cycle is charged to (see ProfileEvents).
+    static void cycle(PerfCounters& c, uint32_t, uint32_t) { ++c.cycles; }
+    // n cycles frozen on a cache miss by the access of the instruction at pc.
+    static void miss(PerfCounters& c, uint32_t, uint64_t n) { c.cycles += n; }
+    static void retire(PerfCounters& c, uint32_t, Op op) {
+        ++c.retired;
+        ++c.retired_by_op[static_cast<size_t>(op)];
+    }
+    static void stall(PerfCounters& c, uint32_t) { ++c.load_use_stalls; }
+    static void flush(PerfCounters& c, uint32_t) { ++c.flushes; }
+    // One operand's source: from EX/MEM, else from MEM/WB, else neither.
+    static void forward(PerfCounters& c, bool ex_mem, bool mem_wb) {
+        if (ex_mem)      ++c.fwd_ex_mem;
+        else if (mem_wb) ++c.fwd_mem_wb;
+    }
+};
+
+// CountEvents plus the per-PC breakdown in PerfCounters::profile. A cycle
+// belongs to the instruction in EX; a bubble in EX to whoever caused it
+// (the load-use consumer waiting in ID, or the branch that flushed), and
+// the cycle in which a branch squashes EX to that branch. Stalls go to the
+// consumer, flushes to the branch, miss cycles to the missing access.
+struct ProfileEvents : CountEvents {
+    static void cycle(PerfCounters& c, uint32_t pc, uint32_t blame) {
+        CountEvents::cycle(c, pc, blame);
+        ++c.profile.at(pc == PcProfile::kBubble ? c.profile.blame : pc).cycles;
+        c.profile.blame = blame;
+    }
+    static void miss(PerfCounters& c, uint32_t pc, uint64_t n) {
+        CountEvents::miss(c, pc, n);
+        PcCounts& p = c.profile.at(pc);
+        p.cycles      += n;
+        p.miss_cycles += n;
+    }
+    static void retire(PerfCounters& c, uint32_t pc, Op op) {
+        CountEvents::retire(c, pc, op);
+        ++c.profile.at(pc).executions;
+    }
+    static void stall(PerfCounters& c, uint32_t pc) {
+        CountEvents::stall(c, pc);
+        ++c.profile.at(pc).stalls;
+    }
+    static void flush(PerfCounters& c, uint32_t pc) {
+        CountEvents::flush(c, pc);
+        ++c.profile.at(pc).flushes;
+    }
+};
+
+#endif // MIPS_COUNTERS_H
@@ -0,0 +1,29 @@
+// mips_hash.h
+#ifndef MIPS_HASH_H
+#define MIPS_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// 64-bit content hash for caches, snapshots and reports (not
+// cryptographic): eight bytes per step with multiply-xorshift mixing.
+inline uint64_t hash64(const void* data, size_t n, uint64_t seed = 0) {
+    constexpr uint64_t k = 0xFF51AFD7ED558CCDull;
+    const char* s = static_cast<const char*>(data);
+    uint64_t h = (0x9E3779B97F4A7C15ull ^ seed) ^ n;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, s + i, 8);
+        h = (h ^ w) * k;
+        h ^= h >> 32;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, s + i, n - i);
+    h = (h ^ tail) * k;
+    h ^= h >> 29;
+    return h;
+}
+
+#endif // MIPS_HASH_H
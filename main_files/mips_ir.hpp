@@ -3,16 +3,201 @@
 #define MIPS_IR_HPP
 
 #include <string>
-#include <sstream>
 #include <cstdint>
+#include <type_traits>
+#include <vector>
 
 // Bridge between mips_core.h types and mips_pipeline.cpp expectations
 // Note: mips_pipeline.cpp expects Instruction, Op from mips_ir.hpp
 // We define them here to match what mips_pipeline.cpp needs
 
-enum class Op {
-    ADD, ADDI, SUB, MUL, AND, OR, SLL, SRL, SLT,
-    LW, SW, BEQ, BNE, J, HALT, NOP
+enum class Op : uint8_t {
+    // register-register ALU
+    ADD, SUB, AND, OR, XOR, NOR, SLT, SLTU, MUL,
+    SLL, SRL, SRA, SLLV, SRLV, SRAV,
+    // register-immediate ALU
+    ADDI, SLTI, SLTIU, ANDI, ORI, XORI, LUI,
+    // multiply/divide unit
+    MULT, MULTU, DIV, DIVU, MFHI, MFLO, MTHI, MTLO,
+    // loads and stores
+    LB, LBU, LH, LHU, LW, SB, SH, SW,
+    // control transfer
+    BEQ, BNE, BLEZ, BGTZ, BLTZ, BGEZ, J, JAL, JR, JALR,
+    HALT, NOP   // NOP stays last: kOpCount below
+};
+
+constexpr size_t kOpCount = static_cast<size_t>(Op::NOP) + 1;
+
+// ---------------- the instruction table ----------------
+// One row per Op, in Op order: assembler syntax, machine encoding and the
+// datapath control it decodes to. The lexer, the binary loader,
+// MIPSPipeline::predecode() and disassembly all read this table; adding
+// an instruction is a new row plus its semantics in the engines.
+
+// Operands as written in assembly
+enum class Format : uint8_t {
+    None,         // HALT
+    RdRsRt,       // ADD  rd, rs, rt
+    RdRtShamt,    // SLL  rd, rt, shamt
+    RdRtRs,       // SLLV rd, rt, rs
+    RtRsImm,      // ADDI rt, rs, imm
+    RtImm,        // LUI  rt, imm
+    RtMem,        // LW   rt, off(rs)
+    RsRtLabel,    // BEQ  rs, rt, label
+    RsLabel,      // BLEZ rs, label
+    Target,       // J    label
+    Rs,           // JR   rs
+    RdRs,         // JALR [rd,] rs     (rd defaults to $31)
+    Rd,           // MFHI rd
+    RsRt          // MULT rs, rt
+};
+
+// Where the op lives in the MIPS32 encoding
+enum class Enc : uint8_t {
+    None,         // not encodable (NOP is sll $0, $0, 0)
+    Primary,      // `code` is the opcode
+    Special,      // opcode 0, `code` is funct
+    Special2,     // opcode 0x1C, `code` is funct
+    RegImm        // opcode 1, `code` is the rt field
+};
+
+// What EX computes for the destination register
+enum class AluOp : uint8_t {
+    Add, Sub, And, Or, Xor, Nor, Slt, Sltu, Mul,
+    Sll, Srl, Sra, Sllv, Srlv, Srav,
+    Link          // the return address, pre-computed into imm
+};
+
+// Taken condition of a conditional branch (rs against rt or zero)
+enum class Cond : uint8_t { Eq, Ne, Lez, Gtz, Ltz, Gez };
+
+// How the instruction's immediate becomes the micro-op's imm
+enum class ImmKind : uint8_t {
+    Sign,         // sign-extended 16 bits
+    Zero,         // zero-extended 16 bits (ANDI, ORI, XORI)
+    Upper,        // imm << 16 (LUI)
+    Shamt,        // the shift amount
+    Target        // J/JAL 26-bit word index
+};
+
+// Control flags of an OpInfo row
+enum : uint16_t {
+    kRegWrite  = 1 << 0,
+    kMemRead   = 1 << 1,
+    kMemWrite  = 1 << 2,
+    kBranch    = 1 << 3,
+    kJump      = 1 << 4,
+    kALUSrc    = 1 << 5,    // second operand is imm
+    kRegDst    = 1 << 6,    // destination is rd, not rt
+    kLink      = 1 << 7,    // writes the return address
+    kIndirect  = 1 << 8,    // jump target is rs
+    kHiLoRead  = 1 << 9,    // MFHI/MFLO
+    kHiLoWrite = 1 << 10,   // MULT/DIV/MTHI/MTLO
+    kSigned    = 1 << 11    // sub-word load sign-extends
+};
+
+struct OpInfo {
+    const char* name;
+    Format   format;
+    Enc      enc;
+    uint8_t  code;
+    uint16_t flags;
+    AluOp    alu;
+    uint8_t  bytes;   // memory access width
+    Cond     cond;
+    ImmKind  imm;
+};
+
+namespace op_table {
+constexpr uint16_t R  = kRegWrite | kRegDst;   // rd = rs op rt
+constexpr uint16_t I  = kRegWrite | kALUSrc;   // rt = rs op imm
+constexpr uint16_t LD = kRegWrite | kMemRead | kALUSrc;
+constexpr uint16_t ST = kMemWrite | kALUSrc;
+constexpr uint16_t SH = R | kALUSrc;           // shift by shamt
+constexpr uint16_t HW = kHiLoWrite;
+constexpr uint16_t HR = R | kHiLoRead;
+}
+
+constexpr OpInfo kOpInfo[] = {
+    // name     format              encoding          flags             ALU            width condition    immediate
+    {"ADD",   Format::RdRsRt,    Enc::Special,  0x20, op_table::R,  AluOp::Add,  0, Cond::Eq,  ImmKind::Sign},
+    {"SUB",   Format::RdRsRt,    Enc::Special,  0x22, op_table::R,  AluOp::Sub,  0, Cond::Eq,  ImmKind::Sign},
+    {"AND",   Format::RdRsRt,    Enc::Special,  0x24, op_table::R,  AluOp::And,  0, Cond::Eq,  ImmKind::Sign},
+    {"OR",    Format::RdRsRt,    Enc::Special,  0x25, op_table::R,  AluOp::Or,   0, Cond::Eq,  ImmKind::Sign},
+    {"XOR",   Format::RdRsRt,    Enc::Special,  0x26, op_table::R,  AluOp::Xor,  0, Cond::Eq,  ImmKind::Sign},
+    {"NOR",   Format::RdRsRt,    Enc::Special,  0x27, op_table::R,  AluOp::Nor,  0, Cond::Eq,  ImmKind::Sign},
+    {"SLT",   Format::RdRsRt,    Enc::Special,  0x2A, op_table::R,  AluOp::Slt,  0, Cond::Eq,  ImmKind::Sign},
+    {"SLTU",  Format::RdRsRt,    Enc::Special,  0x2B, op_table::R,  AluOp::Sltu, 0, Cond::Eq,  ImmKind::Sign},
+    {"MUL",   Format::RdRsRt,    Enc::Special2, 0x02, op_table::R,  AluOp::Mul,  0, Cond::Eq,  ImmKind::Sign},
+    {"SLL",   Format::RdRtShamt, Enc::Special,  0x00, op_table::SH, AluOp::Sll,  0, Cond::Eq,  ImmKind::Shamt},
+    {"SRL",   Format::RdRtShamt, Enc::Special,  0x02, op_table::SH, AluOp::Srl,  0, Cond::Eq,  ImmKind::Shamt},
+    {"SRA",   Format::RdRtShamt, Enc::Special,  0x03, op_table::SH, AluOp::Sra,  0, Cond::Eq,  ImmKind::Shamt},
+    {"SLLV",  Format::RdRtRs,    Enc::Special,  0x04, op_table::R,  AluOp::Sllv, 0, Cond::Eq,  ImmKind::Sign},
+    {"SRLV",  Format::RdRtRs,    Enc::Special,  0x06, op_table::R,  AluOp::Srlv, 0, Cond::Eq,  ImmKind::Sign},
+    {"SRAV",  Format::RdRtRs,    Enc::Special,  0x07, op_table::R,  AluOp::Srav, 0, Cond::Eq,  ImmKind::Sign},
+
+    {"ADDI",  Format::RtRsImm,   Enc::Primary,  0x08, op_table::I,  AluOp::Add,  0, Cond::Eq,  ImmKind::Sign},
+    {"SLTI",  Format::RtRsImm,   Enc::Primary,  0x0A, op_table::I,  AluOp::Slt,  0, Cond::Eq,  ImmKind::Sign},
+    {"SLTIU", Format::RtRsImm,   Enc::Primary,  0x0B, op_table::I,  AluOp::Sltu, 0, Cond::Eq,  ImmKind::Sign},
+    {"ANDI",  Format::RtRsImm,   Enc::Primary,  0x0C, op_table::I,  AluOp::And,  0, Cond::Eq,  ImmKind::Zero},
+    {"ORI",   Format::RtRsImm,   Enc::Primary,  0x0D, op_table::I,  AluOp::Or,   0, Cond::Eq,  ImmKind::Zero},
+    {"XORI",  Format::RtRsImm,   Enc::Primary,  0x0E, op_table::I,  AluOp::Xor,  0, Cond::Eq,  ImmKind::Zero},
+    {"LUI",   Format::RtImm,     Enc::Primary,  0x0F, op_table::I,  AluOp::Add,  0, Cond::Eq,  ImmKind::Upper},
+
+    {"MULT",  Format::RsRt,      Enc::Special,  0x18, op_table::HW, AluOp::Add,  0, Cond::Eq,  ImmKind::Sign},
+    {"MULTU", Format::RsRt,      Enc::Special,  0x19, op_table::HW, AluOp::Add,  0, Cond::Eq,  ImmKind::Sign},
+    {"DIV",   Format::RsRt,      Enc::Special,  0x1A, op_table::HW, AluOp::Add,  0, Cond::Eq,  ImmKind::Sign},
+    {"DIVU",  Format::RsRt,      Enc::Special,  0x1B, op_table::HW, AluOp::Add,  0, Cond::Eq,  ImmKind::Sign},
+    {"MFHI",  Format::Rd,        Enc::Special,  0x10, op_table::HR, AluOp::Add,  0, Cond::Eq,  ImmKind::Sign},
+    {"MFLO",  Format::Rd,        Enc::Special,  0x12, op_table::HR, AluOp::Add,  0, Cond::Eq,  ImmKind::Sign},
+    {"MTHI",  Format::Rs,        Enc::Special,  0x11, op_table::HW, AluOp::Add,  0, Cond::Eq,  ImmKind::Sign},
+    {"MTLO",  Format::Rs,        Enc::Special,  0x13, op_table::HW, AluOp::Add,  0, Cond::Eq,  ImmKind::Sign},
+
+    {"LB",    Format::RtMem,     Enc::Primary,  0x20, op_table::LD | kSigned, AluOp::Add, 1, Cond::Eq, ImmKind::Sign},
+    {"LBU",   Format::RtMem,     Enc::Primary,  0x24, op_table::LD, AluOp::Add,  1, Cond::Eq,  ImmKind::Sign},
+    {"LH",    Format::RtMem,     Enc::Primary,  0x21, op_table::LD | kSigned, AluOp::Add, 2, Cond::Eq, ImmKind::Sign},
+    {"LHU",   Format::RtMem,     Enc::Primary,  0x25, op_table::LD, AluOp::Add,  2, Cond::Eq,  ImmKind::Sign},
+    {"LW",    Format::RtMem,     Enc::Primary,  0x23, op_table::LD, AluOp::Add,  4, Cond::Eq,  ImmKind::Sign},
+    {"SB",    Format::RtMem,     Enc::Primary,  0x28, op_table::ST, AluOp::Add,  1, Cond::Eq,  ImmKind::Sign},
+    {"SH",    Format::RtMem,     Enc::Primary,  0x29, op_table::ST, AluOp::Add,  2, Cond::Eq,  ImmKind::Sign},
+    {"SW",    Format::RtMem,     Enc::Primary,  0x2B, op_table::ST, AluOp::Add,  4, Cond::Eq,  ImmKind::Sign},
+
+    {"BEQ",   Format::RsRtLabel, Enc::Primary,  0x04, kBranch,      AluOp::Sub,  0, Cond::Eq,  ImmKind::Sign},
+    {"BNE",   Format::RsRtLabel, Enc::Primary,  0x05, kBranch,      AluOp::Sub,  0, Cond::Ne,  ImmKind::Sign},
+    {"BLEZ",  Format::RsLabel,   Enc::Primary,  0x06, kBranch,      AluOp::Sub,  0, Cond::Lez, ImmKind::Sign},
+    {"BGTZ",  Format::RsLabel,   Enc::Primary,  0x07, kBranch,      AluOp::Sub,  0, Cond::Gtz, ImmKind::Sign},
+    {"BLTZ",  Format::RsLabel,   Enc::RegImm,   0x00, kBranch,      AluOp::Sub,  0, Cond::Ltz, ImmKind::Sign},
+    {"BGEZ",  Format::RsLabel,   Enc::RegImm,   0x01, kBranch,      AluOp::Sub,  0, Cond::Gez, ImmKind::Sign},
+    {"J",     Format::Target,    Enc::Primary,  0x02, kJump,        AluOp::Add,  0, Cond::Eq,  ImmKind::Target},
+    {"JAL",   Format::Target,    Enc::Primary,  0x03, kJump | kLink | kRegWrite, AluOp::Link, 0, Cond::Eq, ImmKind::Target},
+    {"JR",    Format::Rs,        Enc::Special,  0x08, kJump | kIndirect, AluOp::Add, 0, Cond::Eq, ImmKind::Sign},
+    {"JALR",  Format::RdRs,      Enc::Special,  0x09, kJump | kIndirect | kLink | op_table::R, AluOp::Link, 0, Cond::Eq, ImmKind::Sign},
+
+    {"HALT",  Format::None,      Enc::None,     0x00, 0,            AluOp::Add,  0, Cond::Eq,  ImmKind::Sign},
+    {"NOP",   Format::None,      Enc::None,     0x00, 0,            AluOp::Add,  0, Cond::Eq,  ImmKind::Sign},
+};
+static_assert(sizeof kOpInfo / sizeof kOpInfo[0] == kOpCount,
+              "kOpInfo needs one row per Op, in Op order");
+
+constexpr const OpInfo& opInfo(Op op) { return kOpInfo[static_cast<size_t>(op)]; }
+
+// Other names for an op: assembler spellings and machine encodings that
+// run as it (the overflow trap of ADD/SUB/ADDI is not modelled, so the
+// unsigned forms are the same instruction here; SYSCALL and BREAK stop
+// the program).
+struct OpAlias {
+    const char* name;
+    Op       op;
+    Enc      enc;
+    uint8_t  code;
+};
+
+constexpr OpAlias kOpAliases[] = {
+    {"ADDU",    Op::ADD,  Enc::Special, 0x21},
+    {"SUBU",    Op::SUB,  Enc::Special, 0x23},
+    {"ADDIU",   Op::ADDI, Enc::Primary, 0x09},
+    {"SYSCALL", Op::HALT, Enc::Special, 0x0C},
+    {"BREAK",   Op::HALT, Enc::Special, 0x0D},
 };
 
 // Forward declare to avoid conflict - mips_pipeline.cpp will use this
@@ -22,34 +207,36 @@ struct IRInstruction {
     uint8_t shamt = 0;
     int32_t imm = 0;
     uint32_t addr = 0;
-    std::string raw_label = "";
-    
-    std::string str() const {
-        std::ostringstream oss;
-        switch (op) {
-            case Op::ADD:  oss << "ADD"; break;
-            case Op::ADDI: oss << "ADDI"; break;
-            case Op::SUB:  oss << "SUB"; break;
-            case Op::MUL:  oss << "MUL"; break;
-            case Op::AND:  oss << "AND"; break;
-            case Op::OR:   oss << "OR"; break;
-            case Op::SLL:  oss << "SLL"; break;
-            case Op::SRL:  oss << "SRL"; break;
-            case Op::SLT:  oss << "SLT"; break;
-            case Op::LW:   oss << "LW"; break;
-            case Op::SW:   oss << "SW"; break;
-            case Op::BEQ:  oss << "BEQ"; break;
-            case Op::BNE:  oss << "BNE"; break;
-            case Op::J:    oss << "J"; break;
-            case Op::HALT: oss << "HALT"; break;
-            case Op::NOP:  oss << "NOP"; break;
-        }
-        return oss.str();
-    }
+
+    std::string str() const { return opInfo(op).name; }
 };
 
 // Alias for mips_pipeline.cpp compatibility  
 using Instruction = IRInstruction;
 
+// Instructions are copied through the pipeline every cycle, so they must
+// stay plain data.  Labels are resolved by the assembler (SymbolTable in
+// mips_assembler.h) before a program gets here.
+static_assert(std::is_trivially_copyable_v<Instruction>);
+static_assert(sizeof(Instruction) <= 16);
+
+// Read-only view of a program's instructions: a std::vector, or an array
+// mapped in place from a program cache (mips_program_cache.h). Whoever
+// owns the storage keeps it alive for as long as the view is used.
+struct ProgramView {
+    const Instruction* data{nullptr};
+    size_t size{0};
+
+    ProgramView() = default;
+    ProgramView(const Instruction* d, size_t n) : data(d), size(n) {}
+    ProgramView(const std::vector<Instruction>& v)
+        : data(v.data()), size(v.size()) {}
+
+    bool empty() const { return size == 0; }
+    const Instruction& operator[](size_t i) const { return data[i]; }
+    const Instruction* begin() const { return data; }
+    const Instruction* end() const { return data + size; }
+};
+
 #endif // MIPS_IR_HPP
 
@@ -0,0 +1,131 @@
+// mips_iss.cpp
+// Functional (one instruction per iteration) execution of the same program,
+// registers and memory the 5-stage model in mips_pipeline.cpp works on.
+// Used to fast-forward to a region of interest before switching to the
+// cycle-accurate pipeline.
+
+#include "mips_pipeline.h"
+#include "mips_superblock.h"
+#include "mips_threaded.h"
+#include <cstdint>
+
+using namespace std;
+
+// Let everything already in flight retire without fetching anything new.
+// A branch/jump resolving on the way still redirects pc_, so afterwards
+// pc_ is exactly the next instruction the program would execute.
+void MIPSPipeline::drain() {
+    fetch_enabled_ = false;
+    while (!halted_ &&
+           (if_id_.valid || id_ex_.valid || ex_mem_.valid || mem_wb_.valid))
+        step();
+    fetch_enabled_ = true;
+}
+
+// Architectural effect of one instruction; returns the next PC.
+uint32_t MIPSPipeline::execute(const MicroOp& u, uint32_t pc) {
+    const Control& c = u.c;
+    if (c.isNOP) return pc + 4;
+
+    // Bug 4: read protection for $0
+    int32_t a = (u.rs == 0) ? 0 : regs_[u.rs];
+    int32_t b = (u.rt == 0) ? 0 : regs_[u.rt];
+    int32_t result = c.HiLo ? hilo(u.op, a, b, hi_, lo_) : alu(u, a, b);
+
+    if (c.MemRead)
+        result = load(u, mem_, static_cast<uint32_t>(result));
+    else if (c.MemWrite)
+        store(u, mem_, static_cast<uint32_t>(result), b);
+
+    if (c.RegWrite && u.dest != 0)
+        regs_[u.dest] = result;
+
+    if (c.Indirect)
+        return static_cast<uint32_t>(a);
+    if (c.Jump || (c.Branch && branch_outcome(u, a, b)))
+        return u.target;
+    return pc + 4;
+}
+
+uint64_t MIPSPipeline::fastForward(uint64_t max_instrs, uint32_t stop_pc) {
+    drain();
+
+    if (ff_engine_ == FFEngine::Threaded) {
+        if (!threaded_) threaded_ = make_shared<ThreadedCode>(decoded_->uops);
+        uint64_t n = threaded_->run(regs_, hi_, lo_, mem_, pc_, halted_,
+                                    max_instrs, stop_pc);
+        ff_instrs_ += n;
+        return n;
+    }
+    if (ff_engine_ == FFEngine::Superblock) {
+        if (!superblocks_) superblocks_ = make_shared<SuperblockCache>(decoded_->uops);
+        uint64_t n = superblocks_->run(regs_, hi_, lo_, mem_, pc_, halted_,
+                                       max_instrs, stop_pc);
+        ff_instrs_ += n;
+        return n;
+    }
+
+    uint64_t n = 0;
+    while (!halted_ && n < max_instrs && pc_ != stop_pc &&
+           pc_ / 4 < n_uops_) {
+        const MicroOp& u = uops_[pc_ / 4];
+        pc_ = execute(u, pc_);
+        ++n;
+        if (u.op == Op::HALT)
+            halted_ = true;
+    }
+
+    ff_instrs_ += n;
+    return n;
+}
+
+// The interpreter loop again, with the cache model and the predictor
+// seeing what the pipeline would show them: the fetch, the load or store,
+// and each branch or jump predicted and then resolved.
+uint64_t MIPSPipeline::fastForwardWarm(uint64_t max_instrs) {
+    drain();
+
+    bool caches = caches_.enabled();
+    uint64_t n = 0;
+    while (!halted_ && n < max_instrs && pc_ / 4 < n_uops_) {
+        const MicroOp& u = uops_[pc_ / 4];
+        uint32_t pc = pc_;
+        int32_t a = (u.rs == 0) ? 0 : regs_[u.rs];
+        int32_t b = (u.rt == 0) ? 0 : regs_[u.rt];
+        if (caches) {
+            caches_.fetch(pc);
+            if (u.c.MemRead || u.c.MemWrite) {
+                uint32_t addr = static_cast<uint32_t>(alu(u, a, b));
+                u.c.MemWrite ? caches_.store(addr) : caches_.load(addr);
+            }
+        }
+        if (u.c.Branch || u.c.Jump) {
+            bool taken = u.c.Jump || branch_outcome(u, a, b);
+            bool guess = !u.c.Indirect && bp_.predict(pc, u.c.Jump, u.target);
+            bp_.resolve(pc, u.c.Jump, taken, guess);
+        }
+        pc_ = execute(u, pc);
+        ++n;
+        if (u.op == Op::HALT)
+            halted_ = true;
+    }
+
+    ff_instrs_ += n;
+    return n;
+}
+
+uint64_t MIPSPipeline::fastForwarded() const {
+    return ff_instrs_;
+}
+
+void MIPSPipeline::setFastForwardEngine(FFEngine engine) {
+    ff_engine_ = engine;
+}
+
+uint64_t MIPSPipeline::fastForwardCycleEstimate() const {
+    return ff_cycle_base_ + (superblocks_ ? superblocks_->timing().cycles() : 0);
+}
+
+uint32_t MIPSPipeline::pc() const {
+    return pc_;
+}
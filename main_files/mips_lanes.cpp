@@ -0,0 +1,645 @@
+// mips_lanes.cpp
+// Lockstep multi-lane functional engine (see mips_lanes.h).
+
+#include "mips_lanes.h"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+// Define MIPS_LANES_NO_VECTOR to force plain per-lane loops.
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(MIPS_LANES_NO_VECTOR)
+#define MIPS_LANES_VECTOR 1
+#endif
+
+namespace {
+
+#ifdef MIPS_LANES_VECTOR
+// one native vector register: AVX2 when enabled, else SSE2 / NEON
+#ifdef __AVX2__
+constexpr uint32_t kWidth = 8;   // lanes per vector
+#else
+constexpr uint32_t kWidth = 4;
+#endif
+typedef int32_t  VecI __attribute__((vector_size(kWidth * 4)));
+typedef uint32_t VecU __attribute__((vector_size(kWidth * 4)));
+
+VecI load(const int32_t* p) { VecI v; memcpy(&v, p, sizeof v); return v; }
+void store(int32_t* p, VecI v) { memcpy(p, &v, sizeof v); }
+VecI shl(VecI x, int s) { return (VecI)((VecU)x << s); }
+VecI shr(VecI x, int s) { return (VecI)((VecU)x >> s); }
+VecI shlv(VecI x, VecI s) { return (VecI)((VecU)x << (VecU)(s & 31)); }
+VecI shrv(VecI x, VecI s) { return (VecI)((VecU)x >> (VecU)(s & 31)); }
+VecI srav(VecI x, VecI s) { return x >> (s & 31); }
+VecI ltu(VecI x, VecI y) { return (VecI)((VecU)x < (VecU)y) & 1; }
+#else
+constexpr uint32_t kWidth = 1;
+#endif
+
+int32_t shl(int32_t x, int s) { return (int32_t)((uint32_t)x << s); }
+int32_t shr(int32_t x, int s) { return (int32_t)((uint32_t)x >> s); }
+int32_t shlv(int32_t x, int32_t s) { return shl(x, s & 31); }
+int32_t shrv(int32_t x, int32_t s) { return shr(x, s & 31); }
+int32_t srav(int32_t x, int32_t s) { return x >> (s & 31); }
+int32_t ltu(int32_t x, int32_t y) { return (uint32_t)x < (uint32_t)y; }
+
+// d[i] = f(a[i], b[i]) over columns [lo, hi), only where m[i] is set
+// when there is a mask. f is generic so one lambda serves both the
+// vectors and the scalar tail; d may alias a or b.
+template <class F>
+void map(int32_t* d, const int32_t* a, const int32_t* b, const int32_t* m,
+         uint32_t lo, uint32_t hi, F f) {
+    uint32_t i = lo;
+    if (!m) {
+#ifdef MIPS_LANES_VECTOR
+        for (; i + kWidth <= hi; i += kWidth)
+            store(d + i, f(load(a + i), load(b + i)));
+#endif
+        for (; i < hi; ++i) d[i] = f(a[i], b[i]);
+        return;
+    }
+#ifdef MIPS_LANES_VECTOR
+    for (; i + kWidth <= hi; i += kWidth) {
+        VecI k = load(m + i);
+        store(d + i, (f(load(a + i), load(b + i)) & k) | (load(d + i) & ~k));
+    }
+#endif
+    for (; i < hi; ++i)
+        if (m[i]) d[i] = f(a[i], b[i]);
+}
+
+// Branch outcome of every member: flags[i] = -1 where taken(a[i], b[i]).
+// Returns the number taken.
+template <class P>
+uint32_t compare(int32_t* flags, const int32_t* a, const int32_t* b,
+                 const int32_t* m, uint32_t lo, uint32_t hi, P taken_if) {
+    uint32_t i = lo, taken = 0;
+#ifdef MIPS_LANES_VECTOR
+    VecI sum{};
+    for (; i + kWidth <= hi; i += kWidth) {
+        VecI t = (VecI)taken_if(load(a + i), load(b + i));
+        if (m) t &= load(m + i);
+        store(flags + i, t);
+        sum -= t;
+    }
+    for (uint32_t l = 0; l < kWidth; ++l) taken += static_cast<uint32_t>(sum[l]);
+#endif
+    for (; i < hi; ++i) {
+        bool t = taken_if(a[i], b[i]) && (!m || m[i]);
+        flags[i] = t ? -1 : 0;
+        taken += t;
+    }
+    return taken;
+}
+
+uint32_t compare(int32_t* flags, const int32_t* a, const int32_t* b,
+                 const int32_t* m, uint32_t lo, uint32_t hi, Cond cond) {
+    switch (cond) {
+        case Cond::Eq:  return compare(flags, a, b, m, lo, hi, [](auto x, auto y) { return x == y; });
+        case Cond::Ne:  return compare(flags, a, b, m, lo, hi, [](auto x, auto y) { return x != y; });
+        case Cond::Lez: return compare(flags, a, b, m, lo, hi, [](auto x, auto) { return x <= 0; });
+        case Cond::Gtz: return compare(flags, a, b, m, lo, hi, [](auto x, auto) { return x > 0; });
+        case Cond::Ltz: return compare(flags, a, b, m, lo, hi, [](auto x, auto) { return x < 0; });
+        case Cond::Gez: return compare(flags, a, b, m, lo, hi, [](auto x, auto) { return x >= 0; });
+    }
+    return 0;
+}
+
+} // namespace
+
+LockstepLanes::LockstepLanes(const MIPSPipeline& proto, size_t lanes)
+    : uops_(proto.microOps()),
+      lanes_(lanes),
+      stride_((lanes + kWidth - 1) / kWidth * kWidth) {
+    if (lanes == 0)
+        throw invalid_argument("LockstepLanes needs at least one lane");
+
+    for (const MIPSPipeline::MicroOp& u : uops_) {
+        is_used_[u.rs] = is_used_[u.rt] = is_used_[u.dest] = true;
+        if (u.c.HiLo) is_used_[kHi] = is_used_[kLo] = true;
+    }
+    is_used_[0] = false;
+    for (unsigned r = 1; r < kColumns; ++r)
+        if (is_used_[r] && r != kSink) used_.push_back(r);
+
+    regs_.assign(kColumns * stride_, 0);
+    for (unsigned r = 1; r < 32; ++r)
+        fill(col(r), col(r) + lanes_, proto.regs_[r]);
+    fill(col(kHi), col(kHi) + lanes_, proto.hi_);
+    fill(col(kLo), col(kLo) + lanes_, proto.lo_);
+    lane_of_.resize(lanes_);
+    iota(lane_of_.begin(), lane_of_.end(), 0u);
+    column_of_ = lane_of_;
+
+    mem_.reserve(lanes_);
+    for (size_t l = 0; l < lanes_; ++l) mem_.push_back(proto.mem_);
+    pc_.assign(lanes_, proto.pc());
+    state_.assign(lanes_, proto.isHalted() ? State::Halted : State::Running);
+    count_.assign(lanes_, 0);
+    flags_.assign(stride_, 0);
+    instrs_.assign(lanes_, 0);
+    error_.resize(lanes_);
+    live_.assign(lanes_, 0);
+}
+
+size_t LockstepLanes::lanes() const { return lanes_; }
+
+size_t LockstepLanes::slot(size_t lane, unsigned r) const {
+    if (r >= 32) throw out_of_range("register number out of range");
+    uint32_t c = column_of_.at(lane);
+    return is_used_[r] ? c : lane;
+}
+
+int32_t LockstepLanes::reg(size_t lane, unsigned r) const {
+    return col(r)[slot(lane, r)];
+}
+
+void LockstepLanes::setReg(size_t lane, unsigned r, int32_t value) {
+    size_t c = slot(lane, r);
+    if (r != 0) col(r)[c] = value;
+}
+
+RegFile LockstepLanes::regs(size_t lane) const {
+    RegFile out;
+    for (unsigned r = 0; r < 32; ++r) out[r] = col(r)[slot(lane, r)];
+    return out;
+}
+
+int32_t LockstepLanes::hi(size_t lane) const {
+    return col(kHi)[is_used_[kHi] ? column_of_.at(lane) : lane];
+}
+
+int32_t LockstepLanes::lo(size_t lane) const {
+    return col(kLo)[is_used_[kLo] ? column_of_.at(lane) : lane];
+}
+
+WordMemory& LockstepLanes::memory(size_t lane) { return mem_.at(lane); }
+const WordMemory& LockstepLanes::memory(size_t lane) const { return mem_.at(lane); }
+uint32_t LockstepLanes::pc(size_t lane) const { return pc_.at(lane); }
+LockstepLanes::State LockstepLanes::state(size_t lane) const { return state_.at(lane); }
+const string& LockstepLanes::error(size_t lane) const { return error_.at(lane); }
+uint64_t LockstepLanes::instructions(size_t lane) const { return instrs_.at(lane); }
+const LockstepLanes::Stats& LockstepLanes::stats() const { return stats_; }
+
+uint64_t LockstepLanes::run(uint64_t max_instrs) {
+    limit_ = max_instrs;
+    fill(count_.begin(), count_.end(), 0);
+    for (size_t l = 0; l < lanes_; ++l) live_[l] = state_[l] == State::Running;
+    regroup();
+
+    while (!groups_.empty()) {
+        // lowest PC first; it may run until it reaches the next lowest
+        size_t k = 0;
+        for (size_t i = 1; i < groups_.size(); ++i)
+            if (groups_[i].pc < groups_[k].pc) k = i;
+        uint32_t bound = UINT32_MAX;
+        size_t same = groups_.size();
+        for (size_t i = 0; i < groups_.size(); ++i) {
+            if (i == k) continue;
+            if (groups_[i].pc == groups_[k].pc) same = i;
+            else bound = min(bound, groups_[i].pc);
+        }
+        if (same != groups_.size()) {
+            merge(min(k, same), max(k, same));
+            continue;
+        }
+        // most of every vector would be masked off: compact first
+        const Group& g = groups_[k];
+        if (g.hi - g.lo >= 2 * kWidth && g.active * 8 < g.hi - g.lo) {
+            regroup();
+            continue;
+        }
+        run_group(k, bound);
+    }
+
+    uint64_t total = 0;
+    for (uint32_t c = 0; c < lanes_; ++c) {
+        instrs_[lane_of_[c]] += count_[c];
+        total += count_[c];
+    }
+    return total;
+}
+
+void LockstepLanes::run_group(size_t k, uint32_t bound) {
+    Group* g = &groups_[k];
+    for (;;) {
+        if (g->pc % 4 != 0 || g->pc / 4 >= uops_.size())
+            return finish(k, State::Exited);
+        if (g->left == 0) return stop_limited(k);
+
+        const MIPSPipeline::MicroOp& u = uops_[g->pc / 4];
+        const int32_t* m = g->mask.empty() ? nullptr : g->mask.data();
+        const uint32_t lo = g->lo, hi = g->hi;
+        int32_t* d = col(u.dest ? u.dest : kSink);
+        const int32_t* a = col(u.rs);
+        const int32_t* b = col(u.rt);
+        const int sh = u.imm & 31;
+        const int32_t imm = u.imm;
+        uint32_t next = g->pc + 4;
+        ++stats_.steps;
+        stats_.instrs += g->active;
+
+        switch (u.op) {
+            case Op::ADD:  map(d, a, b, m, lo, hi, [](auto x, auto y) { return x + y; }); break;
+            case Op::SUB:  map(d, a, b, m, lo, hi, [](auto x, auto y) { return x - y; }); break;
+            case Op::AND:  map(d, a, b, m, lo, hi, [](auto x, auto y) { return x & y; }); break;
+            case Op::OR:   map(d, a, b, m, lo, hi, [](auto x, auto y) { return x | y; }); break;
+            case Op::XOR:  map(d, a, b, m, lo, hi, [](auto x, auto y) { return x ^ y; }); break;
+            case Op::NOR:  map(d, a, b, m, lo, hi, [](auto x, auto y) { return ~(x | y); }); break;
+            case Op::MUL:  map(d, a, b, m, lo, hi, [](auto x, auto y) { return x * y; }); break;
+            case Op::SLT:
+                map(d, a, b, m, lo, hi,
+                    [](auto x, auto y) { return decltype(x)((x < y) & 1); });
+                break;
+            case Op::SLTU: map(d, a, b, m, lo, hi, [](auto x, auto y) { return ltu(x, y); }); break;
+            case Op::SLL:  map(d, b, b, m, lo, hi, [sh](auto x, auto) { return shl(x, sh); }); break;
+            case Op::SRL:  map(d, b, b, m, lo, hi, [sh](auto x, auto) { return shr(x, sh); }); break;
+            case Op::SRA:  map(d, b, b, m, lo, hi, [sh](auto x, auto) { return x >> sh; }); break;
+            case Op::SLLV: map(d, b, a, m, lo, hi, [](auto x, auto y) { return shlv(x, y); }); break;
+            case Op::SRLV: map(d, b, a, m, lo, hi, [](auto x, auto y) { return shrv(x, y); }); break;
+            case Op::SRAV: map(d, b, a, m, lo, hi, [](auto x, auto y) { return srav(x, y); }); break;
+            case Op::ADDI: map(d, a, a, m, lo, hi, [imm](auto x, auto) { return x + imm; }); break;
+            case Op::SLTI:
+                map(d, a, a, m, lo, hi,
+                    [imm](auto x, auto) { return decltype(x)((x < imm) & 1); });
+                break;
+            case Op::SLTIU:
+                map(d, a, a, m, lo, hi, [imm](auto x, auto) { return ltu(x, (x & 0) + imm); });
+                break;
+            case Op::ANDI: map(d, a, a, m, lo, hi, [imm](auto x, auto) { return x & imm; }); break;
+            case Op::ORI:  map(d, a, a, m, lo, hi, [imm](auto x, auto) { return x | imm; }); break;
+            case Op::XORI: map(d, a, a, m, lo, hi, [imm](auto x, auto) { return x ^ imm; }); break;
+            case Op::LUI:  map(d, a, a, m, lo, hi, [imm](auto x, auto) { return (x & 0) + imm; }); break;
+            case Op::MULT: case Op::MULTU: case Op::DIV: case Op::DIVU: {
+                int32_t* H = col(kHi);
+                int32_t* L = col(kLo);
+                for (uint32_t c = lo; c < hi; ++c)
+                    if (!m || m[c]) MIPSPipeline::hilo(u.op, a[c], b[c], H[c], L[c]);
+                break;
+            }
+            case Op::MFHI: map(d, col(kHi), a, m, lo, hi, [](auto x, auto) { return x; }); break;
+            case Op::MFLO: map(d, col(kLo), a, m, lo, hi, [](auto x, auto) { return x; }); break;
+            case Op::MTHI: map(col(kHi), a, a, m, lo, hi, [](auto x, auto) { return x; }); break;
+            case Op::MTLO: map(col(kLo), a, a, m, lo, hi, [](auto x, auto) { return x; }); break;
+            case Op::LB: case Op::LBU: case Op::LH: case Op::LHU: case Op::LW:
+            case Op::SB: case Op::SH: case Op::SW:
+                if (uint32_t faults = memory_op(u, *g)) {
+                    stats_.instrs -= faults;
+                    flush(*g, g->done);
+                    drop_flagged(*g, State::Faulted);
+                    if (g->active == 0) {
+                        recycle(g->mask);
+                        groups_.erase(groups_.begin() + k);
+                        return;
+                    }
+                }
+                break;
+            case Op::BEQ: case Op::BNE: case Op::BLEZ: case Op::BGTZ:
+            case Op::BLTZ: case Op::BGEZ: {
+                uint32_t taken = compare(flags_.data(), a, b, m, lo, hi, u.c.BranchCond);
+                ++g->done;
+                --g->left;
+                if (taken == g->active) {
+                    next = u.target;
+                } else if (taken != 0) {
+                    branch(k, taken, u.target);
+                    return;
+                }
+                g->pc = next;
+                if (next >= bound) return;
+                continue;
+            }
+            case Op::J:
+                next = u.target;
+                break;
+            case Op::JAL:
+                map(d, a, a, m, lo, hi, [imm](auto x, auto) { return (x & 0) + imm; });
+                next = u.target;
+                break;
+            case Op::JR: case Op::JALR: {
+                // targets are read before the link is written (rd may be rs)
+                uint32_t target = static_cast<uint32_t>(a[lo]);
+                bool same = true;
+                for (uint32_t c = lo; c < hi && same; ++c)
+                    same = (m && !m[c]) || static_cast<uint32_t>(a[c]) == target;
+                if (!same)
+                    for (uint32_t c = lo; c < hi; ++c)
+                        if (!m || m[c]) pc_[lane_of_[c]] = static_cast<uint32_t>(a[c]);
+                map(d, a, a, m, lo, hi, [imm](auto x, auto) { return (x & 0) + imm; });
+                if (!same) {
+                    ++g->done;
+                    --g->left;
+                    return scatter(k);
+                }
+                next = target;
+                break;
+            }
+            case Op::HALT:
+                ++g->done;
+                --g->left;
+                g->pc = next;
+                return finish(k, State::Halted);
+            case Op::NOP:
+                break;
+        }
+        ++g->done;
+        --g->left;
+        g->pc = next;
+        if (next >= bound) return;
+    }
+}
+
+// Loads and stores lane by lane, each in its own memory. Members whose
+// access throws are flagged in flags_ and keep their registers.
+uint32_t LockstepLanes::memory_op(const MIPSPipeline::MicroOp& u, const Group& g) {
+    int32_t* flags = flags_.data();
+    int32_t* d = col(u.dest ? u.dest : kSink);
+    const int32_t* a = col(u.rs);
+    const int32_t* b = col(u.rt);
+    uint32_t faults = 0;
+    for (uint32_t c = g.lo; c < g.hi; ++c) {
+        if (!g.mask.empty() && !g.mask[c]) continue;
+        uint32_t lane = lane_of_[c];
+        uint32_t addr = static_cast<uint32_t>(a[c] + u.imm);
+        flags[c] = 0;
+        try {
+            if (u.c.MemRead) d[c] = MIPSPipeline::load(u, mem_[lane], addr);
+            else             MIPSPipeline::store(u, mem_[lane], addr, b[c]);
+        } catch (const exception& e) {
+            flags[c] = -1;
+            error_[lane] = e.what();
+            ++faults;
+        }
+    }
+    return faults;
+}
+
+// The members of group k flagged in flags_ (`taken` of them) become a new
+// group at `target` over the same columns. Both halves share the pending
+// count, so nothing is flushed.
+void LockstepLanes::split(size_t k, uint32_t taken, uint32_t target) {
+    Group& g = groups_[k];
+    const int32_t* flags = flags_.data();
+
+    Group t;
+    t.pc = target;
+    t.lo = g.lo;
+    t.hi = g.hi;
+    t.active = taken;
+    t.done = g.done;
+    t.left = g.left;
+
+    if (g.mask.empty()) {
+        g.mask = take_mask();
+        for (uint32_t c = g.lo; c < g.hi; ++c) g.mask[c] = ~flags[c];
+    } else {
+        for (uint32_t c = g.lo; c < g.hi; ++c) g.mask[c] &= ~flags[c];
+    }
+    g.active -= taken;
+    t.mask.swap(flags_);
+    flags_ = take_mask();
+    tidy(g);
+    tidy(t);
+    ++stats_.splits;
+    groups_.push_back(move(t));
+}
+
+// A mixed branch outcome (in flags_): the taken members go to `target`,
+// the rest on to pc + 4.
+void LockstepLanes::branch(size_t k, uint32_t taken, uint32_t target) {
+    split(k, taken, target);
+    groups_[k].pc += 4;
+    // lanes that left a loop early join those already waiting after it
+    merge_into_same_pc(groups_.size() - 1);
+    merge_into_same_pc(k);
+}
+
+// A JR/JALR whose members jump to different places, their targets already
+// in pc_ (free while they are in a group): one group per target, split
+// off in turn. run() merges any that land where another group waits.
+void LockstepLanes::scatter(size_t k) {
+    for (;;) {
+        Group& g = groups_[k];
+        const int32_t* m = g.mask.empty() ? nullptr : g.mask.data();
+        uint32_t target = pc_[lane_of_[g.lo]];   // tidy() keeps g.lo a member
+        uint32_t n = 0;
+        for (uint32_t c = g.lo; c < g.hi; ++c) {
+            bool t = (!m || m[c]) && pc_[lane_of_[c]] == target;
+            flags_[c] = t ? -1 : 0;
+            n += t;
+        }
+        if (n == g.active) {
+            g.pc = target;
+            return;
+        }
+        split(k, n, target);
+    }
+}
+
+// Merges group k with another group at the same PC, if there is one.
+void LockstepLanes::merge_into_same_pc(size_t k) {
+    for (size_t i = 0; i < groups_.size(); ++i) {
+        if (i == k || groups_[i].pc != groups_[k].pc) continue;
+        merge(min(i, k), max(i, k));
+        return;
+    }
+}
+
+void LockstepLanes::drop_flagged(Group& g, State s) {
+    const int32_t* flags = flags_.data();
+    if (g.mask.empty()) {
+        g.mask = take_mask();
+        fill(g.mask.begin() + g.lo, g.mask.begin() + g.hi, -1);
+    }
+    for (uint32_t c = g.lo; c < g.hi; ++c) {
+        if (!g.mask[c] || !flags[c]) continue;
+        uint32_t lane = lane_of_[c];
+        pc_[lane] = g.pc;
+        state_[lane] = s;
+        g.mask[c] = 0;
+        --g.active;
+    }
+    tidy(g);
+}
+
+// Some member has run max_instrs: it stops where it is, still Running.
+void LockstepLanes::stop_limited(size_t k) {
+    Group& g = groups_[k];
+    flush(g, g.done);
+    int32_t* flags = flags_.data();
+    for (uint32_t c = g.lo; c < g.hi; ++c)
+        flags[c] = count_[c] >= limit_ ? -1 : 0;
+    drop_flagged(g, State::Running);
+    if (g.active == 0) {
+        recycle(g.mask);
+        groups_.erase(groups_.begin() + k);
+        return;
+    }
+    g.left = left_in(g);
+}
+
+void LockstepLanes::finish(size_t k, State s) {
+    Group& g = groups_[k];
+    flush(g, g.done);
+    for (uint32_t c = g.lo; c < g.hi; ++c) {
+        if (!g.mask.empty() && !g.mask[c]) continue;
+        pc_[lane_of_[c]] = g.pc;
+        state_[lane_of_[c]] = s;
+    }
+    recycle(g.mask);
+    groups_.erase(groups_.begin() + k);
+}
+
+// Adds n of the group's pending instructions to its members' counts.
+void LockstepLanes::flush(Group& g, uint64_t n) {
+    if (n == 0) return;
+    uint64_t* cnt = count_.data();
+    if (g.mask.empty()) {
+        for (uint32_t c = g.lo; c < g.hi; ++c) cnt[c] += n;
+    } else {
+        const int32_t* m = g.mask.data();
+        for (uint32_t c = g.lo; c < g.hi; ++c)
+            cnt[c] += n & static_cast<uint64_t>(static_cast<int64_t>(m[c]));
+    }
+    g.done -= n;
+}
+
+// Shrinks the range to the first and last member and drops a mask that
+// covers all of it.
+void LockstepLanes::tidy(Group& g) {
+    if (g.mask.empty() || g.active == 0) return;
+    while (!g.mask[g.lo]) ++g.lo;
+    while (!g.mask[g.hi - 1]) --g.hi;
+    if (g.active == g.hi - g.lo) recycle(g.mask);
+}
+
+// Merges group j into group i; both are at the same PC. Only the pending
+// count one has beyond the other needs flushing.
+void LockstepLanes::merge(size_t i, size_t j) {
+    Group& a = groups_[i];
+    Group& b = groups_[j];
+    if (a.done > b.done) flush(a, a.done - b.done);
+    else                 flush(b, b.done - a.done);
+    uint32_t lo = min(a.lo, b.lo), hi = max(a.hi, b.hi);
+    auto covers = [](const Group& x, const Group& y) {
+        return !x.mask.empty() && x.lo <= y.lo && x.hi >= y.hi;
+    };
+    auto add = [](vector<int32_t>& m, const Group& g) {
+        if (g.mask.empty())
+            fill(m.begin() + g.lo, m.begin() + g.hi, -1);
+        else
+            for (uint32_t c = g.lo; c < g.hi; ++c) m[c] |= g.mask[c];
+    };
+    if (covers(a, b)) {
+        add(a.mask, b);
+    } else if (covers(b, a)) {
+        add(b.mask, a);
+        a.mask.swap(b.mask);
+    } else if (!(a.mask.empty() && b.mask.empty() && (a.hi == b.lo || b.hi == a.lo))) {
+        vector<int32_t> m = take_mask();
+        fill(m.begin() + lo, m.begin() + hi, 0);
+        add(m, a);
+        add(m, b);
+        recycle(a.mask);
+        a.mask = move(m);
+    }
+    a.lo = lo;
+    a.hi = hi;
+    a.active += b.active;
+    a.left = min(a.left, b.left);
+    tidy(a);
+    recycle(b.mask);
+    groups_.erase(groups_.begin() + j);
+}
+
+// Permutes the columns so that live lanes come first, ordered by PC, and
+// rebuilds the groups as dense ranges. Outside run() live_ marks the lanes
+// to run; inside, the current groups define them. Only columns up to the
+// last live one move, so regrouping a shrinking set of lanes gets cheaper.
+void LockstepLanes::regroup() {
+    uint32_t span = 0;
+    if (groups_.empty()) {
+        for (uint32_t c = 0; c < lanes_; ++c)
+            if (live_[lane_of_[c]]) span = c + 1;
+    }
+    for (Group& g : groups_) {
+        flush(g, g.done);
+        for (uint32_t c = g.lo; c < g.hi; ++c) {
+            if (!g.mask.empty() && !g.mask[c]) continue;
+            live_[lane_of_[c]] = 1;
+            pc_[lane_of_[c]] = g.pc;
+        }
+        span = max(span, g.hi);
+        recycle(g.mask);
+    }
+    groups_.clear();
+
+    // counting sort by PC (one bucket per instruction plus one for PCs
+    // outside the program), stable, dead lanes last
+    const size_t n = uops_.size();
+    auto bucket = [&](uint32_t lane) -> size_t {
+        if (!live_[lane]) return n + 1;
+        uint32_t pc = pc_[lane];
+        return (pc % 4 == 0 && pc / 4 < n) ? pc / 4 : n;
+    };
+    vector<uint32_t> start(n + 3, 0);
+    for (uint32_t c = 0; c < span; ++c) ++start[bucket(lane_of_[c]) + 1];
+    partial_sum(start.begin(), start.end(), start.begin());
+    vector<uint32_t> order(span);   // new column -> old column
+    for (uint32_t c = 0; c < span; ++c) order[start[bucket(lane_of_[c])]++] = c;
+
+    bool moved = false;
+    for (uint32_t c = 0; c < span && !moved; ++c) moved = order[c] != c;
+    if (moved) {
+        vector<int32_t> tmp(span);
+        for (unsigned r : used_) {
+            int32_t* v = col(r);
+            for (uint32_t c = 0; c < span; ++c) tmp[c] = v[order[c]];
+            copy(tmp.begin(), tmp.end(), v);
+        }
+        vector<uint64_t> counts(span);
+        for (uint32_t c = 0; c < span; ++c) counts[c] = count_[order[c]];
+        copy(counts.begin(), counts.end(), count_.begin());
+        vector<uint32_t> lanes(span);
+        for (uint32_t c = 0; c < span; ++c) lanes[c] = lane_of_[order[c]];
+        copy(lanes.begin(), lanes.end(), lane_of_.begin());
+        for (uint32_t c = 0; c < span; ++c) column_of_[lane_of_[c]] = c;
+        ++stats_.regroups;
+    }
+
+    for (uint32_t c = 0; c < span && live_[lane_of_[c]];) {
+        Group g;
+        g.pc = pc_[lane_of_[c]];
+        g.lo = c;
+        while (c < span && live_[lane_of_[c]] && pc_[lane_of_[c]] == g.pc) ++c;
+        g.hi = c;
+        g.active = g.hi - g.lo;
+        g.left = left_in(g);
+        groups_.push_back(move(g));
+    }
+    for (uint32_t c = 0; c < span; ++c) live_[lane_of_[c]] = 0;
+}
+
+uint64_t LockstepLanes::left_in(const Group& g) const {
+    uint64_t most = 0;
+    for (uint32_t c = g.lo; c < g.hi; ++c)
+        if (g.mask.empty() || g.mask[c]) most = max(most, count_[c]);
+    return limit_ - most;
+}
+
+vector<int32_t> LockstepLanes::take_mask() {
+    if (spare_masks_.empty()) return vector<int32_t>(stride_);
+    vector<int32_t> m = move(spare_masks_.back());
+    spare_masks_.pop_back();
+    return m;
+}
+
+void LockstepLanes::recycle(vector<int32_t>& mask) {
+    if (mask.empty()) return;
+    spare_masks_.push_back(move(mask));
+    mask.clear();
+}
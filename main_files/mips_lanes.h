@@ -0,0 +1,150 @@
+// mips_lanes.h
+#ifndef MIPS_LANES_H
+#define MIPS_LANES_H
+
+#include "mips_pipeline.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Many instances of one program executed functionally in lockstep, for
+// input sweeps and fuzzing. Every lane starts as a copy of a prototype
+// pipeline's registers, memory (shared copy-on-write) and pc; give each
+// lane its own inputs with setReg()/memory(), then run().
+//
+// Registers are kept structure-of-arrays: one column holds a register for
+// all lanes, so an ALU instruction is a few vector operations across the
+// lanes at its PC (GCC/Clang vector extensions, which the compiler lowers
+// to SSE2, or AVX2 with -mavx2 / -march=native; plain loops elsewhere).
+//
+// Lanes at the same PC form a group: a range of columns plus a per-lane
+// mask (-1 for member lanes) once not every lane in the range belongs.
+// A conditional branch compares the whole group at once; when the outcome
+// mask is mixed the group splits into taken and not-taken groups over the
+// same columns, and each then runs under its mask. A JR/JALR whose members
+// jump to different places splits the same way, one group per target. The group with the lowest
+// PC always runs next, so lanes that went ahead wait where the paths meet
+// again (loop exits, the join after an if/else) and their groups merge
+// there. When groups at one PC cannot simply be merged, or a group's mask
+// has become sparse (lanes that halted or left a loop early), the lanes
+// are regrouped: columns are permuted so that every group is a dense,
+// unmasked range again. Loads and stores go to each lane's own WordMemory
+// one lane at a time.
+class LockstepLanes {
+public:
+    enum class State : uint8_t {
+        Running,   // not finished: stopped by run()'s limit, or not run yet
+        Halted,    // executed HALT
+        Exited,    // control left the program
+        Faulted    // a load or store threw; see error()
+    };
+
+    // `lanes` copies of proto's architectural state. proto's in-flight
+    // instructions are not included: take it between runs (fresh, or
+    // after fastForward(), which drains the pipeline). Throws
+    // std::invalid_argument for zero lanes.
+    LockstepLanes(const MIPSPipeline& proto, size_t lanes);
+
+    size_t lanes() const;
+
+    // Per-lane state; lane and register numbers are range-checked
+    // (std::out_of_range). Writes to $0 are ignored.
+    int32_t reg(size_t lane, unsigned r) const;
+    void setReg(size_t lane, unsigned r, int32_t value);
+    RegFile regs(size_t lane) const;
+    int32_t hi(size_t lane) const;
+    int32_t lo(size_t lane) const;
+    WordMemory& memory(size_t lane);
+    const WordMemory& memory(size_t lane) const;
+    // Next instruction; a faulted lane stays at the faulting one.
+    uint32_t pc(size_t lane) const;
+    State state(size_t lane) const;
+    const std::string& error(size_t lane) const;
+    uint64_t instructions(size_t lane) const;   // across all run() calls
+
+    // Runs every Running lane until it halts, leaves the program, faults
+    // or has executed max_instrs instructions in this call. Returns the
+    // number of instructions executed, summed over the lanes.
+    uint64_t run(uint64_t max_instrs = UINT64_MAX);
+
+    struct Stats {
+        uint64_t steps{0};      // instructions issued to a group
+        uint64_t instrs{0};     // lane instructions those executed
+        uint64_t splits{0};     // branches with a mixed outcome
+        uint64_t regroups{0};   // column permutations
+
+        double lanesPerStep() const {
+            return steps ? static_cast<double>(instrs) / steps : 0.0;
+        }
+    };
+    const Stats& stats() const;   // cumulative
+
+private:
+    struct Group {
+        uint32_t pc{0};
+        uint32_t lo{0}, hi{0};       // columns [lo, hi)
+        uint32_t active{0};          // member lanes
+        std::vector<int32_t> mask;   // by column; empty: all of [lo, hi)
+        uint64_t done{0};            // instructions not yet in count_
+        uint64_t left{0};            // before a member reaches the limit
+    };
+
+    // $0-$31, a sink for writes to $0, HI and LO
+    static constexpr unsigned kSink    = 32;
+    static constexpr unsigned kHi      = 33;
+    static constexpr unsigned kLo      = 34;
+    static constexpr unsigned kColumns = 35;
+
+    int32_t* col(unsigned r) { return regs_.data() + r * stride_; }
+    const int32_t* col(unsigned r) const { return regs_.data() + r * stride_; }
+    // Where lane's register r lives: its column when the program uses r,
+    // else index `lane` (never touched by run(), so never permuted).
+    // Range checks both.
+    size_t slot(size_t lane, unsigned r) const;
+
+    void run_group(size_t k, uint32_t bound);
+    uint32_t memory_op(const MIPSPipeline::MicroOp& u, const Group& g);
+    void split(size_t k, uint32_t taken, uint32_t target);
+    void branch(size_t k, uint32_t taken, uint32_t target);
+    void scatter(size_t k);
+    void drop_flagged(Group& g, State s);   // flagged members leave g
+    void stop_limited(size_t k);
+    void finish(size_t k, State s);
+    void flush(Group& g, uint64_t n);
+    void tidy(Group& g);
+    void merge(size_t i, size_t j);
+    void merge_into_same_pc(size_t k);
+    void regroup();
+    uint64_t left_in(const Group& g) const;
+    std::vector<int32_t> take_mask();
+    void recycle(std::vector<int32_t>& mask);
+
+    std::vector<MIPSPipeline::MicroOp> uops_;
+    size_t lanes_{0};
+    size_t stride_{0};                // column length, a whole number of vectors
+    std::vector<int32_t> regs_;       // kColumns columns of stride_
+    std::vector<uint32_t> lane_of_;   // column -> lane
+    std::vector<uint32_t> column_of_; // lane -> column
+    std::vector<unsigned> used_;      // registers the program names, not $0
+    bool is_used_[kColumns]{};
+    std::vector<uint64_t> count_;     // by column: instructions in this run()
+    // by column: a branch's outcome (handed over as the taken group's
+    // mask), faulting lanes, lanes at the limit
+    std::vector<int32_t> flags_;
+
+    // by lane
+    std::vector<WordMemory> mem_;
+    std::vector<uint32_t> pc_;        // valid while the lane is in no group
+    std::vector<State> state_;
+    std::vector<uint64_t> instrs_;
+    std::vector<std::string> error_;
+
+    std::vector<Group> groups_;       // during run()
+    std::vector<std::vector<int32_t>> spare_masks_;
+    std::vector<uint8_t> live_;       // by lane, scratch for regroup()
+    uint64_t limit_{0};
+    Stats stats_;
+};
+
+#endif // MIPS_LANES_H
@@ -0,0 +1,363 @@
+// mips_lexer.cpp
+// Allocation-free assembler front end: a cursor over std::string_view,
+// memory-mapped input, and a binary search on packed mnemonic characters.
+
+#include "mips_lexer.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#  define MIPS_LEXER_MMAP 1
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+using namespace std;
+
+// ---------------- input ----------------
+MappedFile::MappedFile(const string& path) {
+#ifdef MIPS_LEXER_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw runtime_error("Cannot open file " + path);
+    struct stat st{};
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ == 0) {
+            close(fd);
+            return;
+        }
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, size_, MADV_SEQUENTIAL);
+            data_   = static_cast<const char*>(p);
+            mapped_ = true;
+            close(fd);
+            return;
+        }
+    }
+    close(fd);
+#endif
+    // not mappable: read it instead
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) throw runtime_error("Cannot open file " + path);
+    char buf[1 << 16];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof buf, f)) > 0)
+        owned_.append(buf, n);
+    fclose(f);
+    data_ = owned_.data();
+    size_ = owned_.size();
+}
+
+MappedFile::MappedFile(istream& in)
+    : owned_(istreambuf_iterator<char>(in), istreambuf_iterator<char>()) {
+    data_ = owned_.data();
+    size_ = owned_.size();
+}
+
+MappedFile::~MappedFile() {
+#ifdef MIPS_LEXER_MMAP
+    if (mapped_) munmap(const_cast<char*>(data_), size_);
+#endif
+}
+
+// ---------------- lexing ----------------
+namespace {
+
+// Up to eight mnemonic characters, upper-cased, packed big-endian.
+constexpr size_t kMaxMnemonic = 8;
+
+constexpr uint64_t mnemonic(const char* s) {
+    uint64_t key = 0;
+    for (int i = 0; s[i]; ++i) key = (key << 8) | static_cast<uint8_t>(s[i]);
+    return key;
+}
+
+// Every name in kOpInfo and kOpAliases, sorted by key.
+struct Mnemonic {
+    uint64_t key;
+    Op op;
+};
+
+constexpr size_t kMnemonics = kOpCount + size(kOpAliases);
+
+constexpr array<Mnemonic, kMnemonics> make_mnemonics() {
+    array<Mnemonic, kMnemonics> t{};
+    size_t n = 0;
+    for (size_t i = 0; i < kOpCount; ++i)
+        t[n++] = {mnemonic(kOpInfo[i].name), static_cast<Op>(i)};
+    for (const OpAlias& a : kOpAliases)
+        t[n++] = {mnemonic(a.name), a.op};
+    for (size_t i = 1; i < n; ++i)
+        for (size_t j = i; j > 0 && t[j].key < t[j - 1].key; --j) {
+            Mnemonic x = t[j];
+            t[j]       = t[j - 1];
+            t[j - 1]   = x;
+        }
+    return t;
+}
+
+constexpr array<Mnemonic, kMnemonics> kMnemonicTable = make_mnemonics();
+
+constexpr bool unique_mnemonics() {
+    for (size_t i = 1; i < kMnemonics; ++i)
+        if (kMnemonicTable[i].key == kMnemonicTable[i - 1].key) return false;
+    return true;
+}
+static_assert(unique_mnemonics(), "two ops share a mnemonic");
+
+struct Cursor {
+    const char* p;
+    const char* end;
+
+    static bool space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    void skip_space() {
+        while (p < end && space(*p)) ++p;
+    }
+    // Operands may be separated by commas, whitespace or both.
+    void skip_sep() {
+        skip_space();
+        if (p < end && *p == ',') ++p;
+        skip_space();
+    }
+    bool at_end() {
+        skip_space();
+        return p == end || *p == '#';
+    }
+
+    // decimal, or hex after 0x; false if there is none or it needs more
+    // than 32 bits
+    bool unsigned_int(uint32_t& v) {
+        uint64_t x = 0;
+        bool fits = true;
+        if (end - p > 2 && p[0] == '0' && (p[1] | 0x20) == 'x' && hex_digit(p[2]) >= 0) {
+            p += 2;
+            for (int d; p < end && (d = hex_digit(*p)) >= 0; ++p) {
+                x = (x << 4) | static_cast<uint32_t>(d);
+                fits = fits && x <= UINT32_MAX;
+            }
+        } else {
+            const char* start = p;
+            while (p < end && *p >= '0' && *p <= '9') {
+                x = x * 10 + static_cast<uint32_t>(*p++ - '0');
+                fits = fits && x <= UINT32_MAX;
+            }
+            if (p == start) return false;
+        }
+        v = static_cast<uint32_t>(x);
+        return fits;
+    }
+    static int hex_digit(char ch) {
+        if (ch >= '0' && ch <= '9') return ch - '0';
+        if ((ch | 0x20) >= 'a' && (ch | 0x20) <= 'f') return (ch | 0x20) - 'a' + 10;
+        return -1;
+    }
+    // optional sign, then unsigned_int(): -(2^32 - 1) .. 2^32 - 1
+    bool number(int64_t& v) {
+        skip_space();
+        bool neg = false;
+        if (p < end && (*p == '-' || *p == '+')) neg = (*p++ == '-');
+        uint32_t u;
+        if (!unsigned_int(u)) return false;
+        v = neg ? -int64_t(u) : int64_t(u);
+        return true;
+    }
+    // $N with N in 0..31; the '$' is optional
+    bool reg(uint8_t& r) {
+        skip_space();
+        if (p < end && *p == '$') ++p;
+        uint32_t v;
+        if (!unsigned_int(v) || v > 31) return false;
+        r = static_cast<uint8_t>(v);
+        return true;
+    }
+    // [A-Za-z_][A-Za-z0-9_.]*; empty if there is none here
+    string_view ident() {
+        skip_space();
+        const char* start = p;
+        if (p < end && isIdentStart(*p))
+            while (p < end && isIdentChar(*p)) ++p;
+        return {start, static_cast<size_t>(p - start)};
+    }
+    // a number, or a label left for the assembler to resolve
+    bool imm_or_label(int64_t& v, string_view& label) {
+        skip_space();
+        if (p < end && isIdentStart(*p)) {
+            label = ident();
+            return true;
+        }
+        return number(v);
+    }
+    // offset($base), offset or ($base); the offset may be a label and a
+    // missing base means $0
+    bool mem_operand(int64_t& off, uint8_t& base, string_view& label) {
+        skip_space();
+        off  = 0;
+        base = 0;
+        bool has_off = false;
+        if (p < end && *p != '(') {
+            if (!imm_or_label(off, label)) return false;
+            has_off = true;
+        }
+        skip_space();
+        if (p == end || *p != '(') return has_off;
+        ++p;
+        if (!reg(base)) return false;
+        skip_space();
+        if (p == end || *p != ')') return false;
+        ++p;
+        return true;
+    }
+    string_view word() {
+        skip_space();
+        const char* start = p;
+        while (p < end && !space(*p) && *p != ',' && *p != '#') ++p;
+        return {start, static_cast<size_t>(p - start)};
+    }
+    static bool isIdentStart(char ch) {
+        return ((ch | 0x20) >= 'a' && (ch | 0x20) <= 'z') || ch == '_';
+    }
+    static bool isIdentChar(char ch) {
+        return isIdentStart(ch) || (ch >= '0' && ch <= '9') || ch == '.';
+    }
+};
+
+// `line` without its comment and surrounding spaces, for error messages.
+string statement(string_view line) {
+    line = line.substr(0, line.find('#'));
+    size_t b = 0, e = line.size();
+    while (b < e && Cursor::space(line[b])) ++b;
+    while (e > b && Cursor::space(line[e - 1])) --e;
+    return string(line.substr(b, e - b));
+}
+
+} // namespace
+
+bool parseLine(string_view line, Instruction& out, string_view* label_out) {
+    out = Instruction{};
+    string_view label;
+    Cursor c{line.data(), line.data() + line.size()};
+    if (c.at_end())
+        return c.p != c.end;   // '#' comment: kept as a NOP
+
+    // mnemonic: letters only, at most eight of them
+    const char* m = c.p;
+    uint64_t key = 0;
+    while (c.p < c.end && ((*c.p | 0x20) >= 'a' && (*c.p | 0x20) <= 'z')) {
+        key = (key << 8) | static_cast<uint8_t>(*c.p & ~0x20);
+        ++c.p;
+    }
+    size_t mlen = static_cast<size_t>(c.p - m);
+    if (mlen == 0 || mlen > kMaxMnemonic ||
+        !(c.p == c.end || Cursor::space(*c.p) || *c.p == '#')) {
+        c.p = m;
+        throw runtime_error("unknown instruction '" + string(c.word()) + "'");
+    }
+
+    auto it = lower_bound(kMnemonicTable.begin(), kMnemonicTable.end(), key,
+                          [](const Mnemonic& e, uint64_t k) { return e.key < k; });
+    if (it == kMnemonicTable.end() || it->key != key)
+        throw runtime_error("unknown instruction '" + string(m, mlen) + "'");
+    out.op = it->op;
+
+    auto sep = [&c] { c.skip_sep(); return true; };
+    // immediates must fit the field they are encoded in; labels are
+    // checked by the assembler once resolved
+    const OpInfo& info = opInfo(out.op);
+    const bool zero_ext = info.imm == ImmKind::Zero || info.imm == ImmKind::Upper;
+    int64_t n = 0, lo = zero_ext ? 0 : -32768, hi = zero_ext ? 0xFFFF : 32767;
+    bool ok = true;
+    switch (info.format) {
+        case Format::None:
+            break;
+        case Format::RdRsRt:
+            ok = c.reg(out.rd) && sep() && c.reg(out.rs) && sep() && c.reg(out.rt);
+            break;
+        case Format::RdRtShamt:
+            ok = c.reg(out.rd) && sep() && c.reg(out.rt) && sep() && c.number(n);
+            lo = 0;
+            hi = 31;
+            break;
+        case Format::RdRtRs:
+            ok = c.reg(out.rd) && sep() && c.reg(out.rt) && sep() && c.reg(out.rs);
+            break;
+        case Format::RtRsImm:
+            ok = c.reg(out.rt) && sep() && c.reg(out.rs) && sep() &&
+                 c.imm_or_label(n, label);
+            break;
+        case Format::RtImm:
+            ok = c.reg(out.rt) && sep() && c.imm_or_label(n, label);
+            break;
+        case Format::RtMem:
+            ok = c.reg(out.rt) && sep() && c.mem_operand(n, out.rs, label);
+            break;
+        case Format::RsRtLabel:
+            // numeric word offset, or a label
+            ok = c.reg(out.rs) && sep() && c.reg(out.rt) && sep() &&
+                 c.imm_or_label(n, label);
+            break;
+        case Format::RsLabel:
+            ok = c.reg(out.rs) && sep() && c.imm_or_label(n, label);
+            break;
+        case Format::Target:
+            // numeric word index, or a label
+            ok = c.imm_or_label(n, label);
+            lo = 0;
+            hi = 0x03FFFFFF;
+            break;
+        case Format::Rs:
+            ok = c.reg(out.rs);
+            break;
+        case Format::RdRs:
+            // JALR rs links through $31
+            ok = c.reg(out.rs);
+            out.rd = 31;
+            if (ok && !c.at_end()) {
+                out.rd = out.rs;
+                ok = sep() && c.reg(out.rs);
+            }
+            break;
+        case Format::Rd:
+            ok = c.reg(out.rd);
+            break;
+        case Format::RsRt:
+            ok = c.reg(out.rs) && sep() && c.reg(out.rt);
+            break;
+    }
+
+    if (!ok || !c.at_end())
+        throw runtime_error("malformed operands in '" + statement(line) + "'");
+    if (n < lo || n > hi)
+        throw runtime_error("operand out of range in '" + statement(line) + "'");
+    switch (info.format) {
+        case Format::RdRtShamt: out.shamt = static_cast<uint8_t>(n); break;
+        case Format::Target:    out.addr  = static_cast<uint32_t>(n); break;
+        default:                out.imm   = static_cast<int32_t>(n); break;
+    }
+    if (label_out) *label_out = label;
+    return true;
+}
+
+bool parseNumber(string_view s, int64_t& v) {
+    Cursor c{s.data(), s.data() + s.size()};
+    return c.number(v) && (c.skip_space(), c.p == c.end);
+}
+
+string_view takeLabelDef(string_view& line) {
+    Cursor c{line.data(), line.data() + line.size()};
+    string_view name = c.ident();
+    if (name.empty()) return {};
+    c.skip_space();
+    if (c.p == c.end || *c.p != ':') return {};
+    ++c.p;
+    line = string_view(c.p, static_cast<size_t>(c.end - c.p));
+    return name;
+}
@@ -0,0 +1,57 @@
+// mips_lexer.h
+#ifndef MIPS_LEXER_H
+#define MIPS_LEXER_H
+
+#include "mips_ir.hpp"
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <string_view>
+
+// Read-only view of a whole source file. Regular files are memory-mapped;
+// anything mmap cannot handle (pipes, or a platform without mmap) is read
+// into an owned buffer instead. Throws std::runtime_error if the file
+// cannot be opened.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    // Slurps a stream (stdin) into the owned buffer.
+    explicit MappedFile(std::istream& in);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view text() const { return {data_, size_}; }
+
+private:
+    const char* data_{nullptr};
+    size_t size_{0};
+    bool mapped_{false};
+    std::string owned_;
+};
+
+// Parses one source line (without its newline) in place: no substrings,
+// streams or per-line allocation. Mnemonics (kOpInfo names and aliases)
+// are matched case-insensitively by binary search on their packed
+// characters, and operands are read as the op's Format says; only a
+// comment may follow them. Numeric immediates must fit 16 bits (unsigned
+// for ANDI/ORI/XORI/LUI, signed otherwise), shift amounts 0..31 and jump
+// targets 26 bits. Returns false for blank lines; comment-only lines come
+// back as NOP. Throws std::runtime_error for an unknown mnemonic, malformed
+// operands or an out-of-range number. A label operand
+// (branch or jump target, immediate or load/store offset) is handed back
+// through `label_out` as a view into `line`, with the field it stands for
+// left 0.
+bool parseLine(std::string_view line, Instruction& out,
+               std::string_view* label_out = nullptr);
+
+// Reads all of `s` (surrounding spaces aside) as an integer: an optional
+// sign, then decimal or 0x hex of at most 32 bits. The syntax numeric
+// operands use; false for anything else.
+bool parseNumber(std::string_view s, int64_t& v);
+
+// If `line` starts with a label definition ("name:"), returns the name and
+// advances `line` past the colon; otherwise returns an empty view.
+std::string_view takeLabelDef(std::string_view& line);
+
+#endif // MIPS_LEXER_H
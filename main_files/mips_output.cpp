@@ -1,71 +1,75 @@
 // mips_output.cpp
 #include "mips_output.h"
-#include "mips_pipeline.h"  
+#include "mips_pipeline.h"
+#include <algorithm>
+#include <charconv>
+#include <string_view>
 
-OutputManager::OutputManager() = default;
+namespace {
+
+constexpr uint32_t kRowWords = 4;   // words per memory dump row
+
+// Lines are built in a char array by the put* helpers, which return the
+// new end, and appended to the buffer whole.
+char* putPadded(char* p, std::string_view v, size_t width) {
+    p = std::copy(v.begin(), v.end(), p);
+    for (size_t i = v.size(); i < width; ++i) *p++ = ' ';
+    return p;
+}
+
+char* putDec(char* p, int32_t v, size_t width) {
+    char tmp[12];
+    auto r = std::to_chars(tmp, tmp + sizeof tmp, v);
+    return putPadded(p, std::string_view(tmp, r.ptr - tmp), width);
+}
+
+// zero-padded to 8 digits
+char* putHex8(char* p, uint32_t v) {
+    std::fill(p, p + 8, '0');
+    char tmp[8];
+    auto r = std::to_chars(tmp, tmp + sizeof tmp, v, 16);
+    return std::copy(tmp, r.ptr, p + 8 - (r.ptr - tmp));
+}
+
+} // namespace
+
+OutputManager::OutputManager(std::ostream& os) : os(os) {
+    buf.reserve(8192);   // a full final state fits
+}
 OutputManager::~OutputManager() = default;
 
 void OutputManager::enableDebugMode(bool debug) {
     debugMode = debug;
-    std::cout << (debug ? "Debug mode: ENABLED\n\n" : "Debug mode: DISABLED\n\n");
+    buf += debug ? "Debug mode: ENABLED\n\n" : "Debug mode: DISABLED\n\n";
+    flush();
 }
 
-void OutputManager::printFinalRegisters(const std::array<int32_t, 32>& regs) const {
-    printHeader("FINAL REGISTER FILE");
-
-    // Header printed ONCE
-    std::cout << std::left << std::setw(8) << "Reg"
-              << std::setw(8) << "Name"
-              << std::setw(12) << "Decimal"
-              << std::setw(12) << "Hex" << std::endl;
-
-    for (int i = 0; i < 32; i += 4) {
-        printRegisterRow(i, std::min(i + 3, 31), regs);
-    }
-    printSeparator();
-}
-
-void OutputManager::printRegisterRow(int start, int end,
-                                    const std::array<int32_t, 32>& regs) const {
-    for (int i = start; i <= end; ++i) {
-        int32_t val = regs[i];
-        std::cout << std::left << std::setw(8) << ("$" + std::to_string(i))
-                  << std::setw(8) << FULL_REG_NAMES[i]
-                  << std::setw(12) << val
-                  << "0x" << std::hex << std::setw(8) << std::setfill('0')
-                  << static_cast<uint32_t>(val) << std::dec << std::setfill(' ')
-                  << std::endl;
-    }
-    std::cout << std::endl;
+void OutputManager::setChangedOnly(bool on) {
+    changedOnly = on;
 }
 
-void OutputManager::printFinalMemory(const WordMemory& mem) const {
-    printHeader("FINAL MEMORY CONTENTS");
-    std::cout << "Memory (showing first 256 bytes, address 0x00000000 - 0x000000FF):\n";
-    printMemoryBlock(0, 256, mem);
+void OutputManager::setBaseline(const std::array<int32_t, 32>& regs,
+                                const WordMemory& mem) {
+    baseRegs = regs;
+    baseMem  = std::make_unique<const WordMemory>(mem);
 }
 
-void OutputManager::printMemoryBlock(uint32_t startAddr, int bytes,
-                                    const WordMemory& mem) const {
-    std::cout << std::hex << std::setfill('0');
-    for (int i = 0; i < bytes; i += 16) {
-        uint32_t addr = startAddr + i;
-        std::cout << "0x" << std::setw(8) << addr << ": ";
+void OutputManager::printFinalRegisters(const std::array<int32_t, 32>& regs) const {
+    addRegisters(regs);
+    flush();
+}
 
-        for (int j = 0; j < 4 && (i + j * 4) < bytes; ++j) {
-            int32_t word = mem.load_word(addr + j * 4);
-            std::cout << std::setw(8) << static_cast<uint32_t>(word) << " ";
-        }
-        std::cout << std::endl;
-    }
-    std::cout << std::dec << std::setfill(' ') << std::endl;
+void OutputManager::printFinalMemory(const WordMemory& mem) const {
+    addMemory(mem);
+    flush();
 }
 
 void OutputManager::printFinalState(const std::array<int32_t, 32>& regs,
                                    const WordMemory& mem) const {
-    printFinalRegisters(regs);
-    std::cout << std::endl;
-    printFinalMemory(mem);
+    addRegisters(regs);
+    buf += '\n';
+    addMemory(mem);
+    flush();
 }
 
 void OutputManager::printInstructionDebug(const std::string& instruction,
@@ -73,18 +77,151 @@ void OutputManager::printInstructionDebug(const std::string& instruction,
                                           const std::array<int32_t, 32>& regs,
                                           int cycle) const {
     if (!debugMode) return;
-    printSeparator();
-    std::cout << "\n=== CYCLE " << cycle << " ===\n";
-    std::cout << "PC: 0x" << std::hex << pc << std::dec
-              << "   Instruction: " << instruction << "\n\n";
-    printRegisterRow(0, 15, regs);
+    addSeparator();
+    char tmp[12];
+    auto r = std::to_chars(tmp, tmp + sizeof tmp, cycle);
+    buf += "\n=== CYCLE ";
+    buf.append(tmp, r.ptr);
+    buf += " ===\nPC: 0x";
+    r = std::to_chars(tmp, tmp + sizeof tmp, pc, 16);
+    buf.append(tmp, r.ptr);
+    buf += "   Instruction: ";
+    buf += instruction;
+    buf += "\n\n";
+    addRegisterRow(0, 15, regs);
+    flush();
+}
+
+void OutputManager::addRegisters(const std::array<int32_t, 32>& regs) const {
+    addHeader("FINAL REGISTER FILE");
+
+    // Header printed ONCE
+    buf += "Reg     Name    Decimal     Hex         \n";
+
+    if (changedOnly) {
+        bool any = false;
+        for (int i = 0; i < 32; ++i)
+            if (regs[i] != baseRegs[i]) {
+                addRegister(i, regs[i]);
+                any = true;
+            }
+        buf += any ? "\n" : "(none changed)\n\n";
+    } else {
+        for (int i = 0; i < 32; i += 4)
+            addRegisterRow(i, std::min(i + 3, 31), regs);
+    }
+    addSeparator();
+}
+
+void OutputManager::addRegister(int i, int32_t val) const {
+    char line[48];
+    char name[4] = {'$'};
+    auto r = std::to_chars(name + 1, name + sizeof name, i);
+    char* p = putPadded(line, std::string_view(name, r.ptr - name), 8);
+    p = putPadded(p, FULL_REG_NAMES[i], 8);
+    p = putDec(p, val, 12);
+    *p++ = '0';
+    *p++ = 'x';
+    p = putHex8(p, static_cast<uint32_t>(val));
+    *p++ = '\n';
+    buf.append(line, p);
+}
+
+void OutputManager::addRegisterRow(int start, int end,
+                                   const std::array<int32_t, 32>& regs) const {
+    for (int i = start; i <= end; ++i)
+        addRegister(i, regs[i]);
+    buf += '\n';
+}
+
+void OutputManager::addMemory(const WordMemory& mem) const {
+    addHeader("FINAL MEMORY CONTENTS");
+    if (changedOnly) {
+        addChangedMemory(mem);
+    } else {
+        buf += "Memory (showing first 256 bytes, address 0x00000000 - 0x000000FF):\n";
+        addMemoryBlock(0, 256, mem);
+    }
+}
+
+void OutputManager::addMemoryRow(uint32_t addr, const int32_t* words) const {
+    char line[16 + kRowWords * 9];
+    char* p = line;
+    *p++ = '0';
+    *p++ = 'x';
+    p = putHex8(p, addr);
+    *p++ = ':';
+    *p++ = ' ';
+    for (uint32_t j = 0; j < kRowWords; ++j) {
+        p = putHex8(p, static_cast<uint32_t>(words[j]));
+        *p++ = ' ';
+    }
+    *p++ = '\n';
+    buf.append(line, p);
+}
+
+void OutputManager::addMemoryBlock(uint32_t startAddr, int bytes,
+                                   const WordMemory& mem) const {
+    int32_t words[256 / 4];
+    size_t n = std::min<size_t>(bytes / 4, sizeof words / sizeof words[0]);
+    n = std::min(n, mem.words() - std::min<size_t>(mem.words(), startAddr / 4));
+    n -= n % kRowWords;
+    mem.read_words(startAddr, words, n);
+    for (size_t i = 0; i < n; i += kRowWords)
+        addMemoryRow(startAddr + static_cast<uint32_t>(i * 4), words + i);
+    buf += '\n';
+}
+
+// Only pages that were ever stored to (or, with a baseline, that no longer
+// share the baseline's copy) are looked at, so the cost follows what the
+// program touched, not the size of memory.
+void OutputManager::addChangedMemory(const WordMemory& mem) const {
+    static const int32_t kZero[WordMemory::kPageWords] = {};
+    int32_t base[WordMemory::kPageWords];
+    size_t rows = 0;
+    auto scan = [&](uint32_t addr, const int32_t* words) {
+        // the last page can be partial
+        uint32_t n = static_cast<uint32_t>(
+            std::min<size_t>(WordMemory::kPageWords, mem.words() - addr / 4));
+        const int32_t* before = kZero;
+        if (baseMem) {
+            baseMem->read_words(addr, base, n);
+            before = base;
+        }
+        if (!words) words = kZero;
+        for (uint32_t i = 0; i + kRowWords <= n; i += kRowWords)
+            if (!std::equal(words + i, words + i + kRowWords, before + i)) {
+                addMemoryRow(addr + i * 4, words + i);
+                ++rows;
+            }
+    };
+
+    if (baseMem) {
+        buf += "Memory (16-byte rows that differ from the initial contents):\n";
+        mem.for_each_changed_page(*baseMem, scan);
+    } else {
+        buf += "Memory (non-zero 16-byte rows):\n";
+        mem.for_each_page(scan);
+    }
+    buf += rows ? "\n" : "(none)\n\n";
+}
+
+void OutputManager::addHeader(const char* title) const {
+    buf += '\n';
+    buf.append(60, '=');
+    buf += "\n ";
+    buf += title;
+    buf += '\n';
+    buf.append(60, '=');
+    buf += '\n';
 }
 
-void OutputManager::printHeader(const std::string& title) const {
-    std::cout << "\n" << std::string(60, '=') << "\n " << title << "\n"
-              << std::string(60, '=') << "\n";
+void OutputManager::addSeparator() const {
+    buf.append(80, '-');
+    buf += '\n';
 }
 
-void OutputManager::printSeparator() const {
-    std::cout << std::string(80, '-') << std::endl;
+void OutputManager::flush() const {
+    os.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+    buf.clear();
 }
@@ -5,26 +5,39 @@
 #include <vector>
 #include <string>
 #include <array>
+#include <memory>
 #include <iostream>
 #include <iomanip>
 #include <cstdint>
 
-class WordMemory;  
+class WordMemory;
 
+// Every print call formats into one reusable buffer (std::to_chars, no
+// stream state) and hands it to the stream in a single write.
 class OutputManager {
 public:
-    OutputManager();
+    explicit OutputManager(std::ostream& os = std::cout);
     ~OutputManager();
 
     void enableDebugMode(bool debug = true);
 
+    // Changed-only mode: the final state lists only the registers and the
+    // 16-byte memory rows that differ from the baseline, over the whole
+    // memory rather than its first 256 bytes. Without a baseline, those
+    // that are non-zero.
+    void setChangedOnly(bool on = true);
+    // Keeps a copy of regs and mem to compare against. The copy shares
+    // mem's pages copy-on-write, so it is cheap to take, and only pages
+    // stored to since are compared at the end.
+    void setBaseline(const std::array<int32_t, 32>& regs, const WordMemory& mem);
+
     // Current real types
     void printFinalRegisters(const std::array<int32_t, 32>& regs) const;
     void printFinalMemory(const WordMemory& mem) const;
     void printFinalState(const std::array<int32_t, 32>& regs,
                          const WordMemory& mem) const;
 
-    // Simple debug per cycle 
+    // Simple debug per cycle
     void printInstructionDebug(
         const std::string& instruction,
         uint32_t pc,
@@ -32,7 +45,12 @@ public:
         int cycle) const;
 
 private:
-    bool debugMode;
+    std::ostream& os;
+    bool debugMode{false};
+    bool changedOnly{false};
+    std::array<int32_t, 32> baseRegs{};
+    std::unique_ptr<const WordMemory> baseMem;   // null: compare with zero
+    mutable std::string buf;
 
     static constexpr const char* FULL_REG_NAMES[32] = {
         "zero", "at", "v0", "v1", "a0", "a1", "a2", "a3",
@@ -41,14 +59,17 @@ private:
         "t8", "t9", "k0", "k1", "gp", "sp", "fp", "ra"
     };
 
-    void printHeader(const std::string& title) const;
-    void printSeparator() const;
-    void printRegisterRow(int start, int end, const std::array<int32_t, 32>& regs) const;
-    void printMemoryBlock(uint32_t startAddr, int words, const WordMemory& mem) const;
+    // append to buf; flush() writes it out and empties it
+    void addHeader(const char* title) const;
+    void addSeparator() const;
+    void addRegister(int i, int32_t val) const;
+    void addRegisterRow(int start, int end, const std::array<int32_t, 32>& regs) const;
+    void addRegisters(const std::array<int32_t, 32>& regs) const;
+    void addMemoryRow(uint32_t addr, const int32_t* words) const;
+    void addMemoryBlock(uint32_t startAddr, int bytes, const WordMemory& mem) const;
+    void addChangedMemory(const WordMemory& mem) const;
+    void addMemory(const WordMemory& mem) const;
+    void flush() const;
 };
 
 #endif
-
-
-
-
@@ -0,0 +1,327 @@
+// mips_parallel.cpp
+// Stage threads: the 5-stage pipeline of mips_pipeline.cpp with MEM on a
+// thread of its own (MIPSPipeline::setStageThreads).
+//
+// Every stage reads only the latches committed at the end of the previous
+// cycle, but two things flow within a cycle: WB's register write is what
+// ID reads, and MEM's branch resolution decides what IF fetches. So WB,
+// EX, ID and IF stay together on the calling thread (the front end), and
+// MEM keeps its branch resolution there too - it needs nothing but the
+// EX/MEM latch, and the predictor then has a single user. What moves is
+// the rest of MEM: the load or store itself and the data side of the
+// cache model, the part that gets expensive.
+//
+// MEM of cycle c needs EX/MEM from the end of cycle c - 1, and its MEM/WB
+// is first read by WB and the forwarding paths in cycle c + 1, so the
+// memory thread runs MEM(c) while the front end runs the rest of cycle c:
+//
+//   front end   | WB EX ID IF (c) | WB EX ID IF (c+1) | ...
+//   memory      |     MEM (c)     |     MEM (c+1)     | ...
+//
+// Each cycle the front end pushes its new EX/MEM to the memory thread and
+// pops MEM/WB back; the pop is the cycle barrier. Both rings are
+// single-producer single-consumer and lock-free.
+//
+// The two L1s are private to their threads, but the L2 behind them is
+// shared, and the order of its accesses decides its contents. An L1I miss
+// is therefore filled by the memory thread, after the MEM of the same
+// cycle and before the next one, exactly where the serial loop has it.
+// The freeze of a cycle (the slower of its fetch and data access) is also
+// only known there, so the memory thread keeps the count of frozen cycles
+// and the front end adds it up at the end.
+
+#include "mips_pipeline.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Spins for a while, then yields, so two threads sharing one core still
+// make progress.
+template <class Ready>
+void wait_until(Ready ready) {
+    constexpr unsigned kSpins = 256;
+    for (unsigned spins = 0; !ready(); ++spins) {
+        if (spins >= kSpins) {
+            this_thread::yield();
+            continue;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#endif
+    }
+}
+
+// Bounded single-producer single-consumer queue of N (a power of two)
+// trivially copyable slots. push() waits while it is full, pop() while it
+// is empty. Each side caches the other's index and only rereads it when
+// the cached one says it has to wait.
+template <class T, size_t N>
+class SpscRing {
+    static_assert((N & (N - 1)) == 0, "ring size must be a power of two");
+
+public:
+    void push(const T& v) {
+        size_t t = tail_.load(memory_order_relaxed);
+        if (t - head_cache_ == N)
+            wait_until([&] {
+                head_cache_ = head_.load(memory_order_acquire);
+                return t - head_cache_ < N;
+            });
+        slots_[t & (N - 1)] = v;
+        tail_.store(t + 1, memory_order_release);
+    }
+
+    T pop() {
+        size_t h = head_.load(memory_order_relaxed);
+        if (h == tail_cache_)
+            wait_until([&] {
+                tail_cache_ = tail_.load(memory_order_acquire);
+                return h != tail_cache_;
+            });
+        T v = slots_[h & (N - 1)];
+        head_.store(h + 1, memory_order_release);
+        return v;
+    }
+
+private:
+    // producer side
+    alignas(64) atomic<size_t> tail_{0};
+    size_t head_cache_{0};
+    // consumer side
+    alignas(64) atomic<size_t> head_{0};
+    size_t tail_cache_{0};
+    alignas(64) T slots_[N];
+};
+
+} // namespace
+
+// The front end below mirrors step_cycle<CountNothing>() stage for stage;
+// a change to one belongs in the other.
+void MIPSPipeline::run_stage_threads(uint64_t max_cycles) {
+    if (halted_ || cycles_ >= max_cycles) return;
+
+    // front end -> memory thread, one per cycle
+    struct ToMem {
+        EX_MEM ex_mem;            // MEM's input in the next cycle
+        uint32_t fetch_pc{0};
+        uint32_t fetch_stall{0};  // the L1I's part of this cycle's fetch
+        bool fetch_miss{false};   // ... plus a fill from below
+        bool last{false};         // finish this cycle, then stop
+    };
+    // memory thread -> front end
+    struct FromMem {
+        MEM_WB mem_wb;
+        uint64_t frozen{0};       // freeze cycles up to the previous cycle
+        bool fault{false};
+    };
+
+    SpscRing<ToMem, 4> to_mem;
+    SpscRing<FromMem, 4> from_mem;
+    uint64_t frozen_total = 0;    // written by the memory thread before exit
+    exception_ptr fault;
+
+    ToMem first;
+    first.ex_mem = ex_mem_;
+    to_mem.push(first);
+
+    thread mem_stage([&, wb = mem_wb_]() mutable {
+        uint64_t frozen    = 0;
+        uint32_t mem_stall = 0;
+        for (;;) {
+            ToMem in = to_mem.pop();
+            // the previous cycle's fetch goes below its L1I after its MEM
+            uint32_t freeze = in.fetch_stall;
+            if (in.fetch_miss) freeze += caches_.fetchFill(in.fetch_pc);
+            freeze = max(freeze, mem_stall);
+            if (freeze) {
+                caches_.addStall(freeze);
+                frozen += freeze;
+            }
+            if (in.last) break;
+
+            // ===== MEM =====
+            const EX_MEM& em   = in.ex_mem;
+            const MicroOp& mem = em.valid ? uops_[em.pc / 4] : kBubble;
+            // a HALT retiring in WB this cycle keeps younger ones off memory
+            bool halted = wb.valid && uops_[wb.pc / 4].op == Op::HALT;
+
+            MEM_WB out{};
+            out.pc      = em.pc;
+            out.valid   = em.valid;
+            out.dest    = em.dest;
+            out.alu_out = em.alu_out;
+            mem_stall   = 0;
+            if (em.valid && !mem.c.isNOP && !halted) {
+                uint32_t addr = (uint32_t)em.alu_out;
+                try {
+                    if (mem.c.MemRead)
+                        out.mem_data = load(mem, mem_, addr);
+                    if (mem.c.MemWrite)
+                        store(mem, mem_, addr, em.rt_val_forwarded);
+                } catch (...) {
+                    fault = current_exception();
+                    from_mem.push({out, frozen, true});
+                    break;
+                }
+                if (caches_.enabled() && (mem.c.MemRead || mem.c.MemWrite))
+                    mem_stall = mem.c.MemWrite ? caches_.store(addr)
+                                               : caches_.load(addr);
+            }
+            wb = out;
+            from_mem.push({out, frozen, false});
+        }
+        frozen_total = frozen;
+    });
+
+    uint64_t frozen = 0;   // as far as the memory thread has reported
+    for (;;) {
+        cycles_++;
+
+        const MicroOp& wb  = mem_wb_.valid ? uops_[mem_wb_.pc / 4] : kBubble;
+        const MicroOp& mem = ex_mem_.valid ? uops_[ex_mem_.pc / 4] : kBubble;
+        const MicroOp& ex  = id_ex_.valid  ? uops_[id_ex_.pc / 4]  : kBubble;
+
+        // ===== WB =====
+        if (mem_wb_.valid && !wb.c.isNOP && wb.c.RegWrite && mem_wb_.dest != 0)
+            regs_[mem_wb_.dest] = wb.c.MemToReg ? mem_wb_.mem_data
+                                                : mem_wb_.alu_out;
+        if (mem_wb_.valid && wb.op == Op::HALT)
+            halted_ = true;
+
+        // ===== MEM: branch resolution =====
+        bool     flush_if_id = false;
+        uint32_t redirect_pc = pc_;
+        if (ex_mem_.valid && (mem.c.Branch || mem.c.Jump)) {
+            bool taken = mem.c.Jump || ex_mem_.branch_taken;
+            if (bp_.resolve(ex_mem_.pc, mem.c.Jump, taken, ex_mem_.pred_taken)) {
+                redirect_pc = !taken         ? ex_mem_.pc + 4
+                              : mem.c.Indirect ? (uint32_t)ex_mem_.rt_val_forwarded
+                                               : mem.target;
+                flush_if_id = true;
+            }
+        }
+
+        // ===== EX =====
+        EX_MEM new_ex_mem{};
+        new_ex_mem.pc         = id_ex_.pc;
+        new_ex_mem.valid      = id_ex_.valid;
+        new_ex_mem.pred_taken = id_ex_.pred_taken;
+        new_ex_mem.dest       = ex.dest;
+
+        int32_t fwdA = id_ex_.rs_val;
+        int32_t fwdB = id_ex_.rt_val;
+        if (mem_wb_.valid && wb.c.RegWrite && mem_wb_.dest != 0) {
+            int32_t wb_val = wb.c.MemToReg ? mem_wb_.mem_data : mem_wb_.alu_out;
+            if (mem_wb_.dest == ex.rs) fwdA = wb_val;
+            if (mem_wb_.dest == ex.rt) fwdB = wb_val;
+        }
+        if (ex_mem_.valid && mem.c.RegWrite && ex_mem_.dest != 0) {
+            if (ex_mem_.dest == ex.rs) fwdA = ex_mem_.alu_out;
+            if (ex_mem_.dest == ex.rt) fwdB = ex_mem_.alu_out;
+        }
+
+        if (id_ex_.valid && !ex.c.isNOP) {
+            if (ex.c.HiLo) {
+                int32_t hi = hi_, lo = lo_;
+                new_ex_mem.alu_out = hilo(ex.op, fwdA, fwdB, hi, lo);
+                if (!flush_if_id && !halted_ && mem.op != Op::HALT) {
+                    hi_ = hi;
+                    lo_ = lo;
+                }
+            } else {
+                new_ex_mem.alu_out = alu(ex, fwdA, fwdB);
+            }
+            if (ex.c.Branch)
+                new_ex_mem.branch_taken = branch_outcome(ex, fwdA, fwdB);
+            if (ex.c.Jump)
+                new_ex_mem.branch_taken = true;
+        }
+        new_ex_mem.rt_val_forwarded = ex.c.Indirect ? fwdA : fwdB;
+
+        // ===== ID =====
+        ID_EX new_id_ex{};
+        if (if_id_.valid) {
+            const MicroOp& u = uops_[if_id_.pc / 4];
+            new_id_ex.pc         = if_id_.pc;
+            new_id_ex.rs_val     = (u.rs == 0) ? 0 : regs_[u.rs];
+            new_id_ex.rt_val     = (u.rt == 0) ? 0 : regs_[u.rt];
+            new_id_ex.valid      = true;
+            new_id_ex.pred_taken = if_id_.pred_taken;
+        }
+
+        // ===== hazard detection (load-use) =====
+        bool stall = false;
+        if (id_ex_.valid && ex.c.MemRead && if_id_.valid) {
+            const MicroOp& id = uops_[if_id_.pc / 4];
+            if (ex.rt != 0 && (ex.rt == id.rs || ex.rt == id.rt))
+                stall = true;
+        }
+
+        // ===== squash =====
+        if (flush_if_id) {
+            new_ex_mem = {};
+            new_id_ex  = {};
+            stall      = false;
+        }
+
+        // ===== IF =====
+        ToMem out;
+        IF_ID new_if_id{};
+        uint32_t next_pc = flush_if_id ? redirect_pc : pc_;
+        if (!stall) {
+            if (fetch_enabled_ && next_pc / 4 < prog_.size) {
+                new_if_id.pc    = next_pc;
+                new_if_id.valid = true;
+                if (caches_.enabled() && !halted_) {
+                    out.fetch_pc    = next_pc;
+                    out.fetch_stall = caches_.fetchL1(next_pc, out.fetch_miss);
+                }
+                const MicroOp& f = uops_[next_pc / 4];
+                if ((f.c.Branch || (f.c.Jump && !f.c.Indirect)) &&
+                    bp_.predict(next_pc, f.c.Jump, f.target)) {
+                    new_if_id.pred_taken = true;
+                    next_pc = f.target;
+                } else {
+                    next_pc += 4;
+                }
+            }
+        } else {
+            new_if_id = if_id_;
+            new_id_ex = {};
+        }
+
+        // commit all but MEM/WB, which arrives from the memory thread
+        ex_mem_ = new_ex_mem;
+        id_ex_  = new_id_ex;
+        if_id_  = new_if_id;
+        pc_     = next_pc;
+
+        // Freezes reach `frozen` a cycle late, so a limit can be passed by
+        // the one cycle whose miss was not counted yet.
+        out.ex_mem = ex_mem_;
+        out.last   = halted_ || cycles_ + frozen >= max_cycles;
+        to_mem.push(out);
+        FromMem in = from_mem.pop();
+        mem_wb_ = in.mem_wb;
+        frozen  = in.frozen;
+        if (in.fault) {
+            mem_stage.join();
+            cycles_ += frozen_total;
+            rethrow_exception(fault);
+        }
+        if (out.last) break;
+    }
+    mem_stage.join();
+    cycles_ += frozen_total;
+}
@@ -1,52 +1,183 @@
 //mips_parser.cpp
-#include "mips_core.h"
-
-enum InstructionType {
-    R_TYPE,
-    I_TYPE,
-    J_TYPE
-};
-
-struct DecodedInstruction {
-    uint8_t opcode;
-    InstructionType type;
-    uint8_t rs, rt, rd;
-    uint8_t shamt;
-    uint8_t funct;
-    int16_t immediate;  // signed for sign extension
-    uint32_t address;
-};
-
-DecodedInstruction decode(uint32_t instruction) {
-    DecodedInstruction decoded;
-    
-    // Extract opcode (bits 31-26)
-    decoded.opcode = (instruction >> 26) & 0x3F;
-	
-	if (decoded.opcode == 0) {
-    decoded.type = R_TYPE;
-    decoded.rs = (instruction >> 21) & 0x1F;    // bits 25-21
-    decoded.rt = (instruction >> 16) & 0x1F;    // bits 20-16
-    decoded.rd = (instruction >> 11) & 0x1F;    // bits 15-11
-    decoded.shamt = (instruction >> 6) & 0x1F;  // bits 10-6
-    decoded.funct = instruction & 0x3F;          // bits 5-0
-	}
-	else if (decoded.opcode != 2 && decoded.opcode != 3) {  
-    decoded.type = I_TYPE;
-    decoded.rs = (instruction >> 21) & 0x1F;    // bits 25-21
-    decoded.rt = (instruction >> 16) & 0x1F;    // bits 20-16
-    decoded.immediate = instruction & 0xFFFF;  	// bits 15-0
-	}
-	else if (decoded.opcode == 2 || decoded.opcode == 3) { 
-    decoded.type = J_TYPE;
-    decoded.address = instruction & 0x3FFFFFF;   // bits 25-0
-	}
-	return decoded;
+// MIPS32 machine code loader: raw images and the .text section of ELF32
+// files, decoded in bulk into the pipeline's Instruction array.
+
+#include "mips_parser.h"
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+// ---------------- opcode / funct tables ----------------
+namespace {
+
+constexpr uint8_t kUnsupported = 0xFF;
+
+using OpTable = array<uint8_t, 64>;
+
+// Every encoding in kOpInfo and kOpAliases under `enc`, by its code.
+constexpr OpTable make_table(Enc enc) {
+    OpTable t{};
+    for (auto& e : t) e = kUnsupported;
+    for (size_t i = 0; i < kOpCount; ++i)
+        if (kOpInfo[i].enc == enc) t[kOpInfo[i].code] = static_cast<uint8_t>(i);
+    for (const OpAlias& a : kOpAliases)
+        if (a.enc == enc) t[a.code] = static_cast<uint8_t>(a.op);
+    return t;
 }
 
+constexpr OpTable kSpecial  = make_table(Enc::Special);    // opcode 0, by funct
+constexpr OpTable kSpecial2 = make_table(Enc::Special2);   // opcode 0x1C, by funct
+constexpr OpTable kRegImm   = make_table(Enc::RegImm);     // opcode 1, by rt
+constexpr OpTable kPrimary  = make_table(Enc::Primary);    // the rest, by opcode
 
+constexpr uint8_t kOpRegImm   = 0x01;
+constexpr uint8_t kOpSpecial2 = 0x1C;
 
+inline uint32_t load_word(const unsigned char* p, ByteOrder order) {
+    if (order == ByteOrder::Big)
+        return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 |
+               uint32_t(p[2]) << 8  | uint32_t(p[3]);
+    return uint32_t(p[3]) << 24 | uint32_t(p[2]) << 16 |
+           uint32_t(p[1]) << 8  | uint32_t(p[0]);
+}
+
+inline uint16_t load_half(const unsigned char* p, ByteOrder order) {
+    return order == ByteOrder::Big ? uint16_t(p[0] << 8 | p[1])
+                                   : uint16_t(p[1] << 8 | p[0]);
+}
 
+} // namespace
 
+Instruction toInstruction(const DecodedInstruction& d, bool* supported) {
+    Instruction ins{};
+    uint8_t o;
+    if (d.type == R_TYPE)
+        o = kSpecial[d.funct];
+    else if (d.opcode == kOpSpecial2)
+        o = kSpecial2[d.funct];
+    else if (d.opcode == kOpRegImm)
+        o = kRegImm[d.rt];
+    else
+        o = kPrimary[d.opcode];
 
+    if (supported) *supported = (o != kUnsupported);
+    if (o == kUnsupported) return ins;   // NOP
+
+    ins.op = static_cast<Op>(o);
+    switch (opInfo(ins.op).format) {
+        case Format::None:
+            break;
+        case Format::Target:
+            ins.addr = d.address;
+            break;
+        case Format::RtRsImm: case Format::RtImm: case Format::RtMem:
+        case Format::RsRtLabel: case Format::RsLabel:
+            ins.rs  = d.rs;
+            ins.rt  = d.rt;
+            ins.imm = d.immediate;
+            break;
+        default:
+            // sll $0, $0, 0 is the canonical MIPS nop
+            if (ins.op == Op::SLL && d.rd == 0 && d.rt == 0 && d.shamt == 0) {
+                ins.op = Op::NOP;
+                break;
+            }
+            ins.rs    = d.rs;
+            ins.rt    = d.rt;
+            ins.rd    = d.rd;
+            ins.shamt = d.shamt;
+            break;
+    }
+    return ins;
+}
 
+BinaryProgram decodeImage(const unsigned char* bytes, size_t words,
+                          ByteOrder order, uint32_t base) {
+    BinaryProgram out;
+    out.base = base;
+    out.text.resize(words);
+    uint32_t base_index = base >> 2;
+    bool ok = true;
+    for (size_t i = 0; i < words; ++i) {
+        Instruction& ins = out.text[i];
+        ins = toInstruction(decode(load_word(bytes + 4 * i, order)), &ok);
+        out.unsupported += !ok;
+        if (i > 0 && ins.op != Op::NOP &&
+            (opInfo(out.text[i - 1].op).flags & (kBranch | kJump)))
+            ++out.filled_delay_slots;
+        // the pipeline fetches text[0] from PC 0
+        if (opInfo(ins.op).format == Format::Target)
+            ins.addr = (ins.addr - base_index) & 0x03FFFFFFu;
+    }
+    return out;
+}
+
+// ---------------- file formats ----------------
+static BinaryProgram load_elf32(string_view image) {
+    const auto* b = reinterpret_cast<const unsigned char*>(image.data());
+    size_t size = image.size();
+    auto need = [&](size_t off, size_t len) {
+        if (off > size || len > size - off)
+            throw runtime_error("Truncated ELF file");
+    };
+
+    need(0, 52);
+    if (b[4] != 1) throw runtime_error("Only 32-bit ELF files are supported");
+    if (b[5] != 1 && b[5] != 2) throw runtime_error("Bad ELF byte order");
+    ByteOrder order = (b[5] == 2) ? ByteOrder::Big : ByteOrder::Little;
+    if (load_half(b + 18, order) != 8)
+        throw runtime_error("Not a MIPS ELF file");
+
+    uint32_t shoff     = load_word(b + 32, order);
+    uint16_t shentsize = load_half(b + 46, order);
+    uint16_t shnum     = load_half(b + 48, order);
+    uint16_t shstrndx  = load_half(b + 50, order);
+    if (shentsize < 40) throw runtime_error("Bad ELF section header size");
+    need(shoff, size_t(shnum) * shentsize);
+
+    auto section = [&](uint16_t i) { return b + shoff + size_t(i) * shentsize; };
+    string_view names;
+    if (shstrndx < shnum) {
+        const unsigned char* s = section(shstrndx);
+        uint32_t off = load_word(s + 16, order), len = load_word(s + 20, order);
+        need(off, len);
+        names = image.substr(off, len);
+    }
+
+    // .text by name, else the first executable PROGBITS section
+    const unsigned char* text = nullptr;
+    for (uint16_t i = 0; i < shnum && !text; ++i) {
+        const unsigned char* s = section(i);
+        uint32_t name = load_word(s, order);
+        if (name < names.size() &&
+            names.substr(name, names.find('\0', name) - name) == ".text")
+            text = s;
+    }
+    for (uint16_t i = 0; i < shnum && !text; ++i) {
+        const unsigned char* s = section(i);
+        if (load_word(s + 4, order) == 1 && (load_word(s + 8, order) & 0x4))
+            text = s;
+    }
+    if (!text) throw runtime_error("ELF file has no .text section");
+
+    uint32_t addr = load_word(text + 12, order);
+    uint32_t off  = load_word(text + 16, order);
+    uint32_t len  = load_word(text + 20, order);
+    need(off, len);
+    if (len % 4 != 0)
+        throw runtime_error("ELF .text size is not a multiple of 4 bytes");
+    return decodeImage(b + off, len / 4, order, addr);
+}
+
+BinaryProgram loadBinary(string_view image, ByteOrder raw_order,
+                         uint32_t raw_base) {
+    if (image.size() >= 4 && memcmp(image.data(), "\x7f" "ELF", 4) == 0)
+        return load_elf32(image);
+    if (image.size() % 4 != 0)
+        throw runtime_error("Binary image size is not a multiple of 4 bytes");
+    return decodeImage(reinterpret_cast<const unsigned char*>(image.data()),
+                       image.size() / 4, raw_order, raw_base);
+}
@@ -0,0 +1,100 @@
+// mips_parser.h
+#ifndef MIPS_PARSER_H
+#define MIPS_PARSER_H
+
+#include "mips_ir.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+enum InstructionType {
+    R_TYPE,
+    I_TYPE,
+    J_TYPE
+};
+
+struct DecodedInstruction {
+    uint8_t opcode;
+    InstructionType type;
+    uint8_t rs, rt, rd;
+    uint8_t shamt;
+    uint8_t funct;
+    int16_t immediate;  // signed for sign extension
+    uint32_t address;
+};
+
+// Splits a MIPS32 machine word into its R/I/J-type fields. Inline so the
+// bulk loader below decodes without a call per word.
+inline DecodedInstruction decode(uint32_t instruction) {
+    DecodedInstruction decoded{};
+
+    // Extract opcode (bits 31-26)
+    decoded.opcode = (instruction >> 26) & 0x3F;
+
+    if (decoded.opcode == 0) {
+        decoded.type = R_TYPE;
+        decoded.rs = (instruction >> 21) & 0x1F;    // bits 25-21
+        decoded.rt = (instruction >> 16) & 0x1F;    // bits 20-16
+        decoded.rd = (instruction >> 11) & 0x1F;    // bits 15-11
+        decoded.shamt = (instruction >> 6) & 0x1F;  // bits 10-6
+        decoded.funct = instruction & 0x3F;         // bits 5-0
+    }
+    else if (decoded.opcode != 2 && decoded.opcode != 3) {
+        decoded.type = I_TYPE;
+        decoded.rs = (instruction >> 21) & 0x1F;    // bits 25-21
+        decoded.rt = (instruction >> 16) & 0x1F;    // bits 20-16
+        decoded.immediate = instruction & 0xFFFF;   // bits 15-0
+        // SPECIAL2 (MUL) is R-format under a non-zero opcode
+        decoded.rd = (instruction >> 11) & 0x1F;
+        decoded.funct = instruction & 0x3F;
+    }
+    else {
+        decoded.type = J_TYPE;
+        decoded.address = instruction & 0x3FFFFFF;  // bits 25-0
+    }
+    return decoded;
+}
+
+// Maps decoded fields onto the simulator's Instruction through opcode,
+// funct and REGIMM tables built from kOpInfo and kOpAliases (mips_ir.hpp).
+// Encodings the pipeline does not implement come back as NOP with
+// `*supported` set to false.
+//
+//   R-type ALU, shifts, JR/JALR, MULT/DIV, MFHI/MTHI...  SPECIAL funct
+//   MUL                                                SPECIAL2 funct 0x02
+//   BLTZ, BGEZ                                         REGIMM rt
+//   immediates, loads/stores, BEQ...BGTZ, J, JAL       opcode
+//   ADDU/SUBU/ADDIU                                    as ADD/SUB/ADDI
+//   SYSCALL, BREAK                                     HALT
+//   0x00000000 (sll $0, $0, 0)                         NOP
+Instruction toInstruction(const DecodedInstruction& d,
+                          bool* supported = nullptr);
+
+enum class ByteOrder { Big, Little };
+
+struct BinaryProgram {
+    std::vector<Instruction> text;
+    uint32_t base{0};          // load address of text[0]
+    size_t unsupported{0};     // words that became NOP
+    // Branches and jumps whose delay slot holds an instruction. Delay
+    // slots are not modelled, so such code runs the slot after the
+    // branch instead of before it, and JAL/JALR return into it.
+    size_t filled_delay_slots{0};
+};
+
+// Decodes `words` machine words stored at `bytes` in bulk. J/JAL targets are
+// rebased so that `base` becomes PC 0, which is where the pipeline fetches
+// from.
+BinaryProgram decodeImage(const unsigned char* bytes, size_t words,
+                          ByteOrder order, uint32_t base);
+
+// Loads a raw image (a sequence of instruction words in `raw_order`,
+// loaded at `raw_base`) or, when it starts with the ELF magic, the .text
+// section of a 32-bit MIPS ELF file in the byte order its header declares.
+// Throws std::runtime_error on malformed input.
+BinaryProgram loadBinary(std::string_view image,
+                         ByteOrder raw_order = ByteOrder::Big,
+                         uint32_t raw_base = 0);
+
+#endif // MIPS_PARSER_H
@@ -4,11 +4,17 @@
 // g++ -std=c++17 -O2 -Wall -Wextra mips_pipeline.cpp -o mips_sim
 
 #include "mips_pipeline.h"
+#include "mips_hash.h"
 #include "mips_ir.hpp"
+#include "mips_trace.h"
+#include <algorithm>
+#include <array>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
+#include <utility>
 #include <vector>
-#include <tuple>
 
 using namespace std;
 
@@ -18,241 +24,652 @@ static inline int32_t sign_extend_16(int32_t x) {
 }
 
 // WordMemory implementation
-WordMemory::WordMemory(size_t words) : data_(words, 0) {}
+// Shared by every instance and never written: refs stays above 1.
+WordMemory::Page WordMemory::zero_page_{2};
+
+WordMemory::WordMemory(size_t words) : words_(words) {
+    if (words > kMaxWords)
+        throw invalid_argument("WordMemory larger than the 32-bit address space");
+    size_t pages = (words + kPageWords - 1) / kPageWords;
+    tables_.resize((pages + kTablePages - 1) / kTablePages);
+}
+
+WordMemory::WordMemory(const WordMemory& other)
+    : words_(other.words_), tables_(other.tables_.size()) {
+    for (size_t t = 0; t < tables_.size(); ++t) {
+        if (!other.tables_[t]) continue;
+        tables_[t].reset(new Page*[kTablePages]);
+        for (uint32_t i = 0; i < kTablePages; ++i) {
+            Page* p = other.tables_[t][i];
+            if (p) p->refs.fetch_add(1, memory_order_relaxed);
+            tables_[t][i] = p;
+        }
+    }
+}
+
+WordMemory& WordMemory::operator=(const WordMemory& other) {
+    if (this != &other) {
+        WordMemory copy(other);
+        release();
+        words_  = copy.words_;
+        tables_ = move(copy.tables_);
+        tlb_base_ = kNoPage;
+        tlb_page_ = &zero_page_;
+    }
+    return *this;
+}
+
+WordMemory::~WordMemory() {
+    release();
+}
+
+void WordMemory::release() {
+    for (auto& table : tables_) {
+        if (!table) continue;
+        for (uint32_t i = 0; i < kTablePages; ++i) {
+            Page* p = table[i];
+            if (p && p->refs.fetch_sub(1, memory_order_acq_rel) == 1) delete p;
+        }
+    }
+    tables_.clear();
+}
 
 size_t WordMemory::words() const {
-    return data_.size();
+    return words_;
+}
+
+void WordMemory::check(uint32_t byte_addr, const char* op) const {
+    if (byte_addr % 4 != 0) throw runtime_error(string("Unaligned ") + op);
+    if (byte_addr / 4 >= words_) throw runtime_error(string("Out-of-bounds ") + op);
+}
+
+WordMemory::Page* WordMemory::page(uint32_t page) const {
+    const auto& table = tables_[page >> kTableShift];
+    return table ? table[page & (kTablePages - 1)] : nullptr;
+}
+
+WordMemory::Page* WordMemory::writable(uint32_t page) {
+    auto& table = tables_[page >> kTableShift];
+    if (!table) {
+        table.reset(new Page*[kTablePages]);
+        fill(table.get(), table.get() + kTablePages, nullptr);
+    }
+    Page*& p = table[page & (kTablePages - 1)];
+    if (!p) {
+        p = new Page(1);
+    } else if (p->refs.load(memory_order_acquire) != 1) {
+        Page* mine = new Page(1);
+        memcpy(mine->words, p->words, sizeof mine->words);
+        if (p->refs.fetch_sub(1, memory_order_acq_rel) == 1) delete p;
+        p = mine;
+    }
+    return p;
+}
+
+// Only pages wholly inside the memory go into the TLB, so a TLB hit needs
+// no bounds check.
+void WordMemory::fill_tlb(uint32_t page, Page* p) const {
+    if ((size_t(page) + 1) * kPageWords > words_) return;
+    tlb_base_ = page << kPageShift;
+    tlb_page_ = p;
+}
+
+int32_t WordMemory::load_slow(uint32_t byte_addr) const {
+    check(byte_addr, "LW");
+    uint32_t n = byte_addr >> kPageShift;
+    Page* p = page(n);
+    if (!p) p = &zero_page_;
+    fill_tlb(n, p);
+    return p->words[(byte_addr & (kPageBytes - 1)) >> 2];
+}
+
+void WordMemory::store_slow(uint32_t byte_addr, int32_t value) {
+    check(byte_addr, "SW");
+    uint32_t n = byte_addr >> kPageShift;
+    Page* p = writable(n);
+    fill_tlb(n, p);
+    p->words[(byte_addr & (kPageBytes - 1)) >> 2] = value;
+}
+
+uint32_t WordMemory::load_sub(uint32_t byte_addr, uint32_t bytes) const {
+    if (byte_addr & (bytes - 1))
+        throw runtime_error("Unaligned LH");
+    if (byte_addr / 4 >= words_)
+        throw runtime_error(bytes == 1 ? "Out-of-bounds LB" : "Out-of-bounds LH");
+    uint32_t word = static_cast<uint32_t>(load_word(byte_addr & ~3u));
+    return (word >> ((byte_addr & 3) * 8)) & ((1u << (bytes * 8)) - 1);
+}
+
+void WordMemory::store_sub(uint32_t byte_addr, uint32_t bytes, uint32_t value) {
+    if (byte_addr & (bytes - 1))
+        throw runtime_error("Unaligned SH");
+    if (byte_addr / 4 >= words_)
+        throw runtime_error(bytes == 1 ? "Out-of-bounds SB" : "Out-of-bounds SH");
+    uint32_t shift = (byte_addr & 3) * 8;
+    uint32_t mask  = ((1u << (bytes * 8)) - 1) << shift;
+    uint32_t word  = static_cast<uint32_t>(load_word(byte_addr & ~3u));
+    store_word(byte_addr & ~3u,
+               static_cast<int32_t>((word & ~mask) | ((value << shift) & mask)));
 }
 
-int32_t WordMemory::load_word(uint32_t byte_addr) const {
-    if (byte_addr % 4 != 0) throw runtime_error("Unaligned LW");
-    size_t idx = byte_addr / 4;
-    if (idx >= data_.size()) throw runtime_error("Out-of-bounds LW");
-    return data_[idx];
+void WordMemory::write_words(uint32_t byte_addr, const int32_t* src, size_t n) {
+    if (byte_addr % 4 != 0 || byte_addr / 4 + n > words_)
+        throw runtime_error("Out-of-bounds memory write");
+    tlb_base_ = kNoPage;   // writable() may replace the cached page
+    size_t w = byte_addr / 4;
+    while (n) {
+        size_t off   = w % kPageWords;
+        size_t chunk = min(n, kPageWords - off);
+        Page* p = writable(static_cast<uint32_t>(w / kPageWords));
+        memcpy(p->words + off, src, chunk * sizeof(int32_t));
+        src += chunk;
+        w   += chunk;
+        n   -= chunk;
+    }
 }
 
-void WordMemory::store_word(uint32_t byte_addr, int32_t value) {
-    if (byte_addr % 4 != 0) throw runtime_error("Unaligned SW");
-    size_t idx = byte_addr / 4;
-    if (idx >= data_.size()) throw runtime_error("Out-of-bounds SW");
-    data_[idx] = value;
+void WordMemory::read_words(uint32_t byte_addr, int32_t* dst, size_t n) const {
+    if (byte_addr % 4 != 0 || byte_addr / 4 + n > words_)
+        throw runtime_error("Out-of-bounds memory read");
+    size_t w = byte_addr / 4;
+    while (n) {
+        size_t off   = w % kPageWords;
+        size_t chunk = min(n, kPageWords - off);
+        const Page* p = page(static_cast<uint32_t>(w / kPageWords));
+        if (p) memcpy(dst, p->words + off, chunk * sizeof(int32_t));
+        else   fill(dst, dst + chunk, 0);
+        dst += chunk;
+        w   += chunk;
+        n   -= chunk;
+    }
 }
 
-const std::vector<int32_t>& WordMemory::raw() const {
-    return data_;
+size_t WordMemory::resident_pages() const {
+    size_t n = 0;
+    for_each_page([&](uint32_t, const int32_t*) { ++n; });
+    return n;
 }
 
-std::vector<int32_t>& WordMemory::raw() {
-    return data_;
+uint64_t WordMemory::content_hash() const {
+    uint64_t h = words_;
+    for_each_page([&](uint32_t addr, const int32_t* words) {
+        if (all_of(words, words + kPageWords, [](int32_t w) { return w == 0; }))
+            return;
+        h = ((h ^ addr) * 0x9E3779B97F4A7C15ull) ^ hash64(words, kPageBytes);
+    });
+    return h;
+}
+
+bool WordMemory::operator==(const WordMemory& other) const {
+    if (words_ != other.words_) return false;
+    size_t pages = (words_ + kPageWords - 1) / kPageWords;
+    for (size_t i = 0; i < pages; ++i) {
+        const Page* a = page(static_cast<uint32_t>(i));
+        const Page* b = other.page(static_cast<uint32_t>(i));
+        if (a == b) continue;
+        if (!a) a = &zero_page_;
+        if (!b) b = &zero_page_;
+        if (memcmp(a->words, b->words, sizeof a->words) != 0) return false;
+    }
+    return true;
 }
 
 // ---------------- the simulator ----------------
+const MIPSPipeline::MicroOp MIPSPipeline::kBubble{};
+
 MIPSPipeline::MIPSPipeline(const vector<Instruction>& program,
              size_t memory_words,
              bool trace)
     // Bug 2: respect member declaration order (regs_, mem_, prog_, ...)
+    : mem_(memory_words),
+      owned_prog_(make_shared<const vector<Instruction>>(program)),
+      prog_(*owned_prog_),
+      trace_(trace) {
+    load_program();
+}
+
+MIPSPipeline::MIPSPipeline(ProgramView program,
+             size_t memory_words,
+             bool trace)
     : mem_(memory_words),
       prog_(program),
       trace_(trace) {
+    load_program();
+}
+
+void MIPSPipeline::load_program() {
     regs_.fill(0);
+    // prog_ never changes after load, so decode it once up front
+    auto d = make_shared<Decoded>();
+    vector<MicroOp>& uops = d->uops;
+    uops.reserve(prog_.size);
+    for (size_t i = 0; i < prog_.size; ++i)
+        uops.push_back(predecode(prog_[i], static_cast<uint32_t>(i * 4)));
+
+    size_t n = uops.size();
+    d->straight.assign(n + 1, 0);
+    d->lu_before.assign(n + 1, 0);
+    for (size_t i = n; i-- > 0;) {
+        const Control& c = uops[i].c;
+        bool ends = c.Branch || c.Jump || uops[i].op == Op::HALT;
+        d->straight[i] = ends ? 0 : d->straight[i + 1] + 1;
+    }
+    for (size_t i = 1; i <= n; ++i)
+        d->lu_before[i] = d->lu_before[i - 1] +
+                          (i - 1 > 0 && load_use(uops[i - 2], uops[i - 1]));
+
+    // field by field: Instruction has padding
+    uint64_t h = n;
+    for (size_t i = 0; i < prog_.size; ++i) {
+        const Instruction& ins = prog_[i];
+        uint32_t rec[4] = {static_cast<uint32_t>(ins.op),
+                           uint32_t(ins.rs) | uint32_t(ins.rt) << 8 |
+                               uint32_t(ins.rd) << 16 | uint32_t(ins.shamt) << 24,
+                           static_cast<uint32_t>(ins.imm), ins.addr};
+        h = hash64(rec, sizeof rec, h);
+    }
+    d->program_hash = h;
+
+    decoded_   = d;
+    uops_      = d->uops.data();
+    n_uops_    = n;
+    straight_  = d->straight.data();
+    lu_before_ = d->lu_before.data();
+}
+
+const vector<MIPSPipeline::MicroOp>& MIPSPipeline::microOps() const {
+    return decoded_->uops;
+}
+
+void MIPSPipeline::setPredecode(bool on) {
+    predecode_ = on;
+    if (!on) redecode_in_flight();
+}
+
+// prog_ never changes, so a latch's PC is all it takes to rebuild what ID
+// decoded for it.
+void MIPSPipeline::redecode_in_flight() {
+    auto at = [&](uint32_t pc) { return predecode(prog_[pc / 4], pc); };
+    if (id_ex_.valid)  id_ex_op_  = at(id_ex_.pc);
+    if (ex_mem_.valid) ex_mem_op_ = at(ex_mem_.pc);
+    if (mem_wb_.valid) mem_wb_op_ = at(mem_wb_.pc);
+}
+
+void MIPSPipeline::setEventSkip(bool on) {
+    event_skip_ = on;
+}
+
+void MIPSPipeline::setStageThreads(bool on) {
+    stage_threads_ = on;
+}
+
+void MIPSPipeline::setCaches(const CacheHierarchyConfig& cfg) {
+    caches_ = CacheHierarchy(cfg);
+}
+
+const CacheHierarchy& MIPSPipeline::caches() const {
+    return caches_;
+}
+
+void MIPSPipeline::setBranchPredictor(const PredictorConfig& cfg) {
+    bp_ = BranchPredictor(cfg);
 }
 
-void MIPSPipeline::run() {
-    while (!isHalted()) step();
+const BranchPredictor& MIPSPipeline::branchPredictor() const {
+    return bp_;
+}
+
+void MIPSPipeline::setCounters(bool on) {
+    count_ = on;
+}
+
+void MIPSPipeline::setProfile(bool on) {
+    if (on) counters_.profile.reset(n_uops_);
+    else    counters_.profile = PcProfile();
+}
+
+const PerfCounters& MIPSPipeline::counters() const {
+    return counters_;
+}
+
+void MIPSPipeline::setTraceFile(const string& path) {
+    trace_out_ = make_shared<TraceWriter>(path, prog_);
+}
+
+void MIPSPipeline::closeTraceFile() {
+    if (trace_out_) trace_out_->close();
+    trace_out_.reset();
+}
+
+void MIPSPipeline::run(uint64_t max_cycles) {
+    if (stage_threads_ && predecode_ && !count_ &&
+        counters_.profile.empty() && !trace_ && !trace_out_)
+        return run_stage_threads(max_cycles);
+    bool skip = event_skip_ && predecode_ && !trace_ && !trace_out_ &&
+                !caches_.enabled();
+    if (!counters_.profile.empty()) run_cycles<ProfileEvents>(max_cycles, false);
+    else if (count_)                run_cycles<CountEvents>(max_cycles, false);
+    else                            run_cycles<CountNothing>(max_cycles, skip);
+}
+
+template <class Counters>
+void MIPSPipeline::run_cycles(uint64_t max_cycles, bool skip) {
+    while (!isHalted() && cycles_ < max_cycles) {
+        if (skip) skip_hazard_free();
+        step_cycle<Counters>();
+    }
+}
+
+// Minimum straight-line stretch worth leaving the per-cycle loop for.
+static constexpr uint32_t kMinSkip = 8;
+
+// If no branch, jump or HALT is in flight, fetch carries on sequentially
+// from pc_ and every upcoming cycle is predictable up to the next one in
+// prog_. Pick X, the end of that stretch, such that X does not depend on a
+// load right before it; then "everything older than X retired, pipeline
+// empty, X fetched next cycle" is indistinguishable from the per-cycle
+// state: X and younger see the same values (forwarding makes the in-flight
+// ones look retired anyway) at the same cycles. The only timing events
+// before X's fetch are load-use stalls, counted from the static scan.
+void MIPSPipeline::skip_hazard_free() {
+    if (halted_ || pc_ % 4 != 0 || pc_ / 4 >= n_uops_)
+        return;
+
+    const MicroOp& wb  = mem_wb_.valid ? uops_[mem_wb_.pc / 4] : kBubble;
+    const MicroOp& mem = ex_mem_.valid ? uops_[ex_mem_.pc / 4] : kBubble;
+    const MicroOp& ex  = id_ex_.valid  ? uops_[id_ex_.pc / 4]  : kBubble;
+    const MicroOp& id  = if_id_.valid  ? uops_[if_id_.pc / 4]  : kBubble;
+    for (const MicroOp* u : {&wb, &mem, &ex, &id})
+        if (u->c.Branch || u->c.Jump || u->op == Op::HALT)
+            return;
+
+    size_t p = pc_ / 4;
+    size_t k = straight_[p];
+    while (k > 0 && p + k < n_uops_ &&
+           load_use(uops_[p + k - 1], uops_[p + k]))
+        --k;
+    if (k < kMinSkip)
+        return;
+    size_t x = p + k;
+
+    // stalls before X's fetch: the pair now in EX/ID, the one IF/ID forms
+    // with pc_, then every pair inside the stretch
+    uint64_t stalls = lu_before_[x] - lu_before_[p + 1];
+    if (id_ex_.valid && if_id_.valid && load_use(ex, id)) ++stalls;
+    if (if_id_.valid && load_use(id, uops_[p]))            ++stalls;
+
+    // retire what is in flight, oldest first
+    if (mem_wb_.valid && wb.c.RegWrite && mem_wb_.dest != 0)
+        regs_[mem_wb_.dest] = wb.c.MemToReg ? mem_wb_.mem_data
+                                            : mem_wb_.alu_out;
+    if (ex_mem_.valid && !mem.c.isNOP) {
+        int32_t val = ex_mem_.alu_out;
+        if (mem.c.MemRead)
+            val = load(mem, mem_, (uint32_t)ex_mem_.alu_out);
+        if (mem.c.MemWrite)
+            store(mem, mem_, (uint32_t)ex_mem_.alu_out,
+                  ex_mem_.rt_val_forwarded);
+        if (mem.c.RegWrite && ex_mem_.dest != 0)
+            regs_[ex_mem_.dest] = val;
+    }
+    if (id_ex_.valid) execute(ex, id_ex_.pc);
+    if (if_id_.valid) execute(id, if_id_.pc);
+
+    // then the stretch itself
+    for (size_t i = p; i < x; ++i)
+        execute(uops_[i], static_cast<uint32_t>(i * 4));
+
+    // X is fetched in cycle cycles_ + 1 + k + stalls
+    cycles_ += k + stalls;
+    mem_wb_ = {};
+    ex_mem_ = {};
+    id_ex_  = {};
+    if_id_  = {};
+    pc_     = static_cast<uint32_t>(x * 4);
 }
 
 void MIPSPipeline::step() {
+    if (!counters_.profile.empty()) step_cycle<ProfileEvents>();
+    else if (count_)                step_cycle<CountEvents>();
+    else                            step_cycle<CountNothing>();
+}
+
+// Counters is a policy from mips_counters.h; with CountNothing every hook
+// is empty and this is the uncounted cycle.
+template <class Counters>
+void MIPSPipeline::step_cycle() {
         if (halted_) return;
         cycles_++;
 
+        // Latches carry only the PC; control comes from the micro-op table,
+        // or from what ID decoded when there is none.
+        const MicroOp& wb  = !mem_wb_.valid ? kBubble
+                           : predecode_     ? uops_[mem_wb_.pc / 4] : mem_wb_op_;
+        const MicroOp& mem = !ex_mem_.valid ? kBubble
+                           : predecode_     ? uops_[ex_mem_.pc / 4] : ex_mem_op_;
+        const MicroOp& ex  = !id_ex_.valid  ? kBubble
+                           : predecode_     ? uops_[id_ex_.pc / 4]  : id_ex_op_;
+
         // ===== WB =====
-        if (mem_wb_.valid && !mem_wb_.c.isNOP) {
-            if (mem_wb_.c.RegWrite && mem_wb_.dest != 0) {
-                int32_t val = mem_wb_.c.MemToReg ? mem_wb_.mem_data : mem_wb_.alu_out;
-                regs_[mem_wb_.dest] = val;
+        uint8_t wb_reg = 0;
+        int32_t wb_val = 0;
+        if (mem_wb_.valid && !wb.c.isNOP) {
+            if (wb.c.RegWrite && mem_wb_.dest != 0) {
+                wb_reg = mem_wb_.dest;
+                wb_val = wb.c.MemToReg ? mem_wb_.mem_data : mem_wb_.alu_out;
+                regs_[wb_reg] = wb_val;
             }
         }
+        if (mem_wb_.valid)
+            Counters::retire(counters_, mem_wb_.pc, wb.op);
         // Check if HALT instruction is completing in WB stage
-        if (mem_wb_.valid && mem_wb_.is_halt)
+        if (mem_wb_.valid && wb.op == Op::HALT)
             halted_ = true;
 
         // ===== MEM =====
         MEM_WB new_mem_wb{};
-        new_mem_wb.c       = ex_mem_.c;
+        new_mem_wb.pc      = ex_mem_.pc;
         new_mem_wb.valid   = ex_mem_.valid;
         new_mem_wb.dest    = ex_mem_.dest;
         new_mem_wb.alu_out = ex_mem_.alu_out;
-        new_mem_wb.is_halt = ex_mem_.is_halt;  // Propagate HALT flag
 
-        if (ex_mem_.valid && !ex_mem_.c.isNOP) {
-            if (ex_mem_.c.MemRead)
-                new_mem_wb.mem_data = mem_.load_word((uint32_t)ex_mem_.alu_out);
-            if (ex_mem_.c.MemWrite)
-                mem_.store_word((uint32_t)ex_mem_.alu_out, ex_mem_.rt_val_forwarded);
+        // instructions younger than a retiring HALT must not touch memory
+        uint32_t freeze = 0;   // cycles every stage waits on cache misses
+        if (ex_mem_.valid && !mem.c.isNOP && !halted_) {
+            uint32_t addr = (uint32_t)ex_mem_.alu_out;
+            if (mem.c.MemRead)
+                new_mem_wb.mem_data = load(mem, mem_, addr);
+            if (mem.c.MemWrite)
+                store(mem, mem_, addr, ex_mem_.rt_val_forwarded);
+            if (caches_.enabled() && (mem.c.MemRead || mem.c.MemWrite)) {
+                freeze = mem.c.MemWrite ? caches_.store(addr) : caches_.load(addr);
+                Counters::miss(counters_, ex_mem_.pc, freeze);
+            }
         }
 
+        // branches and jumps resolve here; a wrong fetch-time prediction
+        // redirects fetch to the correct path (JR/JALR, never predicted,
+        // always do, to the target EX left in rt_val_forwarded)
         bool     flush_if_id = false;
         uint32_t redirect_pc = pc_;
-        if (ex_mem_.valid && ex_mem_.c.Branch && ex_mem_.branch_taken) {
-            redirect_pc = ex_mem_.branch_target;
-            flush_if_id = true;
-        }
-        if (ex_mem_.valid && ex_mem_.c.Jump) {
-            redirect_pc = ex_mem_.branch_target;
-            flush_if_id = true;
+        if (ex_mem_.valid && (mem.c.Branch || mem.c.Jump)) {
+            bool taken = mem.c.Jump || ex_mem_.branch_taken;
+            if (bp_.resolve(ex_mem_.pc, mem.c.Jump, taken, ex_mem_.pred_taken)) {
+                redirect_pc = !taken         ? ex_mem_.pc + 4
+                              : mem.c.Indirect ? (uint32_t)ex_mem_.rt_val_forwarded
+                                               : mem.target;
+                flush_if_id = true;
+            }
         }
 
         // ===== EX =====
         EX_MEM new_ex_mem{};
-        new_ex_mem.c     = id_ex_.c;
-        new_ex_mem.valid = id_ex_.valid;
-        new_ex_mem.dest  = id_ex_.c.RegDst ? id_ex_.rd : id_ex_.rt;
-        new_ex_mem.is_halt = id_ex_.is_halt;  // Propagate HALT flag
+        new_ex_mem.pc         = id_ex_.pc;
+        new_ex_mem.valid      = id_ex_.valid;
+        new_ex_mem.pred_taken = id_ex_.pred_taken;
+        new_ex_mem.dest  = ex.dest;
 
         // forwarding
         int32_t fwdA = id_ex_.rs_val;
         int32_t fwdB = id_ex_.rt_val;
 
-        if (ex_mem_.valid && ex_mem_.c.RegWrite && ex_mem_.dest != 0) {
-            if (ex_mem_.dest == id_ex_.rs) fwdA = ex_mem_.alu_out;
-            if (ex_mem_.dest == id_ex_.rt) fwdB = ex_mem_.alu_out;
+        // EX/MEM holds the younger result, so it is applied last and wins
+        // when both stages write the same register
+        bool wb_fwd  = mem_wb_.valid && wb.c.RegWrite && mem_wb_.dest != 0;
+        bool mem_fwd = ex_mem_.valid && mem.c.RegWrite && ex_mem_.dest != 0;
+        if (wb_fwd) {
+            int32_t wb_val = wb.c.MemToReg ? mem_wb_.mem_data : mem_wb_.alu_out;
+            if (mem_wb_.dest == ex.rs) fwdA = wb_val;
+            if (mem_wb_.dest == ex.rt) fwdB = wb_val;
         }
-        if (mem_wb_.valid && mem_wb_.c.RegWrite && mem_wb_.dest != 0) {
-            int32_t wb_val = mem_wb_.c.MemToReg ? mem_wb_.mem_data : mem_wb_.alu_out;
-            if (mem_wb_.dest == id_ex_.rs) fwdA = wb_val;
-            if (mem_wb_.dest == id_ex_.rt) fwdB = wb_val;
+        if (mem_fwd) {
+            if (ex_mem_.dest == ex.rs) fwdA = ex_mem_.alu_out;
+            if (ex_mem_.dest == ex.rt) fwdB = ex_mem_.alu_out;
+        }
+        if (id_ex_.valid) {
+            Counters::forward(counters_, mem_fwd && ex_mem_.dest == ex.rs,
+                              wb_fwd && mem_wb_.dest == ex.rs);
+            Counters::forward(counters_, mem_fwd && ex_mem_.dest == ex.rt,
+                              wb_fwd && mem_wb_.dest == ex.rt);
         }
-
-        int32_t aluA = fwdA;
-        // Bug 5: sign-extend immediates before ALU use
-        int32_t imm_se = sign_extend_16(id_ex_.imm);
-        int32_t aluB   = id_ex_.c.ALUSrc ? imm_se : fwdB;
 
         int32_t  alu_out       = 0;
         bool     branch_taken  = false;
-        uint32_t branch_target = 0;
-
-        if (id_ex_.valid && !id_ex_.c.isNOP) {
-            switch (id_ex_.c.ALUOp) {
-                case 0: alu_out = aluA + aluB; break;           // ADD / address
-                case 1: alu_out = aluA - aluB; break;           // SUB / BEQ/BNE compare
-                case 2: alu_out = aluA & aluB; break;
-                case 3: alu_out = aluA | aluB; break;
-                case 4: alu_out = (aluA < aluB) ? 1 : 0; break;
-                case 5: alu_out = fwdA * fwdB; break;           // MUL
-                case 6: // SLL: shift rt by shamt (imm)
-                    alu_out = (int32_t)((uint32_t)fwdB << (id_ex_.imm & 31));
-                    break;
-                case 7: // SRL: shift rt by shamt (imm)
-                    alu_out = (int32_t)((uint32_t)fwdB >> (id_ex_.imm & 31));
-                    break;
-                default: alu_out = 0; break;
-            }
 
-            if (id_ex_.c.Branch) {
-                bool is_beq = (curr_id_op_ == Op::BEQ);
-                bool is_bne = (curr_id_op_ == Op::BNE);
-                bool eq     = (fwdA == fwdB);
-                branch_taken  = (is_beq && eq) || (is_bne && !eq);
-                // Bug 5: sign-extend imm before shifting
-                branch_target = id_ex_.pc + 4 +
-                                (sign_extend_16(id_ex_.imm) << 2);
-            }
-            if (id_ex_.c.Jump) {
-                branch_taken  = true;
-                // Bug 6 (Option 2): imm holds the 26-bit word address; shift here
-                uint32_t target = (id_ex_.imm & 0x03FFFFFFu) << 2;
-                branch_target   = (id_ex_.pc & 0xF0000000u) | target;
+        if (id_ex_.valid && !ex.c.isNOP) {
+            if (ex.c.HiLo) {
+                // HI/LO are written here, not in WB, so an instruction
+                // being squashed or behind a HALT must leave them alone
+                int32_t hi = hi_, lo = lo_;
+                alu_out = hilo(ex.op, fwdA, fwdB, hi, lo);
+                if (!flush_if_id && !halted_ && mem.op != Op::HALT) {
+                    hi_ = hi;
+                    lo_ = lo;
+                }
+            } else {
+                alu_out = alu(ex, fwdA, fwdB);
             }
+
+            if (ex.c.Branch)
+                branch_taken = branch_outcome(ex, fwdA, fwdB);
+            // targets for branches, J and JAL are resolved at load time
+            if (ex.c.Jump)
+                branch_taken = true;
         }
 
         new_ex_mem.alu_out          = alu_out;
-        new_ex_mem.rt_val_forwarded = fwdB;
+        new_ex_mem.rt_val_forwarded = ex.c.Indirect ? fwdA : fwdB;
         new_ex_mem.branch_taken     = branch_taken;
-        new_ex_mem.branch_target    = branch_target;
 
         // ===== ID =====
         ID_EX new_id_ex{};
+        MicroOp id{};
         if (if_id_.valid) {
-            auto [ctrl, rs_val, rt_val] = decode_in_id(if_id_.instr);
-            new_id_ex.c      = ctrl;
+            id = predecode_ ? uops_[if_id_.pc / 4]
+                            : predecode(prog_[if_id_.pc / 4], if_id_.pc);
             new_id_ex.pc     = if_id_.pc;
-            new_id_ex.rs     = if_id_.instr.rs;
-            new_id_ex.rt     = if_id_.instr.rt;
-            new_id_ex.rd     = if_id_.instr.rd;
-            new_id_ex.rs_val = rs_val;
-            new_id_ex.rt_val = rt_val;
-
-            // Bug 6: don't shift J target here; keep raw 26-bit word index
-            if (if_id_.instr.op == Op::J)
-                new_id_ex.imm = static_cast<int32_t>(if_id_.instr.addr);
-            else if (if_id_.instr.op == Op::SLL || if_id_.instr.op == Op::SRL)
-                // SLL/SRL use shamt field, not imm
-                new_id_ex.imm = static_cast<int32_t>(if_id_.instr.shamt);
-            else
-                new_id_ex.imm = if_id_.instr.imm;
-
-            new_id_ex.valid = true;
-            new_id_ex.is_halt = (if_id_.instr.op == Op::HALT);
-            curr_id_op_     = if_id_.instr.op;
-            last_retired_halt_ = (if_id_.instr.op == Op::HALT);
-        } else {
-            new_id_ex.c = MIPSPipeline::nop_ctrl();
-            new_id_ex.valid = false;
-            new_id_ex.is_halt = false;
-            curr_id_op_ = Op::NOP;
-            last_retired_halt_ = false;
+            // Bug 4: read protection for $0
+            new_id_ex.rs_val = (id.rs == 0) ? 0 : regs_[id.rs];
+            new_id_ex.rt_val = (id.rt == 0) ? 0 : regs_[id.rt];
+            new_id_ex.valid  = true;
+            new_id_ex.pred_taken = if_id_.pred_taken;
         }
 
         // ===== hazard detection (load-use) =====
         bool stall = false;
-        if (id_ex_.valid && id_ex_.c.MemRead) {
+        if (id_ex_.valid && ex.c.MemRead && if_id_.valid) {
             // Bug 3: LW always writes RT, regardless of RegDst
-            uint8_t load_dest = id_ex_.rt;
+            uint8_t load_dest = ex.rt;
             if (load_dest != 0 &&
-                (load_dest == if_id_.instr.rs ||
-                 load_dest == if_id_.instr.rt)) {
+                (load_dest == id.rs || load_dest == id.rt)) {
                 stall = true;
             }
         }
 
+        // ===== squash =====
+        // A branch/jump resolving in MEM kills the two wrong-path
+        // instructions behind it (now headed for EX/MEM and ID/EX), which
+        // is BranchPredictor::kFlushPenalty; the load-use check above was
+        // about one of them, so drop it too.
+        if (flush_if_id) {
+            new_ex_mem = {};
+            new_id_ex  = {};
+            stall      = false;
+            Counters::flush(counters_, ex_mem_.pc);
+        }
+
         // ===== IF =====
         IF_ID new_if_id{};
         uint32_t next_pc = pc_;
         if (flush_if_id) next_pc = redirect_pc;
 
         if (!stall) {
-            if (next_pc / 4 < prog_.size()) {
-                new_if_id.instr = prog_[next_pc / 4];
+            if (fetch_enabled_ && next_pc / 4 < prog_.size) {
                 new_if_id.pc    = next_pc;
                 new_if_id.valid = true;
-                next_pc += 4;
-            } else {
-                new_if_id.instr = Instruction{}; // NOP
-                new_if_id.valid = false;
+                if (caches_.enabled() && !halted_) {
+                    uint32_t f = caches_.fetch(next_pc);
+                    if (f > freeze) {
+                        Counters::miss(counters_, next_pc, f - freeze);
+                        freeze = f;
+                    }
+                }
+                MicroOp fetched;
+                const MicroOp& f =
+                    predecode_ ? uops_[next_pc / 4]
+                               : (fetched = predecode(prog_[next_pc / 4], next_pc));
+                if ((f.c.Branch || (f.c.Jump && !f.c.Indirect)) &&
+                    bp_.predict(next_pc, f.c.Jump, f.target)) {
+                    new_if_id.pred_taken = true;
+                    next_pc = f.target;
+                } else {
+                    next_pc += 4;
+                }
             }
         } else {
             // hold IF/ID, insert bubble into ID/EX
             new_if_id = if_id_;
             new_id_ex = {};
-            new_id_ex.c     = MIPSPipeline::nop_ctrl();
-            new_id_ex.valid = true;
+            Counters::stall(counters_, if_id_.pc);
         }
 
-        if (flush_if_id) {
-            new_if_id = {};
-            new_if_id.instr = Instruction{};
-            new_if_id.valid = false;
+        // the cycle belongs to EX's instruction, or to whatever emptied EX
+        Counters::cycle(counters_,
+                        flush_if_id    ? ex_mem_.pc
+                        : id_ex_.valid ? id_ex_.pc : PcProfile::kBubble,
+                        flush_if_id       ? ex_mem_.pc
+                        : stall           ? if_id_.pc
+                        : new_if_id.valid ? new_if_id.pc : next_pc);
+
+        // A miss holds every latch for `freeze` cycles; this cycle's work
+        // lands in the last of them. The held cycles are traced as they
+        // are, before the commit.
+        if (freeze) {
+            caches_.addStall(freeze);
+            if (trace_ || trace_out_)
+                for (uint32_t i = 0; i < freeze; ++i, ++cycles_)
+                    dump_trace_line(kTraceMiss, 0, 0);
+            else
+                cycles_ += freeze;
         }
 
         // commit all
+        if (!predecode_) {
+            mem_wb_op_ = ex_mem_op_;
+            ex_mem_op_ = id_ex_op_;
+            id_ex_op_  = id;
+        }
         mem_wb_ = new_mem_wb;
         ex_mem_ = new_ex_mem;
         id_ex_  = new_id_ex;
         if_id_  = new_if_id;
         pc_     = next_pc;
 
-        if (trace_) dump_trace_line();
+        if (trace_ || trace_out_)
+            dump_trace_line((stall       ? kTraceStall    : 0) |
+                            (flush_if_id ? kTraceFlush    : 0) |
+                            (wb_reg      ? kTraceRegWrite : 0),
+                            wb_reg, wb_val);
 }
 
 bool MIPSPipeline::isHalted() const {
@@ -263,84 +680,100 @@ uint64_t MIPSPipeline::cycles() const {
     return cycles_;
 }
 
-// ===== decode in ID =====
-std::tuple<MIPSPipeline::Control, int32_t, int32_t> MIPSPipeline::decode_in_id(const Instruction& ins) {
-        Control c{};
-        c.isNOP = (ins.op == Op::NOP);
+// ===== load-time decode =====
+static constexpr MIPSPipeline::Control make_control(Op op) {
+    const OpInfo& i = opInfo(op);
+    MIPSPipeline::Control c{};
+    c.RegWrite   = i.flags & kRegWrite;
+    c.MemRead    = i.flags & kMemRead;
+    c.MemWrite   = i.flags & kMemWrite;
+    c.MemToReg   = i.flags & kMemRead;
+    c.Branch     = i.flags & kBranch;
+    c.Jump       = i.flags & kJump;
+    c.ALUSrc     = i.flags & kALUSrc;
+    c.RegDst     = i.flags & kRegDst;
+    c.ALUOp      = i.alu;
+    c.isNOP      = op == Op::NOP;
+    c.Indirect   = i.flags & kIndirect;
+    c.HiLo       = i.flags & (kHiLoRead | kHiLoWrite);
+    c.MemSigned  = i.flags & kSigned;
+    c.MemBytes   = i.bytes;
+    c.BranchCond = i.cond;
+    return c;
+}
 
-        // Bug 4: read protection for $0
-        int32_t rs_val = (ins.rs == 0) ? 0 : regs_[ins.rs];
-        int32_t rt_val = (ins.rt == 0) ? 0 : regs_[ins.rt];
+template <size_t... I>
+static constexpr array<MIPSPipeline::Control, kOpCount>
+make_controls(index_sequence<I...>) {
+    return {make_control(static_cast<Op>(I))...};
+}
 
-        switch (ins.op) {
-            case Op::ADD:
-                c = {true,false,false,false,false,false,false,true,0,false};
-                break;
-            case Op::SUB:
-                c = {true,false,false,false,false,false,false,true,1,false};
+static constexpr auto kControl = make_controls(make_index_sequence<kOpCount>{});
+
+MIPSPipeline::MicroOp MIPSPipeline::predecode(const Instruction& ins,
+                                              uint32_t pc) {
+        const OpInfo& info = opInfo(ins.op);
+        MicroOp u{};
+        u.c  = kControl[static_cast<size_t>(ins.op)];
+        u.op = ins.op;
+        u.rs = ins.rs;
+        u.rt = ins.rt;
+        u.rd = ins.rd;
+        // JAL links through $31
+        u.dest = u.c.RegDst                                  ? ins.rd
+                 : (u.c.RegWrite && info.alu == AluOp::Link) ? 31
+                                                             : ins.rt;
+
+        switch (info.imm) {
+            case ImmKind::Sign:   // Bug 5: sign-extend immediates once, here
+                u.imm = sign_extend_16(ins.imm);
                 break;
-            case Op::AND:
-                c = {true,false,false,false,false,false,false,true,2,false};
+            case ImmKind::Zero:
+                u.imm = static_cast<uint16_t>(ins.imm);
                 break;
-            case Op::OR:
-                c = {true,false,false,false,false,false,false,true,3,false};
+            case ImmKind::Upper:
+                u.imm = static_cast<int32_t>(uint32_t(uint16_t(ins.imm)) << 16);
                 break;
-            case Op::SLT:
-                c = {true,false,false,false,false,false,false,true,4,false};
+            case ImmKind::Shamt:
+                u.imm = static_cast<int32_t>(ins.shamt);
                 break;
-            case Op::ADDI:
-                c = {true,false,false,false,false,false,true,false,0,false};
-                break;
-            case Op::LW:   // and L if parser maps L -> Op::LW
-                c = {true,true,false,true,false,false,true,false,0,false};
-                break;
-            case Op::SW:
-                c = {false,false,true,false,false,false,true,false,0,false};
-                break;
-            case Op::BEQ:
-                c = {false,false,false,false,true,false,false,false,1,false};
-                break;
-            case Op::BNE:
-                c = {false,false,false,false,true,false,false,false,1,false};
-                break;
-            case Op::J:
-                c = {false,false,false,false,false,true,false,false,0,false};
-                break;
-            case Op::HALT:
-                c = {false,false,false,false,false,false,false,false,0,false};
-                break;
-            case Op::MUL:
-                // rd = rs * rt
-                c = {true,false,false,false,false,false,false,true,5,false};
-                break;
-            case Op::SLL:
-                // rd = rt << shamt (imm)
-                c = {true,false,false,false,false,false,true,true,6,false};
-                break;
-            case Op::SRL:
-                // rd = rt >> shamt (imm)
-                c = {true,false,false,false,false,false,true,true,7,false};
-                break;
-            case Op::NOP:
-                c = MIPSPipeline::nop_ctrl();
+            case ImmKind::Target: // Bug 6: J keeps the raw 26-bit word index
+                u.imm = static_cast<int32_t>(ins.addr);
                 break;
         }
-        return {c, rs_val, rt_val};
-}
 
-void MIPSPipeline::dump_trace_line() const {
-    auto show = [&](const Instruction& i){ return i.str(); };
+        if (u.c.Branch)
+            u.target = pc + 4 + (static_cast<uint32_t>(u.imm) << 2);
+        else if (u.c.Jump && !u.c.Indirect)
+            // Bug 6: J holds the 26-bit word index; shift it here
+            u.target = (pc & 0xF0000000u) |
+                       ((static_cast<uint32_t>(u.imm) & 0x03FFFFFFu) << 2);
+        // no delay slots: a linking jump returns to the next instruction
+        if (u.c.RegWrite && u.c.ALUOp == AluOp::Link)
+            u.imm = static_cast<int32_t>(pc + 4);
+        return u;
+}
 
-    cout << dec << "Cyc " << cycles_
-        << " | PC=0x" << hex << pc_ << dec
-        << " | IF: ";
-    if (if_id_.valid) cout << show(if_id_.instr);
-    else              cout << "-";
+// One record per cycle; the text trace is the same record formatted.
+void MIPSPipeline::dump_trace_line(uint8_t flags, uint8_t wb_reg,
+                                   int32_t wb_value) const {
+    auto idx = [](bool valid, uint32_t pc) {
+        return valid ? pc / 4 : kTraceEmpty;
+    };
 
-    cout << " | ID: "  << (id_ex_.valid  && !id_ex_.c.isNOP   ? "op" : "-")
-        << " | EX: "  << (ex_mem_.valid && !ex_mem_.c.isNOP  ? "op" : "-")
-        << " | MEM: " << (mem_wb_.valid && !mem_wb_.c.isNOP  ? "op" : "-")
-        << "\n";
+    TraceRecord rec{};
+    rec.cycle    = static_cast<uint32_t>(cycles_);
+    rec.pc       = pc_;
+    rec.stage[0] = idx(if_id_.valid,  if_id_.pc);
+    rec.stage[1] = idx(id_ex_.valid,  id_ex_.pc);
+    rec.stage[2] = idx(ex_mem_.valid, ex_mem_.pc);
+    rec.stage[3] = idx(mem_wb_.valid, mem_wb_.pc);
+    rec.flags    = flags;
+    rec.wb_reg   = wb_reg;
+    rec.wb_value = wb_value;
+
+    if (trace_out_) trace_out_->write(rec);
+    if (trace_)     formatTraceRecord(cout, rec, cycles_, prog_);
 }
 
 // Optional standalone test
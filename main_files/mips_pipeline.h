@@ -2,54 +2,301 @@
 #ifndef MIPS_PIPELINE_H
 #define MIPS_PIPELINE_H
 
+#include "mips_branch.h"
+#include "mips_cache.h"
+#include "mips_counters.h"
 #include "mips_ir.hpp"
 #include <array>
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
 #include <vector>
 
 // Type alias for register file
 using RegFile = std::array<int32_t, 32>;
 
 // Word memory class - needed by mips_output.cpp
+//
+// Sparse and paged: 4 KiB pages are allocated on first store, and pages
+// never written read as zero, so a large address space costs only what is
+// touched. Copying a WordMemory is O(resident pages) and shares every page
+// copy-on-write; a page is cloned the first time either side stores to it.
+// A WordMemory is not itself thread-safe, but copies of one may be taken
+// from several threads at once as long as nothing else uses the source.
+//
+// load_word/store_word go through a one-entry TLB (the last page touched)
+// and only fall back to the page table, bounds and alignment checks when
+// the page changes. Errors are thrown as std::runtime_error.
 class WordMemory {
 public:
-    explicit WordMemory(size_t words);
+    static constexpr uint32_t kPageShift = 12;
+    static constexpr uint32_t kPageBytes = 1u << kPageShift;
+    static constexpr uint32_t kPageWords = kPageBytes / 4;
+    static constexpr size_t   kMaxWords  = size_t(1) << 30;   // 4 GiB
+
+    explicit WordMemory(size_t words);   // words <= kMaxWords
+    WordMemory(const WordMemory& other);
+    WordMemory& operator=(const WordMemory& other);
+    ~WordMemory();
+
     size_t words() const;
-    int32_t load_word(uint32_t byte_addr) const;
-    void store_word(uint32_t byte_addr, int32_t value);
-    const std::vector<int32_t>& raw() const;
-    std::vector<int32_t>& raw();
+
+    int32_t load_word(uint32_t byte_addr) const {
+        if ((byte_addr & kTlbMask) == tlb_base_)
+            return tlb_page_->words[(byte_addr & (kPageBytes - 1)) >> 2];
+        return load_slow(byte_addr);
+    }
+    void store_word(uint32_t byte_addr, int32_t value) {
+        if ((byte_addr & kTlbMask) == tlb_base_ &&
+            tlb_page_->refs.load(std::memory_order_acquire) == 1) {
+            tlb_page_->words[(byte_addr & (kPageBytes - 1)) >> 2] = value;
+            return;
+        }
+        store_slow(byte_addr, value);
+    }
+
+    // Byte and halfword accesses (bytes = 1 or 2), little-endian within
+    // the word: byte 0 of a word is its low 8 bits. Loads zero-extend,
+    // stores keep the rest of the word. Halfwords must be 2-byte aligned.
+    uint32_t load_sub(uint32_t byte_addr, uint32_t bytes) const;
+    void store_sub(uint32_t byte_addr, uint32_t bytes, uint32_t value);
+
+    // Bulk copies of n consecutive words; throw if the range is out of
+    // bounds.
+    void write_words(uint32_t byte_addr, const int32_t* src, size_t n);
+    void read_words(uint32_t byte_addr, int32_t* dst, size_t n) const;
+
+    // Calls f(byte_addr, words) for every allocated page in address order.
+    // `words` holds kPageWords values; pages never written are skipped.
+    template <typename F>
+    void for_each_page(F&& f) const {
+        for (size_t t = 0; t < tables_.size(); ++t) {
+            if (!tables_[t]) continue;
+            for (uint32_t i = 0; i < kTablePages; ++i)
+                if (Page* p = tables_[t][i])
+                    f(static_cast<uint32_t>(((t << kTableShift) + i) << kPageShift),
+                      static_cast<const int32_t*>(p->words));
+        }
+    }
+
+    // Calls f(byte_addr, words) for every page whose contents may differ
+    // from `base` (same size) - found by comparing page identity, so pages
+    // still shared copy-on-write with `base` cost nothing. `words` is null
+    // when the page reads as zero here but not in `base`.
+    template <typename F>
+    void for_each_changed_page(const WordMemory& base, F&& f) const {
+        size_t pages = (words_ + kPageWords - 1) / kPageWords;
+        for (size_t i = 0; i < pages; ++i) {
+            const Page* a = page(static_cast<uint32_t>(i));
+            const Page* b = base.page(static_cast<uint32_t>(i));
+            if (a == b) continue;
+            f(static_cast<uint32_t>(i << kPageShift),
+              a ? static_cast<const int32_t*>(a->words) : nullptr);
+        }
+    }
+
+    size_t resident_pages() const;
+    // Hash of the contents; pages that are all zero are skipped, so it
+    // does not depend on which pages happen to be allocated.
+    uint64_t content_hash() const;
+    bool operator==(const WordMemory& other) const;   // same size and contents
+    bool operator!=(const WordMemory& other) const { return !(*this == other); }
 
 private:
-    std::vector<int32_t> data_;
+    struct Page {
+        explicit Page(uint32_t r) : refs(r) {}
+        std::atomic<uint32_t> refs;      // owners; 1 means writable in place
+        int32_t words[kPageWords]{};
+    };
+
+    // Two-level page table: tables_[page >> kTableShift][page & mask],
+    // second-level tables allocated on demand. Null reads as zero.
+    static constexpr uint32_t kTableShift = 10;
+    static constexpr uint32_t kTablePages = 1u << kTableShift;
+    // Keeps the page number and the two alignment bits, so one compare
+    // checks both; never equal to kNoPage.
+    static constexpr uint32_t kTlbMask = ~(kPageBytes - 1) | 3u;
+    static constexpr uint32_t kNoPage  = 4;
+
+    static Page zero_page_;   // target of loads from untouched pages
+
+    int32_t load_slow(uint32_t byte_addr) const;
+    void store_slow(uint32_t byte_addr, int32_t value);
+    Page* page(uint32_t page) const;      // nullptr if never written
+    Page* writable(uint32_t page);        // allocates or unshares
+    void check(uint32_t byte_addr, const char* op) const;
+    void fill_tlb(uint32_t page, Page* p) const;
+    void release();
+
+    size_t words_{0};
+    std::vector<std::unique_ptr<Page*[]>> tables_;
+    mutable uint32_t tlb_base_{kNoPage};
+    mutable Page* tlb_page_{&zero_page_};
+};
+
+class ThreadedCode;      // mips_threaded.h
+class SuperblockCache;   // mips_superblock.h
+class TraceWriter;       // mips_trace.h
+
+// Execution engine used by MIPSPipeline::fastForward()
+enum class FFEngine {
+    Interpreter,   // one execute() call per instruction
+    Threaded,      // direct-threaded translation (mips_threaded.cpp)
+    Superblock     // chained basic blocks (mips_superblock.cpp)
 };
 
 // Main pipeline class - needed by main.cpp
 class MIPSPipeline {
 public:
+    // Copies `program`.
     MIPSPipeline(const std::vector<Instruction>& program,
                  size_t memory_words = (1u << 16),
                  bool trace = false);
+    // Uses `program` in place (e.g. mapped from a program cache); it must
+    // outlive the pipeline.
+    MIPSPipeline(ProgramView program,
+                 size_t memory_words = (1u << 16),
+                 bool trace = false);
 
-    void run();
+    // Steps until HALT retires, or until at least max_cycles cycles have
+    // been simulated (an event skip, or stage threads learning of a miss
+    // late, can carry it a little past the limit).
+    void run(uint64_t max_cycles = UINT64_MAX);
     void step();
     bool isHalted() const;
 
+    // ID normally indexes the load-time micro-op table; turning this off
+    // re-decodes every instruction as it enters ID and hands that decode
+    // down the pipeline with it, as the latches once carried Control (kept
+    // for benchmarking). Event skipping and stage threads need the table
+    // and are not used while it is off.
+    void setPredecode(bool on);
+
+    // Event skipping: when nothing in flight can branch, run() retires the
+    // in-flight instructions plus the following straight-line stretch
+    // (found by a static scan at load time) in one go and advances cycles_
+    // by exactly what step() would have taken. Final registers, memory and
+    // cycles() match the per-cycle run; ignored while tracing or with a
+    // cache model.
+    void setEventSkip(bool on);
+
+    // Stage threads (mips_parallel.cpp), experimental: run() moves MEM -
+    // memory accesses, the L1D and the L2 - to a second thread that works
+    // one cycle behind the other stages, the two trading latches through
+    // lock-free rings every cycle. Registers, memory, cycles, cache and
+    // predictor state all match the single-threaded loop. It only pays off
+    // when the cache model is expensive and a second core is idle; ignored
+    // with counters or tracing. A faulting load or store is rethrown at the
+    // end of its cycle.
+    void setStageThreads(bool on);
+
+    // Cache model (mips_cache.h). Every fetch goes through the L1I and
+    // every load/store through the L1D; a cycle whose accesses miss
+    // freezes all five stages until the slowest one completes. Without a
+    // model (the default) both stages always take one cycle. Fast-forward
+    // bypasses the caches, and a restored snapshot starts them cold.
+    void setCaches(const CacheHierarchyConfig& cfg);
+    const CacheHierarchy& caches() const;
+
+    // Branch prediction in IF (mips_branch.h). The default predicts never
+    // taken, which is the original resolve-in-MEM behaviour; a restored
+    // snapshot starts the predictor untrained.
+    void setBranchPredictor(const PredictorConfig& cfg);
+    const BranchPredictor& branchPredictor() const;
+
+    // Performance counters (mips_counters.h). Off by default, and then
+    // step() runs without a single counting instruction; turning them on
+    // disables event skipping.
+    void setCounters(bool on);
+    // Per-PC profile (mips_profile.h) in counters().profile; implies
+    // counting. Turning it on clears the profile.
+    void setProfile(bool on);
+    const PerfCounters& counters() const;
+
+    // Write a binary per-cycle trace (mips_trace.h) to `path`. Independent
+    // of the text trace selected by the constructor's `trace` flag.
+    void setTraceFile(const std::string& path);
+    // Flushes and closes that file, throwing if any of it could not be
+    // written (left to the destructor, a failure goes unreported).
+    void closeTraceFile();
+
+    // Functional fast-forward (mips_iss.cpp). Drains whatever is in flight,
+    // then executes one instruction per iteration on the same regs_/mem_
+    // until max_instrs have run, the next PC is stop_pc, or HALT retires.
+    // The latches are left empty, so the following step() refills the
+    // pipeline from pc_. Returns the number of instructions executed.
+    static constexpr uint32_t kNoStopPC = 0xFFFFFFFFu;
+    uint64_t fastForward(uint64_t max_instrs, uint32_t stop_pc = kNoStopPC);
+    uint64_t fastForwarded() const;   // total across all fastForward() calls
+    // fastForward() with functional warming: every fetch, load and store
+    // still goes through the cache model, and every branch and jump is
+    // predicted and resolved, so both are warm when detailed simulation
+    // resumes (their counters include these accesses; no stall cycles are
+    // added). Always interprets, at a fraction of the threaded speed.
+    uint64_t fastForwardWarm(uint64_t max_instrs);
+    void setFastForwardEngine(FFEngine engine);
+    // Pipeline cycles the superblock engine's fast-forwarded stream would
+    // have taken, replayed from its per-block stall summaries (0 when
+    // another engine was used).
+    uint64_t fastForwardCycleEstimate() const;
+    uint32_t pc() const;
+
+    // Snapshots (mips_snapshot.cpp).
+    //
+    // fork() clones the simulator mid-run: registers, latches and counters
+    // are copied, the program and its decoded tables are shared, and memory
+    // pages are shared copy-on-write, so the cost is independent of the
+    // memory in use. The clone starts without translated fast-forward code
+    // or a binary trace file of its own.
+    MIPSPipeline fork() const;
+
+    // Writes regs_, mem_, pc_, cycles_, the four latches and the run flags
+    // to a binary snapshot file. With `parent` (an earlier fork() of the
+    // same run), only memory pages changed since the parent are stored.
+    // Throws std::runtime_error on I/O failure.
+    void saveSnapshot(const std::string& path,
+                      const MIPSPipeline* parent = nullptr) const;
+    // Restores a snapshot of a pipeline running the same program. An
+    // incremental snapshot applies on top of its parent's state, which must
+    // be the current state (restore the parent first). Throws
+    // std::runtime_error on a mismatched or damaged file.
+    void loadSnapshot(const std::string& path);
+    // Hash of everything a snapshot holds; equal states hash equal.
+    uint64_t stateHash() const;
+
     // Public members (accessed directly by main.cpp)
     RegFile regs_;
     WordMemory mem_;
+    int32_t hi_{0}, lo_{0};   // multiply/divide results (MFHI/MFLO)
     
     // Public accessor
     uint64_t cycles() const;
 
 private:
-    std::vector<Instruction> prog_;
+    // Backs prog_ when the program was copied in; shared so that copies of
+    // the pipeline keep a valid view. Null for a borrowed program.
+    std::shared_ptr<const std::vector<Instruction>> owned_prog_;
+    ProgramView prog_;
     uint32_t pc_{0};
     uint64_t cycles_{0};
     bool trace_{false};
+    bool predecode_{true};
+    bool event_skip_{false};
+    bool stage_threads_{false};
     bool halted_{false};
-    bool last_retired_halt_{false};
-    Op curr_id_op_{Op::NOP};
+    bool fetch_enabled_{true};
+    uint64_t ff_instrs_{0};
+    uint64_t ff_cycle_base_{0};   // estimate carried over by fork()/snapshots
+    FFEngine ff_engine_{FFEngine::Interpreter};
+    std::shared_ptr<ThreadedCode> threaded_;   // translated on first use
+    std::shared_ptr<SuperblockCache> superblocks_;
+    std::shared_ptr<TraceWriter> trace_out_;
+    CacheHierarchy caches_;   // disabled unless setCaches()
+    BranchPredictor bp_;
+    bool count_{false};
+    PerfCounters counters_;
     
     // Internal structures (full definitions needed for member access)
 public:
@@ -62,61 +309,227 @@ public:
         bool Jump{false};
         bool ALUSrc{false};
         bool RegDst{false};
-        uint8_t ALUOp{0};
+        AluOp ALUOp{AluOp::Add};
         bool isNOP{true};
+        bool Indirect{false};     // JR/JALR: the target is rs
+        bool HiLo{false};         // MULT/DIV/MFHI/...: the HI/LO unit in EX
+        bool MemSigned{false};    // LB/LH sign-extend
+        uint8_t MemBytes{0};      // load/store width
+        Cond BranchCond{Cond::Eq};
     };
-    
-    static Control nop_ctrl() {
+
+    // One prog_ entry decoded once at load time: control bits, the
+    // immediate EX actually consumes and the resolved destination.
+    struct MicroOp {
         Control c{};
-        c.isNOP = true;
-        return c;
-    }
+        Op op{Op::NOP};
+        uint8_t rs{0}, rt{0}, rd{0};
+        uint8_t dest{0};     // RegDst ? rd : rt, $31 for JAL
+        int32_t imm{0};      // the immediate as ImmKind says, or the
+                             // return address of a linking jump
+        uint32_t target{0};  // taken branch / J / JAL destination
+    };
+
+    // Control comes straight from kOpInfo (mips_ir.hpp), turned into
+    // Control once at compile time. `pc` is where `ins` sits, for branch
+    // and jump targets and the link address.
+    static MicroOp predecode(const Instruction& ins, uint32_t pc);
+
+    // The load-time micro-op table, indexed by pc / 4, with branch and
+    // jump targets resolved (used by LockstepLanes, mips_lanes.h).
+    const std::vector<MicroOp>& microOps() const;
 
 private:
     
+    // Latches hold only a PC plus the values computed so far; everything
+    // static about the instruction is looked up in uops_[pc / 4].  Keeping
+    // them small and trivially copyable makes committing a cycle (and
+    // holding IF/ID across a stall) a handful of register-sized moves.
+    // pred_taken is IF's prediction for a branch/jump, checked in MEM.
     struct IF_ID {
-        Instruction instr{};
         uint32_t pc{0};
         bool valid{false};
+        bool pred_taken{false};
     };
     
     struct ID_EX {
-        Control c{};
         uint32_t pc{0};
         int32_t rs_val{0}, rt_val{0};
-        uint8_t rs{0}, rt{0}, rd{0};
-        int32_t imm{0};
         bool valid{false};
-        bool is_halt{false};  // Track if this instruction is a HALT
+        bool pred_taken{false};
     };
     
     struct EX_MEM {
-        Control c{};
+        uint32_t pc{0};
         int32_t alu_out{0};
         int32_t rt_val_forwarded{0};
         uint8_t dest{0};
         bool branch_taken{false};
-        uint32_t branch_target{0};
         bool valid{false};
-        bool is_halt{false};  // Track if this instruction is a HALT
+        bool pred_taken{false};
     };
     
     struct MEM_WB {
-        Control c{};
+        uint32_t pc{0};
         int32_t mem_data{0};
         int32_t alu_out{0};
         uint8_t dest{0};
         bool valid{false};
-        bool is_halt{false};  // Track if this instruction is a HALT
     };
-    
+
+    static_assert(std::is_trivially_copyable_v<IF_ID>  && sizeof(IF_ID)  <= 16);
+    static_assert(std::is_trivially_copyable_v<ID_EX>  && sizeof(ID_EX)  <= 16);
+    static_assert(std::is_trivially_copyable_v<EX_MEM> && sizeof(EX_MEM) <= 16);
+    static_assert(std::is_trivially_copyable_v<MEM_WB> && sizeof(MEM_WB) <= 16);
+
+    // Stand-in for an empty latch: nop control, never a HALT.
+    static const MicroOp kBubble;
+
+public:
+    // ALU, branch, HI/LO and memory semantics shared by EX/MEM and the
+    // functional engines. a/b are the (forwarded) rs/rt values.
+    static int32_t alu(const MicroOp& u, int32_t a, int32_t b) {
+        int32_t rhs = u.c.ALUSrc ? u.imm : b;
+        switch (u.c.ALUOp) {
+            case AluOp::Add:  return a + rhs;       // also addresses, LUI
+            case AluOp::Sub:  return a - rhs;
+            case AluOp::And:  return a & rhs;
+            case AluOp::Or:   return a | rhs;
+            case AluOp::Xor:  return a ^ rhs;
+            case AluOp::Nor:  return ~(a | rhs);
+            case AluOp::Slt:  return (a < rhs) ? 1 : 0;
+            case AluOp::Sltu: return ((uint32_t)a < (uint32_t)rhs) ? 1 : 0;
+            case AluOp::Mul:  return a * b;
+            case AluOp::Sll:  return (int32_t)((uint32_t)b << (u.imm & 31));
+            case AluOp::Srl:  return (int32_t)((uint32_t)b >> (u.imm & 31));
+            case AluOp::Sra:  return b >> (u.imm & 31);
+            case AluOp::Sllv: return (int32_t)((uint32_t)b << (a & 31));
+            case AluOp::Srlv: return (int32_t)((uint32_t)b >> (a & 31));
+            case AluOp::Srav: return b >> (a & 31);
+            case AluOp::Link: return u.imm;
+        }
+        return 0;
+    }
+
+    static bool branch_outcome(const MicroOp& u, int32_t a, int32_t b) {
+        switch (u.c.BranchCond) {
+            case Cond::Eq:  return a == b;
+            case Cond::Ne:  return a != b;
+            case Cond::Lez: return a <= 0;
+            case Cond::Gtz: return a > 0;
+            case Cond::Ltz: return a < 0;
+            case Cond::Gez: return a >= 0;
+        }
+        return false;
+    }
+
+    // The multiply/divide unit: MULT/DIV/MTHI/MTLO update hi/lo, MFHI and
+    // MFLO return one of them. Division by zero leaves both unchanged
+    // (the result is unpredictable on MIPS32).
+    static int32_t hilo(Op op, int32_t a, int32_t b, int32_t& hi, int32_t& lo) {
+        switch (op) {
+            case Op::MULT: {
+                int64_t p = int64_t(a) * b;
+                lo = static_cast<int32_t>(p);
+                hi = static_cast<int32_t>(p >> 32);
+                break;
+            }
+            case Op::MULTU: {
+                uint64_t p = uint64_t(uint32_t(a)) * uint32_t(b);
+                lo = static_cast<int32_t>(p);
+                hi = static_cast<int32_t>(p >> 32);
+                break;
+            }
+            case Op::DIV:
+                if (b == 0) break;
+                if (b == -1) {   // INT32_MIN / -1 wraps
+                    lo = static_cast<int32_t>(0u - uint32_t(a));
+                    hi = 0;
+                } else {
+                    lo = a / b;
+                    hi = a % b;
+                }
+                break;
+            case Op::DIVU:
+                if (b == 0) break;
+                lo = static_cast<int32_t>(uint32_t(a) / uint32_t(b));
+                hi = static_cast<int32_t>(uint32_t(a) % uint32_t(b));
+                break;
+            case Op::MTHI: hi = a; break;
+            case Op::MTLO: lo = a; break;
+            case Op::MFHI: return hi;
+            case Op::MFLO: return lo;
+            default: break;
+        }
+        return 0;
+    }
+
+    // A load's value, sign- or zero-extended; a store of rt's low bytes.
+    static int32_t load(const MicroOp& u, const WordMemory& m, uint32_t addr) {
+        if (u.c.MemBytes == 4) return m.load_word(addr);
+        uint32_t v = m.load_sub(addr, u.c.MemBytes);
+        if (!u.c.MemSigned) return static_cast<int32_t>(v);
+        return u.c.MemBytes == 1 ? int32_t(int8_t(v)) : int32_t(int16_t(v));
+    }
+    static void store(const MicroOp& u, WordMemory& m, uint32_t addr, int32_t v) {
+        if (u.c.MemBytes == 4) m.store_word(addr, v);
+        else m.store_sub(addr, u.c.MemBytes, static_cast<uint32_t>(v));
+    }
+
+private:
+
+    void load_program();   // builds uops_ and the skip tables from prog_
+
+    // Fixed-layout image of everything but memory (mips_snapshot.cpp).
+    struct SnapshotState;
+    SnapshotState capture_state() const;
+    void restore_state(const SnapshotState& st);
+    template <class Counters> void step_cycle();
+    template <class Counters> void run_cycles(uint64_t max_cycles, bool skip);
+    void drain();
+    uint32_t execute(const MicroOp& u, uint32_t pc);
+    void skip_hazard_free();
+    void run_stage_threads(uint64_t max_cycles);
+
+    // Pipeline stalls one cycle when a load's rt is read by the very next
+    // instruction (same rule as the hazard unit in step()).
+    static bool load_use(const MicroOp& ld, const MicroOp& next) {
+        return ld.c.MemRead && ld.rt != 0 &&
+               (ld.rt == next.rs || ld.rt == next.rt);
+    }
+
+    // Everything derived from prog_ at load time. Never modified after
+    // the constructor, so copies of the pipeline (fork()) share it.
+    struct Decoded {
+        std::vector<MicroOp> uops;   // parallel to prog_, indexed by pc / 4
+
+        // Static scan for event skipping, both indexed by pc / 4:
+        // straight[i]  - branch/jump/HALT-free instructions starting at i
+        // lu_before[i] - load-use pairs (j-1, j) with j < i
+        std::vector<uint32_t> straight;
+        std::vector<uint32_t> lu_before;
+
+        uint64_t program_hash{0};    // identifies prog_ in snapshots
+    };
+    std::shared_ptr<const Decoded> decoded_;
+
+    // Plain aliases into *decoded_ for the hot paths.
+    const MicroOp* uops_{nullptr};
+    size_t n_uops_{0};
+    const uint32_t* straight_{nullptr};
+    const uint32_t* lu_before_{nullptr};
+
     IF_ID if_id_{};
     ID_EX id_ex_{};
     EX_MEM ex_mem_{};
     MEM_WB mem_wb_{};
-    
-    std::tuple<Control, int32_t, int32_t> decode_in_id(const Instruction& ins);
-    void dump_trace_line() const;
+
+    // With predecode_ off: what ID decoded for the instruction in each
+    // latch, moved along at every commit.
+    MicroOp id_ex_op_{}, ex_mem_op_{}, mem_wb_op_{};
+    void redecode_in_flight();
+
+    void dump_trace_line(uint8_t flags, uint8_t wb_reg, int32_t wb_value) const;
 };
 
 #endif // MIPS_PIPELINE_H
@@ -0,0 +1,75 @@
+// mips_profile.cpp
+// Annotated hotspot listing of a PcProfile.
+
+#include "mips_profile.h"
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+#include <ostream>
+
+using namespace std;
+
+namespace {
+
+vector<string_view> split_lines(string_view source) {
+    vector<string_view> out;
+    while (!source.empty()) {
+        size_t nl = source.find('\n');
+        string_view line = source.substr(0, nl);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        out.push_back(line);
+        source.remove_prefix(nl == string_view::npos ? source.size() : nl + 1);
+    }
+    return out;
+}
+
+string_view trim(string_view s) {
+    size_t b = s.find_first_not_of(" \t");
+    return b == string_view::npos ? string_view() : s.substr(b);
+}
+
+} // namespace
+
+void PcProfile::report(ostream& os, ProgramView prog, string_view source,
+                       const vector<uint32_t>& lines, size_t top) const {
+    uint64_t total = accumulate(counts_.begin(), counts_.end(), uint64_t(0),
+                                [](uint64_t s, const PcCounts& c) { return s + c.cycles; });
+    vector<uint32_t> rows;
+    for (uint32_t i = 0; i < counts_.size(); ++i)
+        if (counts_[i].cycles || counts_[i].executions) rows.push_back(i);
+    stable_sort(rows.begin(), rows.end(), [&](uint32_t a, uint32_t b) {
+        return counts_[a].cycles > counts_[b].cycles;
+    });
+    if (rows.size() > top) rows.resize(top);
+
+    vector<string_view> text = split_lines(source);
+    bool have_lines = lines.size() == prog.size && !text.empty();
+
+    // the caller's stream may be left-aligned or zero-filled
+    ios::fmtflags flags = os.flags();
+    char fill = os.fill(' ');
+    os << right << "Profile: " << total << " cycles over " << prog.size
+       << " instructions, hottest first\n"
+       << "    cycles      %   miss  stalls flushes      execs        pc  "
+       << (have_lines ? "line  source" : "instruction") << "\n";
+    for (uint32_t i : rows) {
+        const PcCounts& c = counts_[i];
+        os << setw(10) << c.cycles << setw(6) << fixed << setprecision(1)
+           << (total ? 100.0 * c.cycles / total : 0.0) << '%' << setw(7)
+           << c.miss_cycles << setw(8) << c.stalls << setw(8) << c.flushes
+           << setw(11) << c.executions << defaultfloat;
+        if (i == counts_.size() - 1) {
+            os << "         -  (outside the program)\n";
+            continue;
+        }
+        os << "  0x" << hex << setw(6) << setfill('0') << i * 4 << dec
+           << setfill(' ') << "  ";
+        if (have_lines && lines[i] - 1 < text.size())
+            os << setw(4) << lines[i] << "  " << trim(text[lines[i] - 1]) << "\n";
+        else
+            os << prog[i].str() << "\n";
+    }
+    os.flags(flags);
+    os.fill(fill);
+    os << setprecision(6);
+}
@@ -0,0 +1,58 @@
+// mips_profile.h
+#ifndef MIPS_PROFILE_H
+#define MIPS_PROFILE_H
+
+#include "mips_ir.hpp"
+#include <cstdint>
+#include <iosfwd>
+#include <string_view>
+#include <vector>
+
+// Per-instruction hotspot profile, filled by the ProfileEvents counter
+// policy (mips_counters.h) while MIPSPipeline runs.
+//
+// One PcCounts per instruction in a flat array indexed by pc / 4, plus a
+// last slot for PCs outside the program (fetch running past the end), so
+// charging an event is an index and an add.
+
+struct PcCounts {
+    uint64_t cycles{0};        // cycles charged to the instruction
+    uint64_t miss_cycles{0};   // of those, frozen on its cache misses
+    uint64_t stalls{0};        // load-use stall cycles it waited in ID
+    uint64_t flushes{0};       // times it redirected fetch (branches/J)
+    uint64_t executions{0};    // times it retired
+};
+
+class PcProfile {
+public:
+    // Stands for an empty EX stage in ProfileEvents::cycle(); never a PC.
+    static constexpr uint32_t kBubble = 0xFFFFFFFFu;
+
+    // Sizes the table for `instructions` and clears it.
+    void reset(size_t instructions) {
+        counts_.assign(instructions + 1, PcCounts{});
+        blame = 0;
+    }
+    bool empty() const { return counts_.empty(); }
+
+    PcCounts& at(uint32_t pc) {
+        size_t i = pc / 4;
+        return counts_[i < counts_.size() - 1 ? i : counts_.size() - 1];
+    }
+    const std::vector<PcCounts>& counts() const { return counts_; }
+
+    // Annotated listing, hottest first: cycle share, stalls, flushes and
+    // executions next to each instruction's source line. `lines[i]` is
+    // the 1-based line in `source` of prog[i]; without them (binary or
+    // cached programs) the mnemonic is shown instead. At most `top` rows.
+    void report(std::ostream& os, ProgramView prog, std::string_view source,
+                const std::vector<uint32_t>& lines, size_t top) const;
+
+    // Who an empty EX is charged to next cycle (see ProfileEvents).
+    uint32_t blame{0};
+
+private:
+    std::vector<PcCounts> counts_;
+};
+
+#endif // MIPS_PROFILE_H
@@ -0,0 +1,96 @@
+// mips_program_cache.cpp
+// Versioned, memory-mappable cache of assembled programs.
+
+#include "mips_program_cache.h"
+#include "mips_assembler.h"
+#include "mips_hash.h"
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+using namespace std;
+
+static_assert(sizeof(ProgramCacheHeader) % 16 == 0);
+
+static uint64_t align16(uint64_t n) {
+    return (n + 15) & ~uint64_t(15);
+}
+
+uint64_t hashSource(string_view s) {
+    return hash64(s.data(), s.size());
+}
+
+string programCachePath(const string& source_path) {
+    return source_path + ".pcache";
+}
+
+bool ProgramCache::open(const string& cache_path, string_view source) {
+    try {
+        file_ = make_unique<MappedFile>(cache_path);
+    } catch (const exception&) {
+        return false;   // no cache yet
+    }
+
+    string_view image = file_->text();
+    ProgramCacheHeader h;
+    if (image.size() < sizeof h) return false;
+    memcpy(&h, image.data(), sizeof h);
+    if (memcmp(h.magic, kProgramCacheMagic, sizeof h.magic) != 0 ||
+        h.version != kProgramCacheVersion ||
+        h.instruction_size != sizeof(Instruction) ||
+        h.source_size != source.size() ||
+        h.source_hash != hashSource(source))
+        return false;
+
+    auto fits = [&](uint64_t off, uint64_t count, size_t elem) {
+        return off % 16 == 0 && off <= image.size() &&
+               count <= (image.size() - off) / elem;
+    };
+    if (!fits(h.text_offset, h.text_size, sizeof(Instruction)) ||
+        !fits(h.data_offset, h.data_size, sizeof(int32_t)))
+        return false;
+    // the mapping is page aligned; a read-in fallback buffer might not be
+    if (reinterpret_cast<uintptr_t>(image.data()) % alignof(Instruction) != 0)
+        return false;
+
+    text_ = ProgramView(
+        reinterpret_cast<const Instruction*>(image.data() + h.text_offset),
+        static_cast<size_t>(h.text_size));
+    data_ = reinterpret_cast<const int32_t*>(image.data() + h.data_offset);
+    data_words_ = static_cast<size_t>(h.data_size);
+    return true;
+}
+
+void ProgramCache::write(const string& cache_path, string_view source,
+                         const AssembledProgram& program) {
+    ProgramCacheHeader h{};
+    memcpy(h.magic, kProgramCacheMagic, sizeof h.magic);
+    h.version          = kProgramCacheVersion;
+    h.instruction_size = sizeof(Instruction);
+    h.source_hash      = hashSource(source);
+    h.source_size      = source.size();
+    h.text_offset      = sizeof h;
+    h.text_size        = program.text.size();
+    h.data_offset      = align16(h.text_offset + h.text_size * sizeof(Instruction));
+    h.data_size        = program.data.size();
+
+    string tmp = cache_path + ".tmp" + to_string(random_device{}());
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) throw runtime_error("Cannot write program cache " + cache_path);
+
+    static const char zeros[16] = {};
+    uint64_t text_end = h.text_offset + h.text_size * sizeof(Instruction);
+    bool ok =
+        fwrite(&h, sizeof h, 1, f) == 1 &&
+        fwrite(program.text.data(), sizeof(Instruction), program.text.size(), f) ==
+            program.text.size() &&
+        fwrite(zeros, 1, h.data_offset - text_end, f) == h.data_offset - text_end &&
+        fwrite(program.data.data(), sizeof(int32_t), program.data.size(), f) ==
+            program.data.size();
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp.c_str(), cache_path.c_str()) != 0) {
+        remove(tmp.c_str());
+        throw runtime_error("Cannot write program cache " + cache_path);
+    }
+}
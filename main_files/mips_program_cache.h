@@ -0,0 +1,69 @@
+// mips_program_cache.h
+#ifndef MIPS_PROGRAM_CACHE_H
+#define MIPS_PROGRAM_CACHE_H
+
+#include "mips_ir.hpp"
+#include "mips_lexer.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+struct AssembledProgram;   // mips_assembler.h
+
+// Pre-assembled program cache, stored next to the source as
+// "<source>.pcache" so that a warm start skips the assembler entirely.
+//
+// File layout (host byte order, every section 16-byte aligned):
+//   ProgramCacheHeader
+//   Instruction[text_size]   mapped and handed to MIPSPipeline in place
+//   int32_t[data_size]       initial .data image
+//
+// A cache is only used if its magic, version, Instruction layout and the
+// hash and size of the source it was built from all match; anything else
+// (missing, stale, truncated, from another host) is treated as a miss.
+constexpr char     kProgramCacheMagic[8] = {'M', 'I', 'P', 'S', 'P', 'C', 'H', '\0'};
+// Bump whenever the assembler would produce different output for the same
+// source, so existing caches are rebuilt.
+constexpr uint32_t kProgramCacheVersion  = 2;
+
+struct ProgramCacheHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t instruction_size;   // sizeof(Instruction)
+    uint64_t source_hash;
+    uint64_t source_size;
+    uint64_t text_offset, text_size;   // byte offset, instruction count
+    uint64_t data_offset, data_size;   // byte offset, word count
+};
+
+// 64-bit content hash of a source file (not cryptographic).
+uint64_t hashSource(std::string_view source);
+
+std::string programCachePath(const std::string& source_path);
+
+class ProgramCache {
+public:
+    // Maps `cache_path` and validates it against `source`. Returns false on
+    // any mismatch; the cache is then simply not used.
+    bool open(const std::string& cache_path, std::string_view source);
+
+    ProgramView text() const { return text_; }
+    const int32_t* data() const { return data_; }
+    size_t dataWords() const { return data_words_; }
+
+    // Writes a cache for `program` assembled from `source`. The file is
+    // written under a temporary name and renamed into place, so concurrent
+    // runs never see a partial cache. Throws std::runtime_error on I/O
+    // failure.
+    static void write(const std::string& cache_path, std::string_view source,
+                      const AssembledProgram& program);
+
+private:
+    std::unique_ptr<MappedFile> file_;
+    ProgramView text_;
+    const int32_t* data_{nullptr};
+    size_t data_words_{0};
+};
+
+#endif // MIPS_PROGRAM_CACHE_H
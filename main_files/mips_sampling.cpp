@@ -0,0 +1,447 @@
+// mips_sampling.cpp
+// Sampled simulation: SMARTS-style systematic sampling and SimPoint-style
+// representative intervals over the functional fast-forward engines.
+
+#include "mips_sampling.h"
+#include "mips_hash.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+[[noreturn]] void bad_spec(string_view spec, const string& what) {
+    throw invalid_argument("sampling spec '" + string(spec) + "': " + what);
+}
+
+// Decimal count with an optional k/m/g suffix (thousands, not KiB).
+uint64_t parse_count(string_view spec, string_view v) {
+    uint64_t scale = 1;
+    if (!v.empty() && (v.back() == 'k' || v.back() == 'K')) scale = 1000;
+    if (!v.empty() && (v.back() == 'm' || v.back() == 'M')) scale = 1000000;
+    if (!v.empty() && (v.back() == 'g' || v.back() == 'G')) scale = 1000000000;
+    if (scale != 1) v.remove_suffix(1);
+    if (v.empty()) bad_spec(spec, "missing number");
+    uint64_t x = 0;
+    for (char c : v) {
+        if (c < '0' || c > '9' || x > UINT64_MAX / 100)
+            bad_spec(spec, "bad number '" + string(v) + "'");
+        x = x * 10 + (c - '0');
+    }
+    if (x > UINT64_MAX / scale) bad_spec(spec, "value too large");
+    return x * scale;
+}
+
+// A fraction in (0, 1).
+double parse_fraction(string_view spec, string_view v) {
+    string s(v);
+    size_t used = 0;
+    double x = 0.0;
+    try {
+        x = stod(s, &used);
+    } catch (const exception&) {
+        used = 0;
+    }
+    if (used != s.size() || !(x > 0.0 && x < 1.0))
+        bad_spec(spec, "expected a number between 0 and 1, got '" + s + "'");
+    return x;
+}
+
+// Two-sided normal quantile: z with P(|Z| < z) = confidence (Abramowitz
+// and Stegun 26.2.23, good to 4.5e-4).
+double z_for(double confidence) {
+    double p = (1.0 - confidence) / 2.0;
+    double t = sqrt(-2.0 * log(p));
+    return t - (2.515517 + 0.802853 * t + 0.010328 * t * t) /
+               (1.0 + 1.432788 * t + 0.189269 * t * t + 0.001308 * t * t * t);
+}
+
+// Where the run stands: instructions executed so far (fast-forwarded, or
+// retired by the pipeline) and detailed cycles, from p's own counters.
+class Progress {
+public:
+    explicit Progress(const MIPSPipeline& p)
+        : p_(p), ff0_(p.fastForwarded()), retired0_(p.counters().retired),
+          cycles0_(p.counters().cycles) {}
+
+    uint64_t executed() const { return fastForwarded() + retired(); }
+    uint64_t fastForwarded() const { return p_.fastForwarded() - ff0_; }
+    uint64_t retired() const { return p_.counters().retired - retired0_; }
+    uint64_t cycles() const { return p_.counters().cycles - cycles0_; }
+
+private:
+    const MIPSPipeline& p_;
+    uint64_t ff0_, retired0_, cycles0_;
+};
+
+bool left_program(const MIPSPipeline& p) {
+    return p.pc() % 4 != 0 || p.pc() / 4 >= p.microOps().size();
+}
+
+struct Stretch {
+    uint64_t retired{0};
+    uint64_t cycles{0};
+};
+
+// Steps until n more instructions retire, HALT retires, or control has
+// left the program and the pipeline ran dry.
+Stretch detailed(MIPSPipeline& p, uint64_t n) {
+    const PerfCounters& c = p.counters();
+    uint64_t r0 = c.retired, c0 = c.cycles;
+    // a pipeline holds at most four instructions, so this many empty
+    // cycles in a row with nothing left to fetch means it drained
+    constexpr unsigned kDry = 8;
+    unsigned idle = 0;
+    while (!p.isHalted() && c.retired - r0 < n && idle < kDry) {
+        uint64_t before = c.retired;
+        p.step();
+        idle = (c.retired == before && left_program(p)) ? idle + 1 : 0;
+    }
+    return {c.retired - r0, c.cycles - c0};
+}
+
+// Fast-forwards n instructions, the last `warm` of them with functional
+// warming; false if the program stopped first.
+bool skip(MIPSPipeline& p, uint64_t n, uint64_t warm) {
+    uint64_t cold = n > warm ? n - warm : 0;
+    if (cold && p.fastForward(cold) != cold) return false;
+    return n == cold || p.fastForwardWarm(n - cold) == n - cold;
+}
+
+double sq_dist(const double* a, const double* b, uint32_t dims) {
+    double d = 0.0;
+    for (uint32_t i = 0; i < dims; ++i) d += (a[i] - b[i]) * (a[i] - b[i]);
+    return d;
+}
+
+// xorshift64*, for k-means++ seeding
+struct Rng {
+    uint64_t s;
+    double next() {
+        s ^= s >> 12;
+        s ^= s << 25;
+        s ^= s >> 27;
+        return double((s * 0x2545F4914F6CDD1Dull) >> 11) * 0x1.0p-53;
+    }
+};
+
+// One profiled interval of the SimPoint pass.
+struct Interval {
+    uint64_t start{0};   // instructions executed before it
+    uint64_t size{0};
+    uint32_t cluster{0};
+};
+
+// Weighted k-means (k-means++ seeding, Lloyd iterations) over `x`, one
+// row of `dims` per interval; sets every interval's cluster and returns
+// the centres.
+vector<double> kmeans(vector<Interval>& iv, const vector<double>& x,
+                      uint32_t dims, uint32_t k, uint64_t seed) {
+    size_t n = iv.size();
+    Rng rng{seed * 0x9E3779B97F4A7C15ull | 1};
+    vector<double> centre(size_t(k) * dims);
+    vector<double> d2(n, numeric_limits<double>::max());
+
+    // first centre: the largest interval; then each further one with
+    // probability proportional to weight times squared distance
+    size_t first = 0;
+    for (size_t i = 1; i < n; ++i)
+        if (iv[i].size > iv[first].size) first = i;
+    copy_n(&x[first * dims], dims, &centre[0]);
+    for (uint32_t c = 1; c < k; ++c) {
+        double total = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            d2[i] = min(d2[i], sq_dist(&x[i * dims], &centre[(c - 1) * dims], dims));
+            total += d2[i] * double(iv[i].size);
+        }
+        size_t pick = 0;
+        if (total > 0.0) {
+            double r = rng.next() * total;
+            for (pick = 0; pick + 1 < n; ++pick) {
+                r -= d2[pick] * double(iv[pick].size);
+                if (r <= 0.0) break;
+            }
+        }
+        copy_n(&x[pick * dims], dims, &centre[size_t(c) * dims]);
+    }
+
+    constexpr int kMaxIterations = 100;
+    vector<double> sum(centre.size());
+    vector<double> weight(k);
+    for (int it = 0; it < kMaxIterations; ++it) {
+        bool moved = false;
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t best = 0;
+            double bd = numeric_limits<double>::max();
+            for (uint32_t c = 0; c < k; ++c) {
+                double d = sq_dist(&x[i * dims], &centre[size_t(c) * dims], dims);
+                if (d < bd) bd = d, best = c;
+            }
+            moved |= it == 0 || best != iv[i].cluster;
+            iv[i].cluster = best;
+        }
+        if (!moved) break;
+        fill(sum.begin(), sum.end(), 0.0);
+        fill(weight.begin(), weight.end(), 0.0);
+        for (size_t i = 0; i < n; ++i) {
+            double w = double(iv[i].size);
+            weight[iv[i].cluster] += w;
+            for (uint32_t d = 0; d < dims; ++d)
+                sum[size_t(iv[i].cluster) * dims + d] += w * x[i * dims + d];
+        }
+        for (uint32_t c = 0; c < k; ++c)   // an emptied centre stays put
+            if (weight[c] > 0.0)
+                for (uint32_t d = 0; d < dims; ++d)
+                    centre[size_t(c) * dims + d] = sum[size_t(c) * dims + d] / weight[c];
+    }
+    return centre;
+}
+
+SampleEstimate run_smarts(MIPSPipeline& p, const SamplingConfig& cfg,
+                          uint64_t max_instrs) {
+    SampleEstimate est;
+    Progress at(p);
+    double sum = 0.0, sum_sq = 0.0;
+    uint64_t gap = cfg.interval - cfg.warmup - cfg.window;
+    while (!p.isHalted() && at.executed() < max_instrs) {
+        uint64_t left = max_instrs - at.executed();
+        if (!skip(p, min(gap, left), cfg.warm) || left <= gap) break;
+        Stretch warm = detailed(p, min(cfg.warmup, max_instrs - at.executed()));
+        if (warm.retired < cfg.warmup) break;
+        if (max_instrs - at.executed() < cfg.window) break;
+        Stretch w = detailed(p, cfg.window);
+        if (w.retired < cfg.window) break;   // cut short by HALT
+        double cpi = double(w.cycles) / double(w.retired);
+        sum += cpi;
+        sum_sq += cpi * cpi;
+        ++est.samples;
+    }
+    if (!p.isHalted() && at.executed() < max_instrs)
+        skip(p, max_instrs - at.executed(), 0);
+
+    est.instructions    = at.executed();
+    est.detailed        = at.retired();
+    est.detailed_cycles = at.cycles();
+    if (est.samples) {
+        double n = double(est.samples);
+        est.cpi = sum / n;
+        if (est.samples > 1) {
+            double var = max(0.0, (sum_sq - sum * sum / n) / (n - 1.0));
+            est.cpi_stddev = sqrt(var);
+        }
+        double z = z_for(cfg.confidence);
+        est.half_width = z * est.cpi_stddev / sqrt(n);
+        double need = z * est.cpi_stddev / (cfg.target_error * est.cpi);
+        est.samples_needed = max<uint64_t>(1, uint64_t(ceil(need * need)));
+    } else if (est.detailed) {
+        // shorter than one interval: all there is are the warmups
+        est.cpi = double(est.detailed_cycles) / double(est.detailed);
+    }
+    return est;
+}
+
+SampleEstimate run_simpoint(MIPSPipeline& p, const SamplingConfig& cfg,
+                            uint64_t max_instrs) {
+    SampleEstimate est;
+    const vector<MIPSPipeline::MicroOp>& uops = p.microOps();
+    size_t n_uops = uops.size();
+    uint32_t dims = cfg.dims;
+
+    // Instructions from each PC to the end of its basic block, and each
+    // PC's random direction: a block is keyed by where it was entered.
+    vector<uint32_t> block(n_uops);
+    for (size_t i = n_uops; i-- > 0;) {
+        const MIPSPipeline::MicroOp& u = uops[i];
+        bool ends = u.c.Branch || u.c.Jump || u.op == Op::HALT || i + 1 == n_uops;
+        block[i] = ends ? 1 : block[i + 1] + 1;
+    }
+    vector<double> dir(n_uops * dims);
+    for (size_t i = 0; i < dir.size(); ++i) {
+        uint64_t h = hash64(&i, sizeof i, cfg.seed);
+        dir[i] = double(h >> 11) * 0x1.0p-52 - 1.0;   // [-1, 1)
+    }
+
+    // Profile on a fork, one block at a time. The projection is linear, so
+    // each interval's vector is summed directly in the projected space.
+    vector<Interval> iv;
+    vector<double> x;
+    {
+        MIPSPipeline q = p.fork();
+        Progress qa(q);   // counts what the first fastForward() drains too
+        uint64_t done = 0;
+        Interval cur;
+        vector<double> acc(dims, 0.0);
+        auto close = [&] {
+            iv.push_back(cur);
+            for (uint32_t d = 0; d < dims; ++d)
+                x.push_back(acc[d] / double(cur.size));
+            cur = {done, 0, 0};
+            fill(acc.begin(), acc.end(), 0.0);
+        };
+        while (!q.isHalted() && done < max_instrs && !left_program(q)) {
+            size_t b = q.pc() / 4;
+            uint64_t want = min<uint64_t>({block[b], cfg.interval - cur.size,
+                                           max_instrs - done});
+            uint64_t ran = q.fastForward(want);
+            uint64_t n = qa.executed() - done;
+            for (uint32_t d = 0; d < dims; ++d)
+                acc[d] += double(n) * dir[b * dims + d];
+            done += n;
+            cur.size += n;
+            if (cur.size >= cfg.interval) close();
+            if (ran < want) break;
+        }
+        if (cur.size) close();
+    }
+    est.intervals = iv.size();
+    if (iv.empty()) return est;
+
+    uint32_t k = uint32_t(min<size_t>(cfg.clusters, iv.size()));
+    vector<double> centre = kmeans(iv, x, dims, k, cfg.seed);
+
+    // each non-empty cluster's interval nearest its centre
+    vector<uint64_t> weight(k, 0);
+    vector<size_t> rep(k, SIZE_MAX);
+    vector<double> rep_d(k, numeric_limits<double>::max());
+    uint64_t total = 0;
+    for (size_t i = 0; i < iv.size(); ++i) {
+        uint32_t c = iv[i].cluster;
+        weight[c] += iv[i].size;
+        total += iv[i].size;
+        double d = sq_dist(&x[i * dims], &centre[size_t(c) * dims], dims);
+        if (d < rep_d[c]) rep_d[c] = d, rep[c] = i;
+    }
+    vector<pair<size_t, uint32_t>> order;   // (interval, cluster)
+    for (uint32_t c = 0; c < k; ++c)
+        if (rep[c] != SIZE_MAX) order.push_back({rep[c], c});
+    sort(order.begin(), order.end());
+
+    // Simulate the representatives in order of appearance.
+    Progress at(p);
+    for (auto [i, c] : order) {
+        const Interval& r = iv[i];
+        uint64_t from = r.start > cfg.warmup ? r.start - cfg.warmup : 0;
+        if (from > at.executed() && !skip(p, from - at.executed(), cfg.warm))
+            break;
+        if (r.start > at.executed()) detailed(p, r.start - at.executed());
+        if (p.isHalted()) break;
+        Stretch s = detailed(p, r.size);
+        SampleEstimate::Point pt;
+        pt.interval = i;
+        pt.weight   = double(weight[c]) / double(total);
+        pt.cpi      = s.retired ? double(s.cycles) / double(s.retired) : 0.0;
+        est.points.push_back(pt);
+        est.cpi += pt.weight * pt.cpi;
+        ++est.samples;
+    }
+    if (!p.isHalted() && at.executed() < max_instrs)
+        skip(p, max_instrs - at.executed(), 0);
+
+    est.instructions    = at.executed();
+    est.detailed        = at.retired();
+    est.detailed_cycles = at.cycles();
+    return est;
+}
+
+} // namespace
+
+SamplingConfig parseSamplingConfig(string_view spec) {
+    SamplingConfig cfg;
+    size_t comma = spec.find(',');
+    string_view mode = spec.substr(0, comma);
+    if (mode == "smarts")        cfg.mode = SampleMode::Smarts;
+    else if (mode == "simpoint") cfg.mode = SampleMode::SimPoint;
+    else bad_spec(spec, "mode must be smarts or simpoint");
+    if (cfg.mode == SampleMode::SimPoint) {
+        cfg.interval = 100000;
+        cfg.warmup   = 10000;
+    }
+
+    string_view rest =
+        comma == string_view::npos ? string_view() : spec.substr(comma + 1);
+    while (!rest.empty()) {
+        comma = rest.find(',');
+        string_view item = rest.substr(0, comma);
+        rest.remove_prefix(comma == string_view::npos ? rest.size() : comma + 1);
+
+        size_t eq = item.find('=');
+        if (eq == string_view::npos)
+            bad_spec(spec, "expected key=value, got '" + string(item) + "'");
+        string_view key = item.substr(0, eq), v = item.substr(eq + 1);
+        if (key == "interval")    cfg.interval     = parse_count(spec, v);
+        else if (key == "window") cfg.window       = parse_count(spec, v);
+        else if (key == "warmup") cfg.warmup       = parse_count(spec, v);
+        else if (key == "warm")   cfg.warm         = v == "all" ? UINT64_MAX
+                                                                : parse_count(spec, v);
+        else if (key == "conf")   cfg.confidence   = parse_fraction(spec, v);
+        else if (key == "error")  cfg.target_error = parse_fraction(spec, v);
+        else if (key == "k")      cfg.clusters     = uint32_t(min<uint64_t>(parse_count(spec, v), 1000));
+        else if (key == "dims")   cfg.dims         = uint32_t(min<uint64_t>(parse_count(spec, v), 1000));
+        else if (key == "seed")   cfg.seed         = parse_count(spec, v);
+        else bad_spec(spec, "unknown key '" + string(key) + "'");
+    }
+    if (cfg.interval == 0 || cfg.window == 0 || cfg.clusters == 0 || cfg.dims == 0)
+        bad_spec(spec, "interval, window, k and dims must be positive");
+    if (cfg.mode == SampleMode::Smarts && cfg.warmup + cfg.window > cfg.interval)
+        bad_spec(spec, "warmup + window must fit in the interval");
+    return cfg;
+}
+
+SampleEstimate runSampled(MIPSPipeline& p, const SamplingConfig& cfg,
+                          uint64_t max_instrs) {
+    p.setCounters(true);
+    SamplingConfig run = cfg;
+    const PredictorConfig& bp = p.branchPredictor().config();
+    if (!p.caches().enabled() && bp.kind == PredictorKind::NotTaken &&
+        bp.btb_entries == 0)
+        run.warm = 0;   // nothing to warm: keep the fast engine
+    SampleEstimate est = run.mode == SampleMode::Smarts
+                             ? run_smarts(p, run, max_instrs)
+                             : run_simpoint(p, run, max_instrs);
+    est.config = cfg;
+    est.cycles = est.cpi * double(est.instructions);
+    return est;
+}
+
+void SampleEstimate::report(ostream& os) const {
+    double share = instructions ? 100.0 * double(detailed) / double(instructions) : 0.0;
+    os << fixed;
+    if (config.mode == SampleMode::Smarts)
+        os << "Sampled run (smarts): " << samples << " windows of "
+           << config.window << " instructions, one per " << config.interval << "\n";
+    else
+        os << "Sampled run (simpoint): " << samples << " of " << intervals
+           << " intervals of " << config.interval << " instructions\n";
+    os << "  Instructions      " << instructions << " (" << detailed
+       << " detailed, " << setprecision(2) << share << "%)\n"
+       << "  Detailed cycles   " << detailed_cycles << "\n"
+       << "  CPI               " << setprecision(4) << cpi;
+    if (config.mode == SampleMode::Smarts && samples > 1)
+        os << " +- " << half_width << " (" << setprecision(2)
+           << 100.0 * relativeError() << "% at " << 100.0 * config.confidence
+           << "% confidence)";
+    os << "\n  Estimated cycles  " << setprecision(0) << cycles;
+    if (config.mode == SampleMode::Smarts && samples > 1)
+        os << " [" << cyclesLow() << ", " << cyclesHigh() << "]";
+    os << "\n";
+    if (config.mode == SampleMode::Smarts) {
+        if (samples > 1 && samples < 30)
+            os << "  (fewer than 30 windows: the interval is only indicative)\n";
+        if (samples_needed)
+            os << "  Windows for +-" << setprecision(1) << 100.0 * config.target_error
+               << "%    " << samples_needed << "\n";
+    } else {
+        os << "  interval    weight     CPI\n" << right;
+        for (const Point& pt : points)
+            os << "  " << setw(8) << pt.interval << setw(10) << setprecision(4)
+               << pt.weight << setw(8) << setprecision(3) << pt.cpi << "\n";
+    }
+    os.unsetf(ios::floatfield | ios::adjustfield);
+    os << setprecision(6);
+}
@@ -0,0 +1,101 @@
+// mips_sampling.h
+#ifndef MIPS_SAMPLING_H
+#define MIPS_SAMPLING_H
+
+#include "mips_pipeline.h"
+#include <cstdint>
+#include <iosfwd>
+#include <string_view>
+#include <vector>
+
+// Sampled simulation: estimates the cycles() a full run() would report
+// from a few short cycle-accurate stretches, with everything in between
+// fast-forwarded functionally (at the pipeline's fast-forward engine's
+// speed). The program still runs to HALT, so registers and memory at the
+// end are exact; only the cycle count is an estimate.
+//
+// Fast-forwarding leaves the latches empty and, on its own, the caches
+// and predictor as they were. So the last `warm` instructions before each
+// sample are fast-forwarded with functional warming
+// (MIPSPipeline::fastForwardWarm), which keeps caches and predictor up to
+// date, and the last `warmup` run on the pipeline with their cycles
+// discarded, which refills the latches. Functional warming is skipped
+// when there is no cache model or predictor state to warm.
+//
+// Smarts: systematic sampling. Every `interval` instructions, after the
+// warmups, the run measures the CPI of `window` instructions on the
+// pipeline. The mean over all windows estimates the
+// CPI, and its standard error a confidence interval: the true CPI lies
+// within `half_width` of the estimate with probability `confidence`.
+//
+// SimPoint: a functional profiling pass (on a fork) records one
+// basic-block vector per `interval` instructions - how many instructions
+// each block executed - and k-means over randomly projected vectors groups
+// intervals that behave alike. The interval nearest each cluster's centre
+// is simulated in detail (after `warmup`), and its CPI stands in for the
+// whole cluster. The choice is deterministic, so there is no statistical
+// interval; larger k trades time for accuracy.
+enum class SampleMode : uint8_t { Smarts, SimPoint };
+
+struct SamplingConfig {
+    SampleMode mode{SampleMode::Smarts};
+    uint64_t interval{1000000};   // instructions per sampling unit
+    uint64_t window{1000};        // measured instructions per sample (Smarts)
+    uint64_t warmup{2000};        // detailed, unmeasured, before each sample
+    uint64_t warm{UINT64_MAX};    // functionally warmed before that (all)
+    double confidence{0.997};     // of the interval (Smarts)
+    double target_error{0.03};    // relative half width to size a rerun for
+    uint32_t clusters{10};        // k (SimPoint)
+    uint32_t dims{15};            // random projection of the vectors
+    uint64_t seed{1};             // projection and k-means initialisation
+};
+
+// Reads "mode[,key=value...]" with mode smarts|simpoint and keys
+// interval, window, warmup, warm (a count or all), conf, error, k, dims,
+// seed, e.g.
+// "smarts,interval=100000,window=1000,conf=0.95". Throws
+// std::invalid_argument on anything else, or when warmup and window do
+// not fit in the interval.
+SamplingConfig parseSamplingConfig(std::string_view spec);
+
+struct SampleEstimate {
+    SamplingConfig config;
+    uint64_t instructions{0};   // executed by the whole run
+    uint64_t detailed{0};       // of those, on the pipeline
+    uint64_t detailed_cycles{0};
+    uint64_t samples{0};        // measured windows or simulated intervals
+
+    double cpi{0.0};
+    double cycles{0.0};         // cpi * instructions
+
+    // Smarts only (zero for SimPoint)
+    double cpi_stddev{0.0};     // across samples
+    double half_width{0.0};     // of the CPI interval
+    uint64_t samples_needed{0}; // for target_error at this variability
+
+    // SimPoint only: the intervals profiled and, per cluster, the
+    // representative one (index from the start of the run) and the share
+    // of instructions it stands for.
+    uint64_t intervals{0};
+    struct Point {
+        uint64_t interval{0};
+        double weight{0.0};
+        double cpi{0.0};
+    };
+    std::vector<Point> points;
+
+    double cyclesLow() const { return (cpi - half_width) * double(instructions); }
+    double cyclesHigh() const { return (cpi + half_width) * double(instructions); }
+    double relativeError() const { return cpi > 0.0 ? half_width / cpi : 0.0; }
+
+    // As printed at the end of a sampled run.
+    void report(std::ostream& os) const;
+};
+
+// Runs p from its current state to HALT (or until `max_instrs` have
+// executed) as cfg describes. Turns p's counters on, which the detailed
+// stretches count retirements with. Errors from the program propagate.
+SampleEstimate runSampled(MIPSPipeline& p, const SamplingConfig& cfg,
+                          uint64_t max_instrs = UINT64_MAX);
+
+#endif // MIPS_SAMPLING_H
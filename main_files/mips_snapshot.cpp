@@ -0,0 +1,256 @@
+// mips_snapshot.cpp
+// Checkpoint/restore of the full simulator state and in-process forking.
+//
+// Snapshot file layout (host byte order):
+//   SnapshotHeader
+//   SnapshotState                      registers, PC, counters, latches
+//   page_count x { SnapshotPage, int32_t[kPageWords] unless zero }
+//
+// A full snapshot stores every non-zero memory page. An incremental one
+// names its parent by state hash and stores only the pages that differ
+// from it; pages still shared copy-on-write with the parent are skipped
+// without being read.
+
+#include "mips_pipeline.h"
+#include "mips_hash.h"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr char     kSnapshotMagic[8] = {'M', 'I', 'P', 'S', 'S', 'N', 'P', '\0'};
+constexpr uint32_t kSnapshotVersion  = 2;
+
+struct SnapshotHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t state_size;     // sizeof(SnapshotState)
+    uint64_t program_hash;
+    uint64_t parent_hash;    // stateHash() of the parent; 0 for a full snapshot
+    uint64_t state_hash;     // stateHash() of the saved state
+    uint64_t memory_words;
+    uint64_t page_count;
+};
+
+struct SnapshotPage {
+    uint32_t addr;   // byte address of the page
+    uint32_t zero;   // 1: page reads as zero, no data follows
+};
+
+static_assert(sizeof(SnapshotHeader) == 56);
+static_assert(sizeof(SnapshotPage) == 8);
+
+const int32_t kZeroWords[WordMemory::kPageWords] = {};
+
+[[noreturn]] void bad_file(const string& path, const char* what) {
+    throw runtime_error(string(what) + ": " + path);
+}
+
+} // namespace
+
+// Field by field with explicit padding, so equal states are equal bytes.
+struct MIPSPipeline::SnapshotState {
+    int32_t  regs[32];
+    int32_t  hi, lo;
+    uint64_t cycles;
+    uint64_t ff_instrs;
+    uint64_t ff_cycles;      // fastForwardCycleEstimate()
+    uint32_t pc;
+    uint8_t  halted, fetch_enabled, if_id_pred, id_ex_pred;
+    uint32_t if_id_pc;
+    uint32_t id_ex_pc;
+    int32_t  id_ex_rs_val, id_ex_rt_val;
+    uint32_t ex_mem_pc;
+    int32_t  ex_mem_alu_out, ex_mem_rt_val;
+    uint32_t mem_wb_pc;
+    int32_t  mem_wb_mem_data, mem_wb_alu_out;
+    uint8_t  if_id_valid, id_ex_valid, ex_mem_valid, mem_wb_valid;
+    uint8_t  ex_mem_dest, ex_mem_branch_taken, mem_wb_dest, ex_mem_pred;
+};
+
+MIPSPipeline::SnapshotState MIPSPipeline::capture_state() const {
+    static_assert(sizeof(SnapshotState) == 216);
+    SnapshotState st;
+    memset(&st, 0, sizeof st);
+    for (int i = 0; i < 32; ++i) st.regs[i] = regs_[i];
+    st.hi            = hi_;
+    st.lo            = lo_;
+    st.cycles        = cycles_;
+    st.ff_instrs     = ff_instrs_;
+    st.ff_cycles     = fastForwardCycleEstimate();
+    st.pc            = pc_;
+    st.halted        = halted_;
+    st.fetch_enabled = fetch_enabled_;
+
+    st.if_id_pc        = if_id_.pc;
+    st.if_id_valid     = if_id_.valid;
+    st.if_id_pred      = if_id_.pred_taken;
+    st.id_ex_pc        = id_ex_.pc;
+    st.id_ex_rs_val    = id_ex_.rs_val;
+    st.id_ex_rt_val    = id_ex_.rt_val;
+    st.id_ex_valid     = id_ex_.valid;
+    st.id_ex_pred      = id_ex_.pred_taken;
+    st.ex_mem_pc       = ex_mem_.pc;
+    st.ex_mem_alu_out  = ex_mem_.alu_out;
+    st.ex_mem_rt_val   = ex_mem_.rt_val_forwarded;
+    st.ex_mem_dest     = ex_mem_.dest;
+    st.ex_mem_branch_taken = ex_mem_.branch_taken;
+    st.ex_mem_valid    = ex_mem_.valid;
+    st.ex_mem_pred     = ex_mem_.pred_taken;
+    st.mem_wb_pc       = mem_wb_.pc;
+    st.mem_wb_mem_data = mem_wb_.mem_data;
+    st.mem_wb_alu_out  = mem_wb_.alu_out;
+    st.mem_wb_dest     = mem_wb_.dest;
+    st.mem_wb_valid    = mem_wb_.valid;
+    return st;
+}
+
+void MIPSPipeline::restore_state(const SnapshotState& st) {
+    for (int i = 0; i < 32; ++i) regs_[i] = st.regs[i];
+    regs_[0]       = 0;
+    hi_            = st.hi;
+    lo_            = st.lo;
+    cycles_        = st.cycles;
+    ff_instrs_     = st.ff_instrs;
+    ff_cycle_base_ = st.ff_cycles;
+    pc_            = st.pc;
+    halted_        = st.halted != 0;
+    fetch_enabled_ = st.fetch_enabled != 0;
+
+    if_id_  = IF_ID{st.if_id_pc, st.if_id_valid != 0, st.if_id_pred != 0};
+    id_ex_  = ID_EX{st.id_ex_pc, st.id_ex_rs_val, st.id_ex_rt_val,
+                    st.id_ex_valid != 0, st.id_ex_pred != 0};
+    ex_mem_ = EX_MEM{st.ex_mem_pc, st.ex_mem_alu_out, st.ex_mem_rt_val,
+                     st.ex_mem_dest, st.ex_mem_branch_taken != 0,
+                     st.ex_mem_valid != 0, st.ex_mem_pred != 0};
+    mem_wb_ = MEM_WB{st.mem_wb_pc, st.mem_wb_mem_data, st.mem_wb_alu_out,
+                     st.mem_wb_dest, st.mem_wb_valid != 0};
+    if (!predecode_) redecode_in_flight();
+    // translated code, its timing, the cache contents and what the
+    // predictor learnt belong to the state being replaced
+    threaded_.reset();
+    superblocks_.reset();
+    caches_.reset();
+    bp_.reset();
+    counters_.clear();
+}
+
+MIPSPipeline MIPSPipeline::fork() const {
+    MIPSPipeline child(*this);
+    // translated code keeps per-run state (block counts, patched stop
+    // slots), and a trace file belongs to one run
+    child.ff_cycle_base_ = fastForwardCycleEstimate();
+    child.threaded_.reset();
+    child.superblocks_.reset();
+    child.trace_out_.reset();
+    return child;
+}
+
+uint64_t MIPSPipeline::stateHash() const {
+    SnapshotState st = capture_state();
+    return hash64(&st, sizeof st, mem_.content_hash() ^ decoded_->program_hash);
+}
+
+void MIPSPipeline::saveSnapshot(const string& path,
+                                const MIPSPipeline* parent) const {
+    if (parent && (parent->decoded_->program_hash != decoded_->program_hash ||
+                   parent->mem_.words() != mem_.words()))
+        throw invalid_argument("Snapshot parent runs a different program or "
+                               "memory size");
+
+    // pages to store: (address, contents or null for zero)
+    vector<pair<uint32_t, const int32_t*>> pages;
+    if (parent) {
+        vector<int32_t> before(WordMemory::kPageWords);
+        mem_.for_each_changed_page(parent->mem_, [&](uint32_t addr, const int32_t* w) {
+            size_t n = min<size_t>(WordMemory::kPageWords, mem_.words() - addr / 4);
+            parent->mem_.read_words(addr, before.data(), n);
+            const int32_t* now = w ? w : kZeroWords;
+            if (memcmp(now, before.data(), n * sizeof(int32_t)) != 0)
+                pages.emplace_back(addr, w);
+        });
+    } else {
+        mem_.for_each_page([&](uint32_t addr, const int32_t* w) {
+            if (memcmp(w, kZeroWords, sizeof kZeroWords) != 0)
+                pages.emplace_back(addr, w);
+        });
+    }
+
+    SnapshotHeader h{};
+    memcpy(h.magic, kSnapshotMagic, sizeof h.magic);
+    h.version      = kSnapshotVersion;
+    h.state_size   = sizeof(SnapshotState);
+    h.program_hash = decoded_->program_hash;
+    h.parent_hash  = parent ? parent->stateHash() : 0;
+    h.state_hash   = stateHash();
+    h.memory_words = mem_.words();
+    h.page_count   = pages.size();
+
+    SnapshotState st = capture_state();
+
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) bad_file(path, "Cannot write snapshot");
+    bool ok = fwrite(&h, sizeof h, 1, f) == 1 && fwrite(&st, sizeof st, 1, f) == 1;
+    for (size_t i = 0; ok && i < pages.size(); ++i) {
+        SnapshotPage rec{pages[i].first, pages[i].second ? 0u : 1u};
+        ok = fwrite(&rec, sizeof rec, 1, f) == 1 &&
+             (rec.zero || fwrite(pages[i].second, WordMemory::kPageBytes, 1, f) == 1);
+    }
+    if (fclose(f) != 0 || !ok) bad_file(path, "Cannot write snapshot");
+}
+
+void MIPSPipeline::loadSnapshot(const string& path) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) bad_file(path, "Cannot open snapshot");
+    struct Closer { FILE* f; ~Closer() { fclose(f); } } closer{f};
+
+    SnapshotHeader h;
+    SnapshotState st;
+    if (fread(&h, sizeof h, 1, f) != 1 ||
+        memcmp(h.magic, kSnapshotMagic, sizeof h.magic) != 0 ||
+        h.version != kSnapshotVersion || h.state_size != sizeof st ||
+        fread(&st, sizeof st, 1, f) != 1)
+        bad_file(path, "Not a MIPS snapshot file");
+    if (h.program_hash != decoded_->program_hash)
+        bad_file(path, "Snapshot was taken from a different program");
+    if (h.parent_hash && (h.parent_hash != stateHash() ||
+                          h.memory_words != mem_.words()))
+        bad_file(path, "Current state is not this incremental snapshot's parent");
+    if (h.memory_words > WordMemory::kMaxWords)
+        bad_file(path, "Damaged snapshot");
+
+    // build the new state on the side, so a damaged file changes nothing
+    MIPSPipeline next(*this);
+    if (!h.parent_hash) next.mem_ = WordMemory(static_cast<size_t>(h.memory_words));
+    vector<int32_t> words(WordMemory::kPageWords);
+    for (uint64_t i = 0; i < h.page_count; ++i) {
+        SnapshotPage rec;
+        if (fread(&rec, sizeof rec, 1, f) != 1 ||
+            rec.addr % WordMemory::kPageBytes != 0 || rec.addr / 4 >= h.memory_words)
+            bad_file(path, "Damaged snapshot");
+        if (!rec.zero && fread(words.data(), WordMemory::kPageBytes, 1, f) != 1)
+            bad_file(path, "Truncated snapshot");
+        size_t n = min<size_t>(WordMemory::kPageWords,
+                               static_cast<size_t>(h.memory_words) - rec.addr / 4);
+        next.mem_.write_words(rec.addr, rec.zero ? kZeroWords : words.data(), n);
+    }
+
+    next.restore_state(st);
+
+    // latches index the program; anything else is a damaged file
+    auto in_program = [&](bool valid, uint32_t pc) {
+        return !valid || (pc % 4 == 0 && pc / 4 < n_uops_);
+    };
+    if (!in_program(next.if_id_.valid, next.if_id_.pc) ||
+        !in_program(next.id_ex_.valid, next.id_ex_.pc) ||
+        !in_program(next.ex_mem_.valid, next.ex_mem_.pc) ||
+        !in_program(next.mem_wb_.valid, next.mem_wb_.pc) ||
+        next.stateHash() != h.state_hash)
+        bad_file(path, "Damaged snapshot");
+
+    *this = next;
+}
@@ -0,0 +1,436 @@
+// mips_superblock.cpp
+// Basic-block translator with block chaining for the functional mode.
+
+#include "mips_superblock.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+using namespace std;
+
+namespace {
+
+// local register file slots past $31
+constexpr uint8_t kScratchReg = 32;
+constexpr uint8_t kHiReg = 33;
+constexpr uint8_t kLoReg = 34;
+constexpr uint32_t kMaxBlockLen = 256;   // bounds J folding
+
+// Conditional branches first, in Cond order
+enum class Term : uint8_t {
+    Beq, Bne, Blez, Bgtz, Bltz, Bgez, Jump, JumpReg, Halt, End
+};
+static_assert(static_cast<int>(Term::Bgez) == static_cast<int>(Cond::Gez));
+
+}  // namespace
+
+struct SuperblockCache::Block {
+    uint32_t entry{0};
+    vector<BodyOp> body;
+    Term term{Term::End};
+    uint8_t rs{0}, rt{0};        // branch operands, JR/JALR target in rs
+    uint8_t link{kScratchReg};   // JAL/JALR destination
+    int32_t link_value{0};       // ... and the return address it gets
+    uint32_t len{0};             // body plus terminator (End is not one)
+    uint32_t stalls{0};          // load-use stalls in one full pass
+    uint32_t folded_jumps{0};    // J instructions followed into the body
+    uint32_t lo{0}, hi{0};       // PC range the body touches
+
+    // [0] fall-through, [1] taken; linked the first time each is used
+    uint32_t succ_pc[2]{0, 0};
+    Block* succ[2]{nullptr, nullptr};
+
+    uint64_t execs{0};
+    uint64_t taken{0};
+};
+
+// Define MIPS_THREADED_NO_GOTO to force the portable switch dispatch.
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(MIPS_THREADED_NO_GOTO)
+#define MIPS_SUPERBLOCK_GOTO 1
+#endif
+
+template <Op K>
+inline void SuperblockCache::run_op(const BodyOp& o, int32_t* R,
+                                    WordMemory& mem) {
+    if constexpr (K == Op::ADD)  R[o.dest] = R[o.rs] + R[o.rt];
+    if constexpr (K == Op::SUB)  R[o.dest] = R[o.rs] - R[o.rt];
+    if constexpr (K == Op::AND)  R[o.dest] = R[o.rs] & R[o.rt];
+    if constexpr (K == Op::OR)   R[o.dest] = R[o.rs] | R[o.rt];
+    if constexpr (K == Op::XOR)  R[o.dest] = R[o.rs] ^ R[o.rt];
+    if constexpr (K == Op::NOR)  R[o.dest] = ~(R[o.rs] | R[o.rt]);
+    if constexpr (K == Op::SLT)  R[o.dest] = (R[o.rs] < R[o.rt]) ? 1 : 0;
+    if constexpr (K == Op::SLTU)
+        R[o.dest] = ((uint32_t)R[o.rs] < (uint32_t)R[o.rt]) ? 1 : 0;
+    if constexpr (K == Op::MUL)  R[o.dest] = R[o.rs] * R[o.rt];
+    if constexpr (K == Op::SLL)
+        R[o.dest] = (int32_t)((uint32_t)R[o.rt] << (o.imm & 31));
+    if constexpr (K == Op::SRL)
+        R[o.dest] = (int32_t)((uint32_t)R[o.rt] >> (o.imm & 31));
+    if constexpr (K == Op::SRA)  R[o.dest] = R[o.rt] >> (o.imm & 31);
+    if constexpr (K == Op::SLLV)
+        R[o.dest] = (int32_t)((uint32_t)R[o.rt] << (R[o.rs] & 31));
+    if constexpr (K == Op::SRLV)
+        R[o.dest] = (int32_t)((uint32_t)R[o.rt] >> (R[o.rs] & 31));
+    if constexpr (K == Op::SRAV) R[o.dest] = R[o.rt] >> (R[o.rs] & 31);
+    if constexpr (K == Op::ADDI) R[o.dest] = R[o.rs] + o.imm;
+    if constexpr (K == Op::SLTI) R[o.dest] = (R[o.rs] < o.imm) ? 1 : 0;
+    if constexpr (K == Op::SLTIU)
+        R[o.dest] = ((uint32_t)R[o.rs] < (uint32_t)o.imm) ? 1 : 0;
+    if constexpr (K == Op::ANDI) R[o.dest] = R[o.rs] & o.imm;
+    if constexpr (K == Op::ORI)  R[o.dest] = R[o.rs] | o.imm;
+    if constexpr (K == Op::XORI) R[o.dest] = R[o.rs] ^ o.imm;
+    if constexpr (K == Op::LUI || K == Op::JAL) R[o.dest] = o.imm;
+    if constexpr (K == Op::MULT || K == Op::MULTU || K == Op::DIV ||
+                  K == Op::DIVU || K == Op::MTHI  || K == Op::MTLO)
+        MIPSPipeline::hilo(K, R[o.rs], R[o.rt], R[kHiReg], R[kLoReg]);
+    if constexpr (K == Op::MFHI) R[o.dest] = R[kHiReg];
+    if constexpr (K == Op::MFLO) R[o.dest] = R[kLoReg];
+    if constexpr (K == Op::LB)
+        R[o.dest] = (int8_t)mem.load_sub((uint32_t)(R[o.rs] + o.imm), 1);
+    if constexpr (K == Op::LBU)
+        R[o.dest] = (int32_t)mem.load_sub((uint32_t)(R[o.rs] + o.imm), 1);
+    if constexpr (K == Op::LH)
+        R[o.dest] = (int16_t)mem.load_sub((uint32_t)(R[o.rs] + o.imm), 2);
+    if constexpr (K == Op::LHU)
+        R[o.dest] = (int32_t)mem.load_sub((uint32_t)(R[o.rs] + o.imm), 2);
+    if constexpr (K == Op::LW)
+        R[o.dest] = mem.load_word((uint32_t)(R[o.rs] + o.imm));
+    if constexpr (K == Op::SB)
+        mem.store_sub((uint32_t)(R[o.rs] + o.imm), 1, (uint32_t)R[o.rt]);
+    if constexpr (K == Op::SH)
+        mem.store_sub((uint32_t)(R[o.rs] + o.imm), 2, (uint32_t)R[o.rt]);
+    if constexpr (K == Op::SW)
+        mem.store_word((uint32_t)(R[o.rs] + o.imm), R[o.rt]);
+    (void)o; (void)R; (void)mem;
+}
+
+// Slow path for block prefixes and the switch build.
+void SuperblockCache::run_one(const BodyOp& o, int32_t* R, WordMemory& mem) {
+    switch (o.kind) {
+        case Op::ADD:   run_op<Op::ADD>(o, R, mem);   break;
+        case Op::SUB:   run_op<Op::SUB>(o, R, mem);   break;
+        case Op::AND:   run_op<Op::AND>(o, R, mem);   break;
+        case Op::OR:    run_op<Op::OR>(o, R, mem);    break;
+        case Op::XOR:   run_op<Op::XOR>(o, R, mem);   break;
+        case Op::NOR:   run_op<Op::NOR>(o, R, mem);   break;
+        case Op::SLT:   run_op<Op::SLT>(o, R, mem);   break;
+        case Op::SLTU:  run_op<Op::SLTU>(o, R, mem);  break;
+        case Op::MUL:   run_op<Op::MUL>(o, R, mem);   break;
+        case Op::SLL:   run_op<Op::SLL>(o, R, mem);   break;
+        case Op::SRL:   run_op<Op::SRL>(o, R, mem);   break;
+        case Op::SRA:   run_op<Op::SRA>(o, R, mem);   break;
+        case Op::SLLV:  run_op<Op::SLLV>(o, R, mem);  break;
+        case Op::SRLV:  run_op<Op::SRLV>(o, R, mem);  break;
+        case Op::SRAV:  run_op<Op::SRAV>(o, R, mem);  break;
+        case Op::ADDI:  run_op<Op::ADDI>(o, R, mem);  break;
+        case Op::SLTI:  run_op<Op::SLTI>(o, R, mem);  break;
+        case Op::SLTIU: run_op<Op::SLTIU>(o, R, mem); break;
+        case Op::ANDI:  run_op<Op::ANDI>(o, R, mem);  break;
+        case Op::ORI:   run_op<Op::ORI>(o, R, mem);   break;
+        case Op::XORI:  run_op<Op::XORI>(o, R, mem);  break;
+        case Op::LUI:   run_op<Op::LUI>(o, R, mem);   break;
+        case Op::MULT:  run_op<Op::MULT>(o, R, mem);  break;
+        case Op::MULTU: run_op<Op::MULTU>(o, R, mem); break;
+        case Op::DIV:   run_op<Op::DIV>(o, R, mem);   break;
+        case Op::DIVU:  run_op<Op::DIVU>(o, R, mem);  break;
+        case Op::MFHI:  run_op<Op::MFHI>(o, R, mem);  break;
+        case Op::MFLO:  run_op<Op::MFLO>(o, R, mem);  break;
+        case Op::MTHI:  run_op<Op::MTHI>(o, R, mem);  break;
+        case Op::MTLO:  run_op<Op::MTLO>(o, R, mem);  break;
+        case Op::LB:    run_op<Op::LB>(o, R, mem);    break;
+        case Op::LBU:   run_op<Op::LBU>(o, R, mem);   break;
+        case Op::LH:    run_op<Op::LH>(o, R, mem);    break;
+        case Op::LHU:   run_op<Op::LHU>(o, R, mem);   break;
+        case Op::LW:    run_op<Op::LW>(o, R, mem);    break;
+        case Op::SB:    run_op<Op::SB>(o, R, mem);    break;
+        case Op::SH:    run_op<Op::SH>(o, R, mem);    break;
+        case Op::SW:    run_op<Op::SW>(o, R, mem);    break;
+        case Op::JAL:   run_op<Op::JAL>(o, R, mem);   break;
+        default: break;
+    }
+}
+
+SuperblockCache::SuperblockCache(const vector<MIPSPipeline::MicroOp>& uops)
+    : uops_(uops) {}
+
+SuperblockCache::~SuperblockCache() = default;
+
+size_t SuperblockCache::blockCount() const {
+    return blocks_.size();
+}
+
+SuperblockCache::Block* SuperblockCache::lookup(uint32_t pc) {
+    if (pc % 4 != 0 || pc / 4 >= uops_.size()) return nullptr;
+    auto it = blocks_.find(pc);
+    if (it != blocks_.end()) return it->second.get();
+    return translate(pc);
+}
+
+SuperblockCache::Block* SuperblockCache::translate(uint32_t pc) {
+    auto b = make_unique<Block>();
+    b->entry = pc;
+    b->lo = b->hi = pc;
+
+    // load-use: a load's rt read by the very next instruction costs one
+    // stall (same rule as the hazard unit in MIPSPipeline::step())
+    uint8_t prev_load_dest = 0;
+    auto stalls_on = [&](const MIPSPipeline::MicroOp& u) {
+        return prev_load_dest != 0 &&
+               (prev_load_dest == u.rs || prev_load_dest == u.rt);
+    };
+
+    // word-index runs the body has covered; each folded J starts a new one,
+    // so there are at most kMaxBlockLen and checking them is independent
+    // of the program's size
+    struct Span { uint32_t lo, hi; };
+    array<Span, kMaxBlockLen> spans;
+    size_t n_spans = 0;
+    bool new_span = true;
+    auto in_block = [&](uint32_t w) {
+        for (size_t k = 0; k < n_spans; ++k)
+            if (w >= spans[k].lo && w <= spans[k].hi) return true;
+        return false;
+    };
+
+    bool term_stall = false;
+    size_t i = pc / 4;
+    for (;;) {
+        if (i >= uops_.size()) {
+            // ran off the end of the program without a terminator
+            b->term = Term::End;
+            b->succ_pc[0] = static_cast<uint32_t>(i * 4);
+            break;
+        }
+        const MIPSPipeline::MicroOp& u = uops_[i];
+        uint32_t ipc = static_cast<uint32_t>(i * 4);
+        bool stall = stalls_on(u);
+        b->lo = min(b->lo, ipc);
+        b->hi = max(b->hi, ipc);
+        if (new_span) spans[n_spans++] = {uint32_t(i), uint32_t(i)};
+        else          spans[n_spans - 1].hi = uint32_t(i);
+        new_span = false;
+
+        // follow J into its target while it stays inside the program and
+        // does not loop back into this block
+        bool fold = u.c.Jump && !u.c.Indirect && u.target % 4 == 0 &&
+                    u.target / 4 < uops_.size() && !in_block(u.target / 4) &&
+                    b->len + 1 < kMaxBlockLen;
+
+        if (!fold && (u.c.Branch || u.c.Jump || u.op == Op::HALT)) {
+            b->stalls += stall;
+            term_stall = stall;
+            b->len++;
+            b->rs = u.rs;
+            b->rt = u.rt;
+            if (u.c.RegWrite && u.dest != 0) {
+                b->link       = u.dest;
+                b->link_value = u.imm;
+            }
+            b->term = u.c.Indirect     ? Term::JumpReg
+                    : u.c.Jump         ? Term::Jump
+                    : u.op == Op::HALT ? Term::Halt
+                                       : static_cast<Term>(u.c.BranchCond);
+            b->succ_pc[0] = ipc + 4;
+            b->succ_pc[1] = u.target;
+            break;
+        }
+
+        BodyOp o{};
+        o.kind  = u.op;
+        o.rs    = u.rs;
+        o.rt    = u.rt;
+        o.dest  = (u.c.RegWrite && u.dest != 0) ? u.dest : kScratchReg;
+        o.imm   = u.imm;
+        o.stall = stall;
+        o.pc    = ipc;
+        b->body.push_back(o);
+        b->stalls += stall;
+        b->len++;
+        prev_load_dest = u.c.MemRead ? u.rt : 0;
+
+        if (fold) {
+            b->folded_jumps++;
+            i = u.target / 4;
+            new_span = true;
+        } else {
+            ++i;
+        }
+    }
+
+    // sentinel carrying the terminator's PC and stall
+    BodyOp end{};
+    end.kind  = Op::HALT;
+    end.stall = term_stall;
+    end.pc   = (b->term == Term::End) ? b->succ_pc[0] : b->succ_pc[0] - 4;
+    b->body.push_back(end);
+    if (handlers_) {
+        for (BodyOp& o : b->body)
+            o.handler = handlers_[static_cast<uint8_t>(o.kind)];
+        b->body.back().handler = term_handlers_[static_cast<uint8_t>(b->term)];
+    }
+
+    Block* raw = b.get();
+    blocks_.emplace(pc, move(b));
+    return raw;
+}
+
+uint64_t SuperblockCache::run(RegFile& regs, int32_t& hi, int32_t& lo,
+                              WordMemory& mem, uint32_t& pc, bool& halted,
+                              uint64_t max_instrs, uint32_t stop_pc) {
+#ifdef MIPS_SUPERBLOCK_GOTO
+    // body ops indexed by Op (conditional branches, JR/JALR and HALT
+    // never appear in a body) ...
+    static const void* const handlers[] = {
+        &&op_ADD, &&op_SUB, &&op_AND, &&op_OR, &&op_XOR, &&op_NOR, &&op_SLT,
+        &&op_SLTU, &&op_MUL, &&op_SLL, &&op_SRL, &&op_SRA, &&op_SLLV,
+        &&op_SRLV, &&op_SRAV, &&op_ADDI, &&op_SLTI, &&op_SLTIU, &&op_ANDI,
+        &&op_ORI, &&op_XORI, &&op_LUI, &&op_MULT, &&op_MULTU, &&op_DIV,
+        &&op_DIVU, &&op_MFHI, &&op_MFLO, &&op_MTHI, &&op_MTLO, &&op_LB,
+        &&op_LBU, &&op_LH, &&op_LHU, &&op_LW, &&op_SB, &&op_SH, &&op_SW,
+        &&term_End, &&term_End, &&term_End, &&term_End, &&term_End,
+        &&term_End, &&op_J, &&op_JAL, &&term_End, &&term_End, &&term_End,
+        &&op_NOP
+    };
+    static_assert(sizeof(handlers) / sizeof(handlers[0]) == kOpCount);
+    // ... and the block-ending sentinel indexed by Term
+    static const void* const term_handlers[] = {
+        &&term_Beq, &&term_Bne, &&term_Blez, &&term_Bgtz, &&term_Bltz,
+        &&term_Bgez, &&term_Jump, &&term_JumpReg, &&term_Halt, &&term_End
+    };
+    handlers_      = handlers;
+    term_handlers_ = term_handlers;
+#endif
+
+    if (halted) return 0;
+
+    // an unaligned stop_pc can never be reached
+    if (stop_pc % 4 != 0) stop_pc = MIPSPipeline::kNoStopPC;
+
+    // Local register file; slot 32 swallows writes to $0, then HI and LO.
+    int32_t R[35];
+    for (int r = 0; r < 32; ++r) R[r] = regs[r];
+    R[0]      = 0;
+    R[kHiReg] = hi;
+    R[kLoReg] = lo;
+
+    uint64_t remaining = max_instrs;
+    uint32_t cur_pc = pc;
+    Block* b = lookup(cur_pc);
+    const BodyOp* o = nullptr;
+    bool taken = false;
+
+    try {
+    next_block:
+        if (!b) goto out;
+        o = b->body.data();
+
+        // The budget runs out or stop_pc may fall inside this block: step
+        // through it one op at a time, counting into the partial totals.
+        if (remaining < b->len || (stop_pc >= b->lo && stop_pc <= b->hi)) {
+            for (; remaining && o->kind != Op::HALT && o->pc != stop_pc; ++o) {
+                run_one(*o, R, mem);
+                partial_instrs_++;
+                partial_stalls_ += o->stall;
+                partial_taken_  += (o->kind == Op::J || o->kind == Op::JAL);
+                remaining--;
+            }
+            cur_pc = o->pc;
+            if (!remaining || o->pc == stop_pc || b->term == Term::End)
+                goto out;
+            // the whole body fit; the terminator runs below
+            partial_instrs_++;
+            partial_stalls_ += o->stall;
+            remaining--;
+        } else {
+            remaining -= b->len;
+            b->execs++;
+        }
+
+#ifdef MIPS_SUPERBLOCK_GOTO
+#  define OP(K) op_##K: run_op<Op::K>(*o, R, mem); ++o; goto *o->handler;
+        goto *o->handler;
+        OP(ADD) OP(SUB) OP(AND) OP(OR) OP(XOR) OP(NOR) OP(SLT) OP(SLTU)
+        OP(MUL) OP(SLL) OP(SRL) OP(SRA) OP(SLLV) OP(SRLV) OP(SRAV) OP(ADDI)
+        OP(SLTI) OP(SLTIU) OP(ANDI) OP(ORI) OP(XORI) OP(LUI) OP(MULT)
+        OP(MULTU) OP(DIV) OP(DIVU) OP(MFHI) OP(MFLO) OP(MTHI) OP(MTLO) OP(LB)
+        OP(LBU) OP(LH) OP(LHU) OP(LW) OP(SB) OP(SH) OP(SW) OP(JAL) OP(NOP)
+        OP(J)
+#  undef OP
+    term_Beq:  taken = (R[b->rs] == R[b->rt]); goto chain;
+    term_Bne:  taken = (R[b->rs] != R[b->rt]); goto chain;
+    term_Blez: taken = (R[b->rs] <= 0);        goto chain;
+    term_Bgtz: taken = (R[b->rs] > 0);         goto chain;
+    term_Bltz: taken = (R[b->rs] < 0);         goto chain;
+    term_Bgez: taken = (R[b->rs] >= 0);        goto chain;
+    term_Jump: R[b->link] = b->link_value; taken = true; goto chain;
+    term_JumpReg: goto jump_reg;
+    term_Halt: halted = true; cur_pc = b->succ_pc[0]; goto out;
+    term_End:  cur_pc = b->succ_pc[0];                goto out;
+#else
+        for (; o->kind != Op::HALT; ++o)
+            run_one(*o, R, mem);
+        switch (b->term) {
+            case Term::Beq:  taken = (R[b->rs] == R[b->rt]); break;
+            case Term::Bne:  taken = (R[b->rs] != R[b->rt]); break;
+            case Term::Blez: taken = (R[b->rs] <= 0); break;
+            case Term::Bgtz: taken = (R[b->rs] > 0); break;
+            case Term::Bltz: taken = (R[b->rs] < 0); break;
+            case Term::Bgez: taken = (R[b->rs] >= 0); break;
+            case Term::Jump: R[b->link] = b->link_value; taken = true; break;
+            case Term::JumpReg: goto jump_reg;
+            case Term::Halt: halted = true; cur_pc = b->succ_pc[0]; goto out;
+            case Term::End:  cur_pc = b->succ_pc[0]; goto out;
+        }
+#endif
+        goto chain;
+    jump_reg:
+        // the taken successor is a one-entry cache of the last target;
+        // the target is read before the link in case JALR's rd is rs
+        cur_pc = static_cast<uint32_t>(R[b->rs]);
+        R[b->link] = b->link_value;
+        b->taken++;
+        if (b->succ_pc[1] != cur_pc || !b->succ[1]) {
+            b->succ_pc[1] = cur_pc;
+            b->succ[1]    = lookup(cur_pc);
+        }
+        b = b->succ[1];
+        goto next_block;
+    chain:
+        {
+            b->taken += taken;
+            cur_pc = b->succ_pc[taken];
+            Block*& next = b->succ[taken];
+            if (!next) next = lookup(cur_pc);
+            b = next;
+        }
+        goto next_block;
+    out:;
+    } catch (...) {
+        // leave architectural state as of the faulting instruction
+        for (int r = 1; r < 32; ++r) regs[r] = R[r];
+        hi = R[kHiReg];
+        lo = R[kLoReg];
+        pc = o->pc;
+        throw;
+    }
+
+    for (int r = 1; r < 32; ++r) regs[r] = R[r];
+    hi = R[kHiReg];
+    lo = R[kLoReg];
+    pc = cur_pc;
+    return max_instrs - remaining;
+}
+
+SuperblockCache::Timing SuperblockCache::timing() const {
+    Timing t{};
+    t.instrs          = partial_instrs_;
+    t.load_use_stalls = partial_stalls_;
+    t.taken_branches  = partial_taken_;
+    for (const auto& kv : blocks_) {
+        const Block& b = *kv.second;
+        t.instrs          += b.execs * b.len;
+        t.load_use_stalls += b.execs * b.stalls;
+        t.taken_branches  += b.taken + b.execs * b.folded_jumps;
+    }
+    return t;
+}
@@ -0,0 +1,90 @@
+// mips_superblock.h
+#ifndef MIPS_SUPERBLOCK_H
+#define MIPS_SUPERBLOCK_H
+
+#include "mips_pipeline.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Block-at-a-time functional engine for MIPSPipeline::fastForward().
+//
+// Starting from an entry PC, a block runs straight through to the first
+// conditional branch, JR/JALR or HALT (the same boundaries EX/MEM resolve
+// in the pipeline); a J or JAL is followed into its target, so a block is
+// a superblock that may span several basic blocks.
+// Its body is compiled into a sequence of template-instantiated ops with
+// pre-resolved operands, threaded together without any per-instruction
+// budget or PC bookkeeping. Blocks are translated on first
+// entry and cached by entry PC. Each block remembers its successor blocks
+// once they have been looked up, so steady-state execution chains from
+// block to block without going back to the cache.
+//
+// Every block also carries a static stall summary (load-use stalls the
+// 5-stage pipeline would take inside it), and execution counts are kept
+// per block, so timing() can replay the pipeline's cycle count for a
+// functional run.
+class SuperblockCache {
+public:
+    explicit SuperblockCache(const std::vector<MIPSPipeline::MicroOp>& uops);
+    ~SuperblockCache();
+
+    // Same contract as the interpreter loop in MIPSPipeline::fastForward().
+    uint64_t run(RegFile& regs, int32_t& hi, int32_t& lo, WordMemory& mem,
+                 uint32_t& pc, bool& halted, uint64_t max_instrs,
+                 uint32_t stop_pc);
+
+    // Replayed pipeline timing for everything run() has executed so far.
+    struct Timing {
+        uint64_t instrs{0};
+        uint64_t load_use_stalls{0};
+        uint64_t taken_branches{0};   // taken branches plus every jump
+
+        // Cycles the pipeline needs for the same stream from an empty
+        // pipeline: one per instruction, one per load-use stall, the
+        // slots a taken branch squashes (it resolves in MEM) and four to
+        // fill the pipeline.
+        uint64_t cycles() const {
+            return instrs ? instrs + load_use_stalls + 4 +
+                            BranchPredictor::kFlushPenalty * taken_branches
+                          : 0;
+        }
+    };
+    Timing timing() const;
+
+    size_t blockCount() const;
+
+private:
+    struct Block;
+
+    struct BodyOp {
+        const void* handler{nullptr};   // computed-goto target for `kind`
+        Op kind{Op::NOP};               // HALT marks the block's terminator
+        uint8_t rs{0}, rt{0};
+        uint8_t dest{0};       // writes to $0 land in a scratch slot
+        bool stall{false};     // pipeline stalls one cycle before this op
+        int32_t imm{0};
+        uint32_t pc{0};        // source PC (a folded J is a no-op slot,
+                               // a folded JAL only links)
+    };
+
+    // One instantiation per opcode; operands come pre-resolved in `o`.
+    template <Op K>
+    static void run_op(const BodyOp& o, int32_t* R, WordMemory& mem);
+    static void run_one(const BodyOp& o, int32_t* R, WordMemory& mem);
+
+    Block* lookup(uint32_t pc);
+    Block* translate(uint32_t pc);
+
+    const std::vector<MIPSPipeline::MicroOp>& uops_;
+    std::unordered_map<uint32_t, std::unique_ptr<Block>> blocks_;
+    // computed-goto label tables (by Op / by terminator), set by run()
+    const void* const* handlers_{nullptr};
+    const void* const* term_handlers_{nullptr};
+    uint64_t partial_instrs_{0};   // block prefixes cut by budget / stop_pc
+    uint64_t partial_stalls_{0};
+    uint64_t partial_taken_{0};    // folded J/JALs run in those prefixes
+};
+
+#endif // MIPS_SUPERBLOCK_H
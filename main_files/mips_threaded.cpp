@@ -0,0 +1,234 @@
+// mips_threaded.cpp
+// Direct-threaded interpreter backend for MIPSPipeline::fastForward().
+
+#include "mips_threaded.h"
+#include <cstdint>
+
+using namespace std;
+
+// Define MIPS_THREADED_NO_GOTO to force the portable switch dispatch.
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(MIPS_THREADED_NO_GOTO)
+#define MIPS_THREADED_GOTO 1
+#endif
+
+ThreadedCode::ThreadedCode(const vector<MIPSPipeline::MicroOp>& uops)
+    : n_(uops.size()) {
+    code_.reserve(n_ + 1);
+    for (const MIPSPipeline::MicroOp& u : uops) {
+        Slot s{};
+        s.rs   = u.rs;
+        s.rt   = u.rt;
+        s.imm  = u.imm;
+        s.dest = (u.dest == 0) ? kScratchReg : u.dest;
+        s.kind = static_cast<Kind>(u.op);
+        code_.push_back(s);
+    }
+
+    // falling off the end of the program
+    Slot end{};
+    end.kind = kExit;
+    end.imm  = static_cast<int32_t>(n_ * 4);
+    code_.push_back(end);
+
+    // resolve branch/jump targets to slot indices
+    for (size_t i = 0; i < n_; ++i) {
+        const MIPSPipeline::MicroOp& u = uops[i];
+        if ((!u.c.Branch && !u.c.Jump) || u.c.Indirect) continue;
+        code_[i].target = (u.target % 4 == 0 && u.target / 4 < n_)
+                              ? u.target / 4
+                              : exit_slot(u.target);
+    }
+}
+
+uint32_t ThreadedCode::exit_slot(uint32_t target_pc) {
+    for (size_t i = n_; i < code_.size(); ++i)
+        if (static_cast<uint32_t>(code_[i].imm) == target_pc)
+            return static_cast<uint32_t>(i);
+    Slot s{};
+    s.kind = kExit;
+    s.imm  = static_cast<int32_t>(target_pc);
+    code_.push_back(s);
+    return static_cast<uint32_t>(code_.size() - 1);
+}
+
+uint64_t ThreadedCode::run(RegFile& regs, int32_t& hi, int32_t& lo,
+                           WordMemory& mem, uint32_t& pc, bool& halted,
+                           uint64_t max_instrs, uint32_t stop_pc) {
+#ifdef MIPS_THREADED_GOTO
+    // indexed by Kind
+    static const void* const handlers[kNumKinds] = {
+        &&op_kAdd, &&op_kSub, &&op_kAnd, &&op_kOr, &&op_kXor, &&op_kNor,
+        &&op_kSlt, &&op_kSltu, &&op_kMul, &&op_kSll, &&op_kSrl, &&op_kSra,
+        &&op_kSllv, &&op_kSrlv, &&op_kSrav, &&op_kAddi, &&op_kSlti,
+        &&op_kSltiu, &&op_kAndi, &&op_kOri, &&op_kXori, &&op_kLui,
+        &&op_kMult, &&op_kMultu, &&op_kDiv, &&op_kDivu, &&op_kMfhi,
+        &&op_kMflo, &&op_kMthi, &&op_kMtlo, &&op_kLb, &&op_kLbu, &&op_kLh,
+        &&op_kLhu, &&op_kLw, &&op_kSb, &&op_kSh, &&op_kSw, &&op_kBeq,
+        &&op_kBne, &&op_kBlez, &&op_kBgtz, &&op_kBltz, &&op_kBgez, &&op_kJ,
+        &&op_kJal, &&op_kJr, &&op_kJalr, &&op_kHalt, &&op_kNop, &&op_kExit,
+        &&op_kStop
+    };
+    if (!linked_) {
+        for (Slot& s : code_) s.handler = handlers[s.kind];
+        linked_ = true;
+    }
+#endif
+
+    if (halted || pc % 4 != 0 || pc / 4 >= n_) return 0;
+
+    // Patch a stop marker over the stop_pc slot for the duration of the run.
+    Slot* stop = nullptr;
+    Slot  saved{};
+    if (stop_pc % 4 == 0 && stop_pc / 4 < n_) {
+        stop  = &code_[stop_pc / 4];
+        saved = *stop;
+        stop->kind = kStop;
+#ifdef MIPS_THREADED_GOTO
+        stop->handler = handlers[kStop];
+#endif
+    }
+
+    // Local register file; slot 32 swallows writes to $0, then HI and LO.
+    int32_t R[35];
+    for (int i = 0; i < 32; ++i) R[i] = regs[i];
+    R[0]      = 0;
+    R[kHiReg] = hi;
+    R[kLoReg] = lo;
+
+    Slot* const base = code_.data();
+    const Slot* ip = base + pc / 4;
+    uint64_t remaining = max_instrs;
+    bool hit_halt = false;
+    uint32_t jump_out = 0;   // JR/JALR target outside the program
+    bool jumped_out = false;
+
+#ifdef MIPS_THREADED_GOTO
+#  define OP(k)   op_##k:
+#  define NEXT()  do { if (remaining == 0) goto out; --remaining; \
+                       goto *ip->handler; } while (0)
+#else
+#  define OP(k)   case k:
+#  define NEXT()  continue
+#endif
+
+    try {
+#ifdef MIPS_THREADED_GOTO
+        NEXT();
+#else
+        for (;;) {
+            if (remaining == 0) goto out;
+            --remaining;
+            switch (ip->kind) {
+#endif
+        OP(kAdd)  R[ip->dest] = R[ip->rs] + R[ip->rt]; ++ip; NEXT();
+        OP(kSub)  R[ip->dest] = R[ip->rs] - R[ip->rt]; ++ip; NEXT();
+        OP(kAnd)  R[ip->dest] = R[ip->rs] & R[ip->rt]; ++ip; NEXT();
+        OP(kOr)   R[ip->dest] = R[ip->rs] | R[ip->rt]; ++ip; NEXT();
+        OP(kXor)  R[ip->dest] = R[ip->rs] ^ R[ip->rt]; ++ip; NEXT();
+        OP(kNor)  R[ip->dest] = ~(R[ip->rs] | R[ip->rt]); ++ip; NEXT();
+        OP(kSlt)  R[ip->dest] = (R[ip->rs] < R[ip->rt]) ? 1 : 0; ++ip; NEXT();
+        OP(kSltu) R[ip->dest] = ((uint32_t)R[ip->rs] < (uint32_t)R[ip->rt]) ? 1 : 0;
+                  ++ip; NEXT();
+        OP(kMul)  R[ip->dest] = R[ip->rs] * R[ip->rt]; ++ip; NEXT();
+        OP(kSll)  R[ip->dest] = (int32_t)((uint32_t)R[ip->rt] << (ip->imm & 31));
+                  ++ip; NEXT();
+        OP(kSrl)  R[ip->dest] = (int32_t)((uint32_t)R[ip->rt] >> (ip->imm & 31));
+                  ++ip; NEXT();
+        OP(kSra)  R[ip->dest] = R[ip->rt] >> (ip->imm & 31); ++ip; NEXT();
+        OP(kSllv) R[ip->dest] = (int32_t)((uint32_t)R[ip->rt] << (R[ip->rs] & 31));
+                  ++ip; NEXT();
+        OP(kSrlv) R[ip->dest] = (int32_t)((uint32_t)R[ip->rt] >> (R[ip->rs] & 31));
+                  ++ip; NEXT();
+        OP(kSrav) R[ip->dest] = R[ip->rt] >> (R[ip->rs] & 31); ++ip; NEXT();
+        OP(kAddi) R[ip->dest] = R[ip->rs] + ip->imm; ++ip; NEXT();
+        OP(kSlti) R[ip->dest] = (R[ip->rs] < ip->imm) ? 1 : 0; ++ip; NEXT();
+        OP(kSltiu) R[ip->dest] = ((uint32_t)R[ip->rs] < (uint32_t)ip->imm) ? 1 : 0;
+                  ++ip; NEXT();
+        OP(kAndi) R[ip->dest] = R[ip->rs] & ip->imm; ++ip; NEXT();
+        OP(kOri)  R[ip->dest] = R[ip->rs] | ip->imm; ++ip; NEXT();
+        OP(kXori) R[ip->dest] = R[ip->rs] ^ ip->imm; ++ip; NEXT();
+        OP(kLui)  R[ip->dest] = ip->imm; ++ip; NEXT();
+        OP(kMult) MIPSPipeline::hilo(Op::MULT, R[ip->rs], R[ip->rt], R[kHiReg], R[kLoReg]);
+                  ++ip; NEXT();
+        OP(kMultu) MIPSPipeline::hilo(Op::MULTU, R[ip->rs], R[ip->rt], R[kHiReg], R[kLoReg]);
+                  ++ip; NEXT();
+        OP(kDiv)  MIPSPipeline::hilo(Op::DIV, R[ip->rs], R[ip->rt], R[kHiReg], R[kLoReg]);
+                  ++ip; NEXT();
+        OP(kDivu) MIPSPipeline::hilo(Op::DIVU, R[ip->rs], R[ip->rt], R[kHiReg], R[kLoReg]);
+                  ++ip; NEXT();
+        OP(kMfhi) R[ip->dest] = R[kHiReg]; ++ip; NEXT();
+        OP(kMflo) R[ip->dest] = R[kLoReg]; ++ip; NEXT();
+        OP(kMthi) R[kHiReg] = R[ip->rs]; ++ip; NEXT();
+        OP(kMtlo) R[kLoReg] = R[ip->rs]; ++ip; NEXT();
+        OP(kLb)   R[ip->dest] = (int8_t)mem.load_sub((uint32_t)(R[ip->rs] + ip->imm), 1);
+                  R[0] = 0; ++ip; NEXT();
+        OP(kLbu)  R[ip->dest] = (int32_t)mem.load_sub((uint32_t)(R[ip->rs] + ip->imm), 1);
+                  R[0] = 0; ++ip; NEXT();
+        OP(kLh)   R[ip->dest] = (int16_t)mem.load_sub((uint32_t)(R[ip->rs] + ip->imm), 2);
+                  R[0] = 0; ++ip; NEXT();
+        OP(kLhu)  R[ip->dest] = (int32_t)mem.load_sub((uint32_t)(R[ip->rs] + ip->imm), 2);
+                  R[0] = 0; ++ip; NEXT();
+        OP(kLw)   R[ip->dest] = mem.load_word((uint32_t)(R[ip->rs] + ip->imm));
+                  R[0] = 0; ++ip; NEXT();
+        OP(kSb)   mem.store_sub((uint32_t)(R[ip->rs] + ip->imm), 1, (uint32_t)R[ip->rt]);
+                  ++ip; NEXT();
+        OP(kSh)   mem.store_sub((uint32_t)(R[ip->rs] + ip->imm), 2, (uint32_t)R[ip->rt]);
+                  ++ip; NEXT();
+        OP(kSw)   mem.store_word((uint32_t)(R[ip->rs] + ip->imm), R[ip->rt]);
+                  ++ip; NEXT();
+        OP(kBeq)  ip = (R[ip->rs] == R[ip->rt]) ? base + ip->target : ip + 1;
+                  NEXT();
+        OP(kBne)  ip = (R[ip->rs] != R[ip->rt]) ? base + ip->target : ip + 1;
+                  NEXT();
+        OP(kBlez) ip = (R[ip->rs] <= 0) ? base + ip->target : ip + 1; NEXT();
+        OP(kBgtz) ip = (R[ip->rs] > 0) ? base + ip->target : ip + 1; NEXT();
+        OP(kBltz) ip = (R[ip->rs] < 0) ? base + ip->target : ip + 1; NEXT();
+        OP(kBgez) ip = (R[ip->rs] >= 0) ? base + ip->target : ip + 1; NEXT();
+        OP(kJ)    ip = base + ip->target; NEXT();
+        OP(kJal)  R[ip->dest] = ip->imm; ip = base + ip->target; NEXT();
+        // JR links into the scratch slot; the target is read first in case
+        // JALR's rd is rs
+        OP(kJr) OP(kJalr) {
+            uint32_t t = (uint32_t)R[ip->rs];
+            R[ip->dest] = ip->imm;
+            if (t % 4 == 0 && t / 4 < n_) {
+                ip = base + t / 4;
+                NEXT();
+            }
+            jump_out   = t;
+            jumped_out = true;
+            goto out;
+        }
+        OP(kNop)  ++ip; NEXT();
+        OP(kHalt) hit_halt = true; ++ip; goto out;
+        OP(kExit) ++remaining; goto out;
+        OP(kStop) ++remaining; goto out;
+#ifndef MIPS_THREADED_GOTO
+                default: goto out;
+            }
+        }
+#endif
+    out:;
+    } catch (...) {
+        // leave architectural state as of the faulting instruction
+        for (int i = 1; i < 32; ++i) regs[i] = R[i];
+        hi = R[kHiReg];
+        lo = R[kLoReg];
+        pc = static_cast<uint32_t>(ip - base) * 4;
+        if (stop) *stop = saved;
+        throw;
+    }
+#undef OP
+#undef NEXT
+
+    for (int i = 1; i < 32; ++i) regs[i] = R[i];
+    hi = R[kHiReg];
+    lo = R[kLoReg];
+    size_t idx = static_cast<size_t>(ip - base);
+    pc = jumped_out                      ? jump_out
+         : (idx < n_ || ip->kind != kExit) ? static_cast<uint32_t>(idx * 4)
+                                           : static_cast<uint32_t>(ip->imm);
+    if (hit_halt) halted = true;
+    if (stop) *stop = saved;
+    return max_instrs - remaining;
+}
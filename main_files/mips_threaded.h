@@ -0,0 +1,64 @@
+// mips_threaded.h
+#ifndef MIPS_THREADED_H
+#define MIPS_THREADED_H
+
+#include "mips_pipeline.h"
+#include <cstdint>
+#include <vector>
+
+// Direct-threaded translation of a program's micro-op table for the
+// functional fast-forward mode. Every slot carries its own operands and the
+// address of its handler, and each handler ends by jumping straight to the
+// next slot's handler (computed goto on GCC/Clang, a switch elsewhere), so
+// there is no central decode/dispatch branch per instruction.
+class ThreadedCode {
+public:
+    explicit ThreadedCode(const std::vector<MIPSPipeline::MicroOp>& uops);
+
+    // Same contract as the interpreter loop in MIPSPipeline::fastForward():
+    // runs from pc until max_instrs have executed, the next PC is stop_pc,
+    // HALT executes (sets halted) or control leaves the program. Updates
+    // pc and returns the number of instructions executed.
+    uint64_t run(RegFile& regs, int32_t& hi, int32_t& lo, WordMemory& mem,
+                 uint32_t& pc, bool& halted, uint64_t max_instrs,
+                 uint32_t stop_pc);
+
+private:
+    // In Op order up to kNop, so translation is a cast.
+    enum Kind : uint8_t {
+        kAdd, kSub, kAnd, kOr, kXor, kNor, kSlt, kSltu, kMul,
+        kSll, kSrl, kSra, kSllv, kSrlv, kSrav,
+        kAddi, kSlti, kSltiu, kAndi, kOri, kXori, kLui,
+        kMult, kMultu, kDiv, kDivu, kMfhi, kMflo, kMthi, kMtlo,
+        kLb, kLbu, kLh, kLhu, kLw, kSb, kSh, kSw,
+        kBeq, kBne, kBlez, kBgtz, kBltz, kBgez, kJ, kJal, kJr, kJalr,
+        kHalt, kNop,
+        kExit,   // control left the program; target pc in imm
+        kStop,   // temporarily patched over the stop_pc slot
+        kNumKinds
+    };
+
+    struct Slot {
+        const void* handler{nullptr};
+        Kind kind{kNop};
+        uint8_t rs{0}, rt{0};
+        uint8_t dest{0};      // writes to $0 are redirected to a scratch slot
+        int32_t imm{0};
+        uint32_t target{0};   // slot index of the taken branch / jump
+    };
+
+    static_assert(kNop == static_cast<Kind>(Op::NOP));
+
+    // Local register file slots past $31
+    static constexpr uint8_t kScratchReg = 32;
+    static constexpr uint8_t kHiReg = 33;
+    static constexpr uint8_t kLoReg = 34;
+
+    uint32_t exit_slot(uint32_t target_pc);
+
+    std::vector<Slot> code_;
+    size_t n_{0};            // slots [0, n_) map 1:1 to the program
+    bool linked_{false};     // handler addresses filled in
+};
+
+#endif // MIPS_THREADED_H
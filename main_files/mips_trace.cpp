@@ -0,0 +1,104 @@
+// mips_trace.cpp
+// Binary pipeline trace: buffered writer, reader and text formatting.
+
+#include "mips_trace.h"
+#include <ostream>
+#include <stdexcept>
+
+using namespace std;
+
+static constexpr size_t kTraceBufferBytes = 1u << 20;
+
+TraceWriter::TraceWriter(const string& path, ProgramView prog)
+    : path_(path), buf_(kTraceBufferBytes) {
+    file_ = fopen(path.c_str(), "wb");
+    if (!file_) throw runtime_error("Cannot open trace file " + path);
+
+    TraceHeader h{};
+    memcpy(h.magic, kTraceMagic, sizeof h.magic);
+    h.version      = kTraceVersion;
+    h.record_size  = sizeof(TraceRecord);
+    h.program_size = prog.size;
+    if (fwrite(&h, sizeof h, 1, file_) != 1 ||
+        (!prog.empty() &&
+         fwrite(prog.data, sizeof(Instruction), prog.size, file_) != prog.size)) {
+        fclose(file_);
+        throw runtime_error("Cannot write trace file " + path);
+    }
+}
+
+TraceWriter::~TraceWriter() {
+    if (!file_) return;
+    if (used_) fwrite(buf_.data(), 1, used_, file_);
+    fclose(file_);
+}
+
+void TraceWriter::flush() {
+    size_t n = used_;
+    used_ = 0;
+    if (n && fwrite(buf_.data(), 1, n, file_) != n)
+        throw runtime_error("Cannot write trace file " + path_);
+}
+
+void TraceWriter::close() {
+    if (!file_) return;
+    flush();
+    FILE* f = file_;
+    file_ = nullptr;
+    if (fclose(f) != 0)
+        throw runtime_error("Cannot write trace file " + path_);
+}
+
+TraceReader::TraceReader(const string& path) {
+    file_ = fopen(path.c_str(), "rb");
+    if (!file_) throw runtime_error("Cannot open trace file " + path);
+
+    TraceHeader h{};
+    if (fread(&h, sizeof h, 1, file_) != 1 ||
+        memcmp(h.magic, kTraceMagic, sizeof h.magic) != 0 ||
+        h.version != kTraceVersion || h.record_size != sizeof(TraceRecord)) {
+        fclose(file_);
+        throw runtime_error("Not a MIPS trace file: " + path);
+    }
+    prog_.resize(h.program_size);
+    if (fread(prog_.data(), sizeof(Instruction), prog_.size(), file_) !=
+        prog_.size()) {
+        fclose(file_);
+        throw runtime_error("Truncated trace file: " + path);
+    }
+}
+
+TraceReader::~TraceReader() {
+    fclose(file_);
+}
+
+bool TraceReader::next(TraceRecord& rec, uint64_t& cycle) {
+    if (fread(&rec, sizeof rec, 1, file_) != 1) return false;
+    // stages index the program; anything else is a damaged file
+    for (uint32_t idx : rec.stage)
+        if (idx != kTraceEmpty && idx >= prog_.size())
+            throw runtime_error("Damaged trace record for cycle " +
+                                to_string(rec.cycle));
+    if (rec.cycle < last_cycle_) cycle_hi_ += 1ull << 32;
+    last_cycle_ = rec.cycle;
+    cycle = cycle_hi_ | rec.cycle;
+    return true;
+}
+
+void formatTraceRecord(ostream& os, const TraceRecord& rec, uint64_t cycle,
+                       ProgramView prog) {
+    auto busy = [&](uint32_t idx) {
+        return idx != kTraceEmpty && prog[idx].op != Op::NOP;
+    };
+
+    os << dec << "Cyc " << cycle
+       << " | PC=0x" << hex << rec.pc << dec
+       << " | IF: ";
+    if (rec.stage[0] != kTraceEmpty) os << prog[rec.stage[0]].str();
+    else                             os << "-";
+
+    os << " | ID: "  << (busy(rec.stage[1]) ? "op" : "-")
+       << " | EX: "  << (busy(rec.stage[2]) ? "op" : "-")
+       << " | MEM: " << (busy(rec.stage[3]) ? "op" : "-")
+       << "\n";
+}
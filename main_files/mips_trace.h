@@ -0,0 +1,108 @@
+// mips_trace.h
+#ifndef MIPS_TRACE_H
+#define MIPS_TRACE_H
+
+#include "mips_ir.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iosfwd>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Binary per-cycle pipeline trace.
+//
+// File layout (host byte order):
+//   TraceHeader
+//   Instruction[header.program_size]   the traced program, so the decoder
+//                                      can print mnemonics without the .asm
+//   TraceRecord...                     one per simulated cycle
+//
+// tools/mips_trace_dump.cpp turns a trace file back into the text lines
+// MIPSPipeline prints when constructed with trace = true.
+
+constexpr char     kTraceMagic[8] = {'M', 'I', 'P', 'S', 'T', 'R', 'C', '\0'};
+constexpr uint32_t kTraceVersion  = 1;
+constexpr uint32_t kTraceEmpty    = 0xFFFFFFFFu;   // stage holds no instruction
+
+// TraceRecord::flags
+constexpr uint8_t kTraceStall    = 1u << 0;   // load-use stall this cycle
+constexpr uint8_t kTraceFlush    = 1u << 1;   // branch/jump redirected fetch
+constexpr uint8_t kTraceRegWrite = 1u << 2;   // WB wrote wb_reg = wb_value
+constexpr uint8_t kTraceMiss     = 1u << 3;   // pipeline frozen on a cache miss
+
+struct TraceHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t program_size;
+};
+
+// Latch contents after the cycle committed, as prog_ indices. The stage
+// names follow the text trace: IF is what IF/ID holds, ID what ID/EX
+// holds, and so on.
+struct TraceRecord {
+    uint32_t cycle;      // low 32 bits; the decoder unwraps
+    uint32_t pc;         // next fetch PC
+    uint32_t stage[4];   // IF, ID, EX, MEM (kTraceEmpty when invalid)
+    uint8_t  flags;
+    uint8_t  wb_reg;
+    uint16_t reserved;
+    int32_t  wb_value;
+};
+
+static_assert(std::is_trivially_copyable_v<TraceRecord>);
+static_assert(sizeof(TraceRecord) == 32);
+
+// Appends records through a large in-memory buffer; the file is written in
+// buffer-sized chunks. A failed write throws std::runtime_error. close()
+// reports a failure of the final flush as well; the destructor closes the
+// file too, but silently.
+class TraceWriter {
+public:
+    TraceWriter(const std::string& path, ProgramView prog);
+    ~TraceWriter();
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    void write(const TraceRecord& rec) {
+        if (used_ + sizeof rec > buf_.size()) flush();
+        std::memcpy(buf_.data() + used_, &rec, sizeof rec);
+        used_ += sizeof rec;
+    }
+    void flush();
+    void close();
+
+private:
+    std::FILE* file_{nullptr};
+    std::string path_;
+    std::vector<char> buf_;
+    size_t used_{0};
+};
+
+// Reads a trace file written by TraceWriter; throws on a bad header, and
+// from next() on a record whose stages name no instruction of the program.
+class TraceReader {
+public:
+    explicit TraceReader(const std::string& path);
+    ~TraceReader();
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    const std::vector<Instruction>& program() const { return prog_; }
+    // Fills `rec` and its unwrapped 64-bit cycle; false at end of file.
+    bool next(TraceRecord& rec, uint64_t& cycle);
+
+private:
+    std::FILE* file_{nullptr};
+    std::vector<Instruction> prog_;
+    uint64_t cycle_hi_{0};
+    uint32_t last_cycle_{0};
+};
+
+// One human-readable trace line, as MIPSPipeline prints it.
+void formatTraceRecord(std::ostream& os, const TraceRecord& rec,
+                       uint64_t cycle, ProgramView prog);
+
+#endif // MIPS_TRACE_H
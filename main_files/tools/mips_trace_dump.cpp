@@ -0,0 +1,57 @@
+// mips_trace_dump.cpp
+// Offline decoder for binary traces written with `mips_sim --trace FILE`.
+// Prints the same per-cycle lines as the simulator's text trace; with -v
+// each line also shows the stall/flush flags and the WB register write.
+// Build (from main_files/):
+// g++ -std=c++17 -O2 -I. tools/mips_trace_dump.cpp mips_trace.cpp -o mips_trace_dump
+
+#include "mips_trace.h"
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    bool verbose = false;
+    const char* path = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "-v") verbose = true;
+        else             path = argv[i];
+    }
+    if (!path) {
+        cerr << "Usage: " << argv[0] << " [-v] trace_file\n";
+        return 1;
+    }
+
+    try {
+        TraceReader in(path);
+        TraceRecord rec{};
+        uint64_t cycle = 0;
+        ostringstream line;
+        while (in.next(rec, cycle)) {
+            if (!verbose) {
+                formatTraceRecord(cout, rec, cycle, in.program());
+                continue;
+            }
+            line.str("");
+            formatTraceRecord(line, rec, cycle, in.program());
+            string s = line.str();
+            s.pop_back();   // newline
+            cout << s;
+            if (rec.flags & kTraceStall) cout << " | stall";
+            if (rec.flags & kTraceFlush) cout << " | flush";
+            if (rec.flags & kTraceMiss) cout << " | miss";
+            if (rec.flags & kTraceRegWrite)
+                cout << " | $" << static_cast<int>(rec.wb_reg) << "="
+                     << rec.wb_value;
+            cout << "\n";
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}